@@ -0,0 +1,24 @@
+// Shared uniform blocks, spliced into every shader right after #version
+// Layouts mirror frame_uniforms_t and pass_uniforms_t in include/uniforms.h
+
+layout (std140) uniform FrameUniforms {
+    mat4 u_view;
+    mat4 u_projection;
+    mat4 u_light_view_projection[4]; // UNIFORMS_SHADOW_CASCADES
+    vec3 u_world_eye;
+    float u_fog_start;
+    vec3 u_light_dir;
+    float u_light_intensity;
+    vec4 u_ambient_color;
+    vec4 u_fog_color;
+    vec4 u_shadow_splits;
+    float u_fog_end;
+    float u_fog_density;
+    int u_shadow_cascade_count;
+    float u_shadow_texel_size;
+};
+
+layout (std140) uniform PassUniforms {
+    mat4 u_pass_view_projection;
+};
+
@@ -5,25 +5,50 @@ out vec4 o_fragColor;
 in vec3 m_normal;
 in vec2 m_uv;
 in vec3 m_world_pos;
-in vec4 m_light_space_pos;
+in float m_view_depth;
 
+// Each FEATURE_* is defined per permutation, see shader_base_get
+// Without any of them this is a flat u_color shader
+
+#ifdef FEATURE_TEXTURE
 uniform sampler2D u_texture;
+#endif
 uniform vec4 u_color;
-uniform vec3 u_world_eye;
-
-uniform vec4 u_fog_color;
-uniform float u_fog_start;
-uniform float u_fog_end;
-uniform float u_fog_density;
 
-uniform vec3 u_light_dir;
-uniform float u_light_intensity;
-uniform vec4 u_ambient_color;
-
-// shadows
-uniform mat4 u_light_view_projection;
-uniform sampler2DShadow u_shadow_map;
+float fog_factor(float dist) {
+    // exponential fog
+    return 1.0 - clamp(exp(-u_fog_density * dist * dist), 0.0, 1.0);
+}
 
+// Shadow filtering tier, see shadow_quality_features
+#if !defined(FEATURE_LIGHTING)
+#define SHADOW_TAPS 0
+#elif defined(FEATURE_SHADOW_POISSON_9)
+#define SHADOW_TAPS 9
+#elif defined(FEATURE_SHADOW_POISSON_4)
+#define SHADOW_TAPS 4
+#elif defined(FEATURE_SHADOW_HARD)
+#define SHADOW_TAPS 1
+#else
+#define SHADOW_TAPS 0
+#endif
+
+#if SHADOW_TAPS > 0
+// one layer per cascade, compare mode is on so texture() returns how lit a tap is
+uniform sampler2DArrayShadow u_shadow_map;
+#endif
+
+#if SHADOW_TAPS == 4
+// per-pixel rotation of the disk, (cos, sin) remapped to 0..1
+uniform sampler2D u_shadow_noise;
+
+const vec2 c_poisson_4[4] = vec2[](
+    vec2(-0.94201624, -0.39906216),
+    vec2(0.94558609, -0.76890725),
+    vec2(-0.094184101, -0.92938870),
+    vec2(0.34495938, 0.29387760)
+);
+#elif SHADOW_TAPS == 9
 const vec2 c_poisson_values[9] = vec2[](
     vec2(-0.326212, -0.40581),
     vec2(-0.840144, -0.07358),
@@ -36,53 +61,101 @@ const vec2 c_poisson_values[9] = vec2[](
     vec2(0.507431, 0.064425)
 );
 
-float fog_factor(float dist) {
-    // exponential fog
-    return 1.0 - clamp(exp(-u_fog_density * dist * dist), 0.0, 1.0);
-}
-
 float random(vec2 co) {
     return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
 }
+#endif
+
+#if SHADOW_TAPS > 0
+// First cascade whose slice of the view contains the fragment, -1 past the last one
+int shadow_cascade(float view_depth) {
+    for (int i = 0; i < u_shadow_cascade_count; i++) {
+        if (view_depth < u_shadow_splits[i]) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+#endif
+
+float shadow_factor(vec3 world_pos, float view_depth) {
+#if SHADOW_TAPS == 0
+    return 0.0;
+#else
+    int cascade = shadow_cascade(view_depth);
+    if (cascade < 0) {
+        return 0.0;
+    }
 
-float shadow_factor(vec4 light_space_pos) {
+    vec4 light_space_pos = u_light_view_projection[cascade] * vec4(world_pos, 1.0);
     vec3 shadow_pos = light_space_pos.xyz / light_space_pos.w;
     shadow_pos = shadow_pos * 0.5 + 0.5;
 
-    float bias = 0.0005 * tan(acos(dot(m_normal, u_light_dir)));
-    float noise_offset = 1.0 / 5000.0;
+    // slope-scaled bias, tan(acos(x)) without the trig, capped at grazing angles
+    float cos_theta = clamp(dot(normalize(m_normal), u_light_dir), 0.05, 1.0);
+    float bias = min(0.0005 * sqrt(1.0 - cos_theta * cos_theta) / cos_theta, 0.01);
+    float reference = shadow_pos.z - bias;
+    float layer = float(cascade);
+
+#if SHADOW_TAPS == 1
+    return 1.0 - texture(u_shadow_map, vec4(shadow_pos.xy, layer, reference));
+#elif SHADOW_TAPS == 4
+    vec2 noise_uv = gl_FragCoord.xy / vec2(textureSize(u_shadow_noise, 0));
+    vec2 rotation = texture(u_shadow_noise, noise_uv).xy * 2.0 - 1.0;
+    mat2 rotate = mat2(rotation.x, rotation.y, -rotation.y, rotation.x);
+    float radius = u_shadow_texel_size * 1.5;
+
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = rotate * c_poisson_4[i] * radius;
+        lit += texture(u_shadow_map, vec4(shadow_pos.xy + offset, layer, reference));
+    }
+
+    return 1.0 - lit / 4.0;
+#else
+    float noise_offset = u_shadow_texel_size * 1.5;
     // use random offset from poisson disk
     float shadow = 0.0;
     for (int i = 0; i < 9; i++) {
         int index = int(random(m_uv + c_poisson_values[i]) * 500.0);
-        vec3 sample_pos = shadow_pos + vec3(c_poisson_values[index % 9] * noise_offset, 0.0);
-        float depth = texture(u_shadow_map, sample_pos);
-        if (depth < shadow_pos.z - bias) {
-            shadow += 1.0;
-        }
+        vec2 sample_pos = shadow_pos.xy + c_poisson_values[index % 9] * noise_offset;
+        shadow += 1.0 - texture(u_shadow_map, vec4(sample_pos, layer, reference));
     }
 
     return shadow / 9.0;
+#endif
+#endif
 }
 
 void main() {
-    vec4 texColor = texture2D(u_texture, m_uv);
-    float dist = length(m_world_pos - u_world_eye);
-    float fogFactor = fog_factor(dist);
+#ifdef FEATURE_TEXTURE
+    vec4 finalColor = texture(u_texture, m_uv) * u_color;
+#else
+    vec4 finalColor = u_color;
+#endif
+
+#ifdef FEATURE_LIGHTING
+    vec3 normal = normalize(m_normal);
 
     // calulate normal-based lighting
-    float diffuse = max(dot(m_normal, u_light_dir), 0.0) * u_light_intensity;
+    float diffuse = max(dot(normal, u_light_dir), 0.0) * u_light_intensity;
     vec4 diffuseColor = vec4(vec3(diffuse), 1.0);
 
     // calculate shadow
-    float shadow = shadow_factor(m_light_space_pos);
+    float shadow = shadow_factor(m_world_pos, m_view_depth);
 
     // calculate final color
-    vec4 finalColor = (diffuseColor + u_ambient_color) * texColor;
+    finalColor *= diffuseColor + u_ambient_color;
 
     // apply shadow
     finalColor.rgb *= 1.0 - shadow * (1.0 - u_ambient_color.rgb);
+#endif
+
+#ifdef FEATURE_FOG
+    float dist = length(m_world_pos - u_world_eye);
+    finalColor = mix(finalColor, u_fog_color, fog_factor(dist));
+#endif
 
-    // apply fog
-    o_fragColor = mix(finalColor, u_fog_color, fogFactor);
+    o_fragColor = finalColor;
 }
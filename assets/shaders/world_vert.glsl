@@ -5,22 +5,25 @@ layout (location = 1) in vec3 a_normal;
 layout (location = 2) in vec2 a_uv;
 
 uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_projection;
-
-uniform mat4 u_light_view_projection;
 
 out vec3 m_normal;
 out vec2 m_uv;
 out vec3 m_world_pos;
-out vec4 m_light_space_pos;
+out float m_view_depth;
 
 void main()
 {
-    mat4 mvp = u_projection * u_view * u_model;
-    gl_Position = mvp * vec4(a_pos, 1.0f);
-    m_world_pos = (u_model * vec4(a_pos, 1.0f)).xyz;
-    m_normal = mat3(transpose(inverse(u_model))) * a_normal;
+    vec4 world_pos = u_model * vec4(a_pos, 1.0f);
+    gl_Position = u_pass_view_projection * world_pos;
+    m_world_pos = world_pos.xyz;
+#ifdef FEATURE_LIGHTING
+    // model matrices only translate, rotate and scale uniformly, so the upper 3x3 is the
+    // normal matrix up to a scale that normalize() in the fragment shader removes
+    m_normal = mat3(u_model) * a_normal;
+    m_view_depth = -(u_view * world_pos).z;
+#else
+    m_normal = vec3(0.0);
+    m_view_depth = 0.0;
+#endif
     m_uv = a_uv;
-    m_light_space_pos = u_light_view_projection * u_model * vec4(a_pos, 1.0f);
 }
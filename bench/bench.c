@@ -0,0 +1,337 @@
+// cubegame-bench, headless benchmarks of world generation, meshing, raycasts and saves
+// Needs neither a window nor GL, so it runs on machines without a GPU. Every scenario is
+// seeded and repeatable. Results go to stdout as JSON, logs to stderr (log.txt in release
+// builds).
+//
+// cubegame-bench [--seed S] [--chunks N] [--rays M] [--save-chunks K] [--repeat R]
+//                [--save-path PATH]
+
+#include "harness.h"
+#include "job.h"
+#include "log.h"
+#include "physics.h"
+#include "saves.h"
+#include "thread.h"
+#include "types.h"
+#include "utils.h"
+#include "world.h"
+
+#include <cglm/vec3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Chunks are laid out in columns this high from y 0 up, around the surface
+#define BENCH_COLUMN_HEIGHT 4
+// How far a ray looks for a block, a bit more than a player can reach
+#define BENCH_RAY_RANGE 64.0f
+// Written to the temporary directory unless --save-path is given, removed when done
+#define BENCH_SAVE_NAME "bench_world.cgsv"
+#define BENCH_PATH_MAX 512
+
+typedef struct bench_args {
+    u64 seed;
+    u32 chunks; // generated, and meshed up to MAX_LOADED_CHUNKS of them
+    u32 rays;
+    u32 save_chunks;
+    u32 repeat; // writes and loads of the save
+    char save_path[BENCH_PATH_MAX];
+} bench_args_t;
+
+static bench_args_t bench_parse_args(int argc, char** argv) {
+    bench_args_t args = {
+        .seed = 1,
+        .chunks = 1024,
+        .rays = 10000,
+        .save_chunks = 4096,
+        .repeat = 5,
+    };
+    bench_temp_path(BENCH_SAVE_NAME, args.save_path, sizeof(args.save_path));
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            args.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--chunks") == 0 && has_value) {
+            args.chunks = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--rays") == 0 && has_value) {
+            args.rays = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--save-chunks") == 0 && has_value) {
+            args.save_chunks = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--repeat") == 0 && has_value) {
+            args.repeat = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--save-path") == 0 && has_value) {
+            snprintf(args.save_path, sizeof(args.save_path), "%s", argv[++i]);
+        } else {
+            LOG_ERROR("Unknown or incomplete argument %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    args.chunks = args.chunks ? args.chunks : 1;
+    args.save_chunks = args.save_chunks ? args.save_chunks : 1;
+    args.repeat = args.repeat ? args.repeat : 1;
+    return args;
+}
+
+// Columns of BENCH_COLUMN_HEIGHT chunks in a square around the origin
+static i32 bench_side(u32 chunk_count) {
+    i32 side = 1;
+    while ((u32)(side * side * BENCH_COLUMN_HEIGHT) < chunk_count) {
+        side++;
+    }
+    return side;
+}
+
+static void bench_chunk_position(u32 i, i32 side, ivec3 position) {
+    u32 column = i / BENCH_COLUMN_HEIGHT;
+    position[0] = (i32)(column % (u32)side) - side / 2;
+    position[1] = (i32)(i % BENCH_COLUMN_HEIGHT);
+    position[2] = (i32)(column / (u32)side) - side / 2;
+}
+
+// Print one scenario's JSON object, samples are in microseconds and get sorted
+static void bench_report(const char* name, f64* samples, u32 count) {
+    static bool first = true;
+
+    f64 total = 0.0;
+    for (u32 i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    bench_sort(samples, count);
+
+    printf(
+        "%s    {\n"
+        "      \"name\": \"%s\",\n"
+        "      \"count\": %u,\n"
+        "      \"total_ms\": %.3f,\n"
+        "      \"per_second\": %.1f,\n"
+        "      \"min_us\": %.3f,\n"
+        "      \"mean_us\": %.3f,\n"
+        "      \"p50_us\": %.3f,\n"
+        "      \"p90_us\": %.3f,\n"
+        "      \"p99_us\": %.3f,\n"
+        "      \"max_us\": %.3f\n"
+        "    }",
+        first ? "" : ",\n",
+        name,
+        count,
+        total / 1000.0,
+        total > 0.0 ? (f64)count / total * 1000000.0 : 0.0,
+        samples[0],
+        total / (f64)count,
+        bench_percentile(samples, count, 50.0),
+        bench_percentile(samples, count, 90.0),
+        bench_percentile(samples, count, 99.0),
+        samples[count - 1]
+    );
+    fflush(stdout);
+    first = false;
+}
+
+static void bench_generate(const bench_args_t* args) {
+    f64* samples = malloc(sizeof(f64) * args->chunks);
+    block_id_t* blocks = malloc(CHUNK_BLOCK_COUNT);
+    i32 side = bench_side(args->chunks);
+
+    for (u32 i = 0; i < args->chunks; i++) {
+        ivec3 position;
+        bench_chunk_position(i, side, position);
+
+        f64 start = time_now_ms();
+        chunk_generate_blocks(position, NULL, blocks);
+        samples[i] = (time_now_ms() - start) * 1000.0;
+    }
+
+    bench_report("generate", samples, args->chunks);
+    free(blocks);
+    free(samples);
+}
+
+// Loads a box of chunks into world for the mesh and raycast scenarios, returns its side
+static i32 bench_load_world(const bench_args_t* args, world_t* world) {
+    u32 chunk_count = args->chunks < MAX_LOADED_CHUNKS ? args->chunks : MAX_LOADED_CHUNKS;
+    i32 side = 1;
+    while ((u32)((side + 1) * (side + 1) * BENCH_COLUMN_HEIGHT) <= chunk_count) {
+        side++;
+    }
+
+    world_load_t load;
+    world_load_begin(
+        &load,
+        world,
+        &g_job_pool,
+        (ivec3){ -side / 2, 0, -side / 2 },
+        (ivec3){ side - side / 2, BENCH_COLUMN_HEIGHT, side - side / 2 }
+    );
+    world_load_finish(&load, &g_job_pool);
+    return side;
+}
+
+// Rebuilds the mesh of every loaded chunk, the way an edit remeshes one
+static void bench_mesh(world_t* world) {
+    f64* samples = malloc(sizeof(f64) * MAX_LOADED_CHUNKS);
+    u32 count = 0;
+
+    for (u32 i = 0; i < MAX_LOADED_CHUNKS; i++) {
+        if (!world_chunk_slot_is_taken(world, i)) {
+            continue;
+        }
+
+        f64 start = time_now_ms();
+        chunk_build_mesh(&world->chunks[i], world);
+        samples[count++] = (time_now_ms() - start) * 1000.0;
+    }
+
+    bench_report("mesh", samples, count);
+    free(samples);
+}
+
+// Rays from above the loaded box towards random points of the ground below
+static void bench_raycast(const bench_args_t* args, world_t* world, i32 side) {
+    f64* samples = malloc(sizeof(f64) * args->rays);
+    u64 state = args->seed;
+    f32 extent = (f32)(side * CHUNK_SIZE);
+    f32 min = (f32)(-side / 2 * CHUNK_SIZE);
+    u32 hits = 0;
+
+    for (u32 i = 0; i < args->rays; i++) {
+        ray_t ray;
+        ray.origin[0] = min + bench_random_f32(&state) * extent;
+        ray.origin[1] = (f32)(BENCH_COLUMN_HEIGHT * CHUNK_SIZE);
+        ray.origin[2] = min + bench_random_f32(&state) * extent;
+
+        vec3 target = {
+            min + bench_random_f32(&state) * extent,
+            bench_random_f32(&state) * (f32)(BENCH_COLUMN_HEIGHT * CHUNK_SIZE),
+            min + bench_random_f32(&state) * extent,
+        };
+        glm_vec3_sub(target, ray.origin, ray.direction);
+        glm_vec3_normalize(ray.direction);
+
+        ivec3 block_position;
+        f64 start = time_now_ms();
+        hits += ray_intersect_block(
+            ray,
+            world,
+            BENCH_RAY_RANGE,
+            BLOCK_FLAG_SOLID,
+            &block_position,
+            NULL,
+            NULL
+        );
+        samples[i] = (time_now_ms() - start) * 1000.0;
+    }
+
+    LOG_INFO("%u of %u rays hit a block\n", hits, args->rays);
+    bench_report("raycast", samples, args->rays);
+    free(samples);
+}
+
+// A world of save_chunks generated chunks with a few edits each, written and loaded again
+// repeat times, then every chunk read back. The save is removed after the last load.
+static void bench_save(const bench_args_t* args) {
+    f64* write_samples = malloc(sizeof(f64) * args->repeat);
+    f64* load_samples = malloc(sizeof(f64) * args->repeat);
+    f64* read_samples = malloc(sizeof(f64) * args->save_chunks);
+    chunk_t* chunk = calloc(1, sizeof(chunk_t));
+    block_id_t* scratch = malloc(CHUNK_BLOCK_COUNT);
+    i32 side = bench_side(args->save_chunks);
+    u32 missing = 0;
+
+    for (u32 r = 0; r < args->repeat; r++) {
+        save_t* save = save_new();
+        save->world.seed = args->seed;
+
+        u64 state = args->seed;
+        for (u32 i = 0; i < args->save_chunks; i++) {
+            bench_chunk_position(i, side, chunk->position);
+            chunk_generate(chunk, NULL);
+            for (u32 edit = 0; edit < 32; edit++) {
+                u32 index = (u32)(bench_random(&state) % CHUNK_BLOCK_COUNT);
+                chunk->blocks[index].id = (block_id_t)(bench_random(&state) % BLOCK_ID_MAX);
+            }
+            save_add_chunk(save, chunk);
+        }
+
+        f64 start = time_now_ms();
+        save_write(save, args->save_path);
+        write_samples[r] = (time_now_ms() - start) * 1000.0;
+        save_free(save);
+
+        start = time_now_ms();
+        save = save_load(args->save_path);
+        load_samples[r] = (time_now_ms() - start) * 1000.0;
+
+        if (!save) {
+            LOG_ERROR("Failed to load %s\n", args->save_path);
+            exit(1);
+        }
+
+        // the first load's reads are the ones reported, later ones find the file cached
+        if (r == 0) {
+            for (u32 i = 0; i < args->save_chunks; i++) {
+                ivec3 position;
+                bench_chunk_position(i, side, position);
+
+                start = time_now_ms();
+                missing += save_get_chunk_blocks(save, position, scratch) == NULL;
+                read_samples[i] = (time_now_ms() - start) * 1000.0;
+            }
+        }
+        if (r == args->repeat - 1) {
+            save_remove(save, args->save_path);
+        }
+        save_free(save);
+    }
+
+    if (missing) {
+        LOG_ERROR("%u saved chunks were missing when read back\n", missing);
+    }
+
+    bench_report("save_write", write_samples, args->repeat);
+    bench_report("save_load", load_samples, args->repeat);
+    bench_report("save_read_chunk", read_samples, args->save_chunks);
+
+    free(scratch);
+    free(chunk);
+    free(read_samples);
+    free(load_samples);
+    free(write_samples);
+}
+
+int main(int argc, char** argv) {
+    log_init();
+    bench_args_t args = bench_parse_args(argc, argv);
+
+    u32 cores = thread_hardware_concurrency();
+    job_pool_init(&g_job_pool, cores > 1 ? cores - 1 : 0);
+    world_generator_init(args.seed);
+    // chunks of the world scenarios come from the generator, like in a new game
+    g_save = save_new();
+    g_save->world.seed = args.seed;
+
+    printf("{\n");
+    printf("  \"seed\": %llu,\n", (unsigned long long)args.seed);
+    // the calling thread works through job_group_wait too, next to the pool's workers
+    printf("  \"cores\": %u,\n", cores);
+    printf("  \"workers\": %u,\n", g_job_pool.thread_count);
+    printf("  \"scenarios\": [\n");
+
+    bench_generate(&args);
+
+    world_t* world = world_new();
+    i32 side = bench_load_world(&args, world);
+    bench_mesh(world);
+    bench_raycast(&args, world, side);
+    world_free(world);
+
+    bench_save(&args);
+
+    printf("\n  ]\n}\n");
+
+    save_free(g_save);
+    job_pool_free(&g_job_pool);
+    log_close();
+    return 0;
+}
@@ -0,0 +1,52 @@
+// getpid
+#define _POSIX_C_SOURCE 200809L
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define bench_getpid() _getpid()
+#else
+#include <unistd.h>
+#define bench_getpid() getpid()
+#endif
+
+u64 bench_random(u64* state) {
+    u64 z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+f32 bench_random_f32(u64* state) {
+    return (f32)(bench_random(state) >> 40) / (f32)(1 << 24);
+}
+
+static int bench_compare_f64(const void* a, const void* b) {
+    f64 x = *(const f64*)a;
+    f64 y = *(const f64*)b;
+    return (x > y) - (x < y);
+}
+
+void bench_sort(f64* samples, u32 count) {
+    qsort(samples, count, sizeof(f64), bench_compare_f64);
+}
+
+f64 bench_percentile(const f64* samples, u32 count, f64 percentile) {
+    u32 rank = (u32)(percentile / 100.0 * (f64)count + 0.999999);
+    rank = rank ? rank : 1;
+    return samples[(rank < count ? rank : count) - 1];
+}
+
+void bench_temp_path(const char* name, char* out, usize size) {
+    const char* directory = getenv("TMPDIR");
+#ifdef _WIN32
+    directory = directory ? directory : getenv("TEMP");
+#endif
+    directory = directory ? directory : "/tmp";
+
+    snprintf(out, size, "%s/%d-%s", directory, (int)bench_getpid(), name);
+}
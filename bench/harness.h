@@ -0,0 +1,19 @@
+#pragma once
+
+// Helpers shared by cubegame-bench, cubegame-microbench and the tests
+
+#include "types.h"
+
+// splitmix64, so every run with the same seed sees the same numbers
+u64 bench_random(u64* state);
+// In [0, 1)
+f32 bench_random_f32(u64* state);
+
+// Sort samples ascending, for bench_percentile
+void bench_sort(f64* samples, u32 count);
+// Nearest rank, samples sorted
+f64 bench_percentile(const f64* samples, u32 count, f64 percentile);
+
+// name in the system's temporary directory, prefixed with the process id so parallel runs
+// don't share files
+void bench_temp_path(const char* name, char* out, usize size);
@@ -0,0 +1,33 @@
+// The GL side of the world for cubegame-bench: chunk meshes are still built on the CPU,
+// uploading, freeing and drawing them does nothing
+#include "mesh.h"
+#include "render_queue.h"
+
+void mesh_init(mesh_t* mesh) {
+    mesh->vao = 0;
+    mesh->vbo = 0;
+}
+
+void mesh_free(mesh_t* mesh) {
+    (void)mesh;
+}
+
+void render_queue_submit(
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    struct mesh* mesh,
+    GLuint program,
+    GLuint texture,
+    mat4 model,
+    vec4 color,
+    f32 depth
+) {
+    (void)queue;
+    (void)pass;
+    (void)mesh;
+    (void)program;
+    (void)texture;
+    (void)model;
+    (void)color;
+    (void)depth;
+}
@@ -0,0 +1,629 @@
+// cubegame-microbench, timings of single hot functions to catch regressions
+// Each kernel is set up, warmed up, then timed in samples of a fixed number of calls and
+// reported in nanoseconds per call. Results go to stdout as JSON, logs to stderr. With
+// --baseline the medians are compared to an earlier run's output, and the exit code is 1
+// if any of them got slower by more than the threshold.
+//
+// cubegame-microbench [--samples N] [--warmup N] [--seed S] [--baseline PATH]
+//                     [--threshold PERCENT] [--list] [kernel...]
+//
+// Every kernel is also a meson benchmark, see meson.build
+
+#include "file_map.h"
+#include "harness.h"
+#include "job.h"
+#include "log.h"
+#include "mesh.h"
+#include "physics.h"
+#include "saves.h"
+#include "thread.h"
+#include "types.h"
+#include "utils.h"
+#include "world.h"
+
+#include <cglm/ivec3.h>
+#include <cglm/vec3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Loaded box of chunks for the kernels that need a world, MICRO_WORLD_SIDE^2 columns
+#define MICRO_WORLD_SIDE 4
+#define MICRO_WORLD_HEIGHT 4
+// Noise samples, chunk positions and block faces of one sample
+#define MICRO_POINTS 4096
+#define MICRO_RAYS 1024
+#define MICRO_RAYS_PER_SAMPLE 64
+#define MICRO_RAY_RANGE 64.0f
+#define MICRO_SAVE_CHUNKS 256
+// in the temporary directory, removed again on exit
+#define MICRO_SAVE_NAME "microbench_world.cgsv"
+#define MICRO_PATH_MAX 512
+
+typedef struct micro_args {
+    u64 seed;
+    u32 samples; // 0 keeps each kernel's own
+    u32 warmup;
+    const char* baseline; // NULL to not compare
+    f64 threshold;        // percent
+    const char** kernels; // NULL runs every kernel
+    u32 kernel_count;
+} micro_args_t;
+
+// Everything the kernels work on, set up lazily by the kernels that need it
+typedef struct micro_state {
+    u64 seed;
+
+    bool noise_ready;
+    noise_t noise;
+    f32 points[3][MICRO_POINTS];
+
+    world_t* world;
+    chunk_t** loaded; // chunks of the world
+    u32 loaded_count;
+    ivec3 positions[MICRO_POINTS];
+    ray_t rays[MICRO_RAYS];
+
+    chunk_t* chunk;
+    mesh_t mesh;
+
+    block_id_t* save_blocks; // MICRO_SAVE_CHUNKS generated and edited chunks
+    char save_path[MICRO_PATH_MAX];
+    save_t* save;
+    block_id_t* scratch;
+} micro_state_t;
+
+typedef struct micro_kernel {
+    const char* name;
+    // calls per sample, so short functions take well above the clock's resolution
+    u32 calls;
+    u32 samples;
+    // once before the warmup, untimed
+    void (*setup)(micro_state_t* state);
+    // before every sample, untimed, may be NULL
+    void (*prepare)(micro_state_t* state);
+    // one sample of calls calls, sample counts from the first warmup one
+    void (*run)(micro_state_t* state, u32 sample);
+} micro_kernel_t;
+
+// Results are added here so the calls can't be optimized out
+static volatile f32 micro_sink;
+
+static void micro_setup_noise(micro_state_t* state) {
+    if (state->noise_ready) {
+        return;
+    }
+
+    noise_init(&state->noise, state->seed);
+    u64 random = state->seed;
+    for (u32 i = 0; i < MICRO_POINTS; i++) {
+        for (u32 axis = 0; axis < 3; axis++) {
+            state->points[axis][i] = bench_random_f32(&random) * 4096.0f;
+        }
+    }
+    state->noise_ready = true;
+}
+
+static void micro_perlin2d(micro_state_t* state, u32 sample) {
+    (void)sample;
+    f32 sum = 0.0f;
+    for (u32 i = 0; i < MICRO_POINTS; i++) {
+        sum += noise_perlin2d(&state->noise, state->points[0][i], state->points[2][i]);
+    }
+    micro_sink += sum;
+}
+
+static void micro_perlin3d(micro_state_t* state, u32 sample) {
+    (void)sample;
+    f32 sum = 0.0f;
+    for (u32 i = 0; i < MICRO_POINTS; i++) {
+        sum += noise_perlin3d(
+            &state->noise,
+            state->points[0][i],
+            state->points[1][i],
+            state->points[2][i]
+        );
+    }
+    micro_sink += sum;
+}
+
+// Chunk positions around the surface, and rays from above the box to the ground in it.
+// A ring of positions just outside the box makes world_get_chunk miss sometimes.
+static void micro_setup_world(micro_state_t* state) {
+    if (state->world) {
+        return;
+    }
+
+    i32 min = -MICRO_WORLD_SIDE / 2;
+    i32 max = MICRO_WORLD_SIDE - MICRO_WORLD_SIDE / 2;
+    state->world = world_new();
+    world_load_t load;
+    world_load_begin(
+        &load,
+        state->world,
+        &g_job_pool,
+        (ivec3){ min, 0, min },
+        (ivec3){ max, MICRO_WORLD_HEIGHT, max }
+    );
+    world_load_finish(&load, &g_job_pool);
+
+    state->loaded = malloc(sizeof(chunk_t*) * MAX_LOADED_CHUNKS);
+    for (u32 i = 0; i < MAX_LOADED_CHUNKS; i++) {
+        if (world_chunk_slot_is_taken(state->world, i)) {
+            state->loaded[state->loaded_count++] = &state->world->chunks[i];
+        }
+    }
+
+    u64 random = state->seed;
+    u32 range = MICRO_WORLD_SIDE + 2;
+    for (u32 i = 0; i < MICRO_POINTS; i++) {
+        state->positions[i][0] = min - 1 + (i32)(bench_random(&random) % range);
+        state->positions[i][1] = (i32)(bench_random(&random) % MICRO_WORLD_HEIGHT);
+        state->positions[i][2] = min - 1 + (i32)(bench_random(&random) % range);
+    }
+
+    f32 extent = (f32)(MICRO_WORLD_SIDE * CHUNK_SIZE);
+    f32 origin = (f32)(min * CHUNK_SIZE);
+    f32 height = (f32)(MICRO_WORLD_HEIGHT * CHUNK_SIZE);
+    for (u32 i = 0; i < MICRO_RAYS; i++) {
+        ray_t* ray = &state->rays[i];
+        ray->origin[0] = origin + bench_random_f32(&random) * extent;
+        ray->origin[1] = height;
+        ray->origin[2] = origin + bench_random_f32(&random) * extent;
+
+        vec3 target = {
+            origin + bench_random_f32(&random) * extent,
+            bench_random_f32(&random) * height,
+            origin + bench_random_f32(&random) * extent,
+        };
+        glm_vec3_sub(target, ray->origin, ray->direction);
+        glm_vec3_normalize(ray->direction);
+    }
+}
+
+static void micro_setup_chunk(micro_state_t* state) {
+    if (!state->chunk) {
+        state->chunk = calloc(1, sizeof(chunk_t));
+    }
+    // positions are shared with the world kernels
+    micro_setup_world(state);
+}
+
+static void micro_chunk_generate(micro_state_t* state, u32 sample) {
+    glm_ivec3_copy(state->positions[sample % MICRO_POINTS], state->chunk->position);
+    chunk_generate(state->chunk, NULL);
+}
+
+// Only the CPU half, the upload is stubbed out in headless builds
+static void micro_chunk_mesh(micro_state_t* state, u32 sample) {
+    chunk_build_mesh(state->loaded[sample % state->loaded_count], state->world);
+}
+
+static void micro_setup_mesh(micro_state_t* state) {
+    if (!state->mesh.vertices) {
+        state->mesh.vertices = malloc(sizeof(vertex_t) * 4 * MICRO_POINTS);
+        state->mesh.indices = malloc(sizeof(u32) * 6 * MICRO_POINTS);
+    }
+}
+
+static void micro_block_mesh_face(micro_state_t* state, u32 sample) {
+    (void)sample;
+    block_t block = { .id = 1 };
+    state->mesh.vertex_count = 0;
+    state->mesh.index_count = 0;
+
+    for (u32 i = 0; i < MICRO_POINTS; i++) {
+        ivec3 position = {
+            (i32)(i % CHUNK_SIZE),
+            (i32)(i / CHUNK_SIZE % CHUNK_SIZE),
+            (i32)(i / (CHUNK_SIZE * CHUNK_SIZE) % CHUNK_SIZE),
+        };
+        block_mesh_face(&state->mesh, position, (block_face_t)(i % 6), &block);
+    }
+}
+
+static void micro_ray_intersect_block(micro_state_t* state, u32 sample) {
+    u32 hits = 0;
+    for (u32 i = 0; i < MICRO_RAYS_PER_SAMPLE; i++) {
+        ivec3 block_position;
+        hits += ray_intersect_block(
+            state->rays[(sample * MICRO_RAYS_PER_SAMPLE + i) % MICRO_RAYS],
+            state->world,
+            MICRO_RAY_RANGE,
+            BLOCK_FLAG_SOLID,
+            &block_position,
+            NULL,
+            NULL
+        );
+    }
+    micro_sink += (f32)hits;
+}
+
+static void micro_world_get_chunk(micro_state_t* state, u32 sample) {
+    (void)sample;
+    u32 found = 0;
+    for (u32 i = 0; i < MICRO_POINTS; i++) {
+        found += world_get_chunk(state->world, state->positions[i]) != NULL;
+    }
+    micro_sink += (f32)found;
+}
+
+static void micro_save_chunk_position(u32 i, ivec3 position) {
+    position[0] = (i32)(i % 16) - 8;
+    position[1] = (i32)(i / 16 % MICRO_WORLD_HEIGHT);
+    position[2] = (i32)(i / (16 * MICRO_WORLD_HEIGHT)) - 2;
+}
+
+// Generated chunks with a few edits each, so the save stores them
+static void micro_setup_save(micro_state_t* state) {
+    if (state->save_blocks) {
+        return;
+    }
+
+    bench_temp_path(MICRO_SAVE_NAME, state->save_path, sizeof(state->save_path));
+    state->save_blocks = malloc((usize)MICRO_SAVE_CHUNKS * CHUNK_BLOCK_COUNT);
+    state->scratch = malloc(CHUNK_BLOCK_COUNT);
+    if (!state->chunk) {
+        state->chunk = calloc(1, sizeof(chunk_t));
+    }
+
+    u64 random = state->seed;
+    for (u32 i = 0; i < MICRO_SAVE_CHUNKS; i++) {
+        block_id_t* blocks = state->save_blocks + (usize)i * CHUNK_BLOCK_COUNT;
+        ivec3 position;
+        micro_save_chunk_position(i, position);
+        chunk_generate_blocks(position, NULL, blocks);
+
+        for (u32 edit = 0; edit < 32; edit++) {
+            u32 index = (u32)(bench_random(&random) % CHUNK_BLOCK_COUNT);
+            blocks[index] = (block_id_t)(bench_random(&random) % BLOCK_ID_MAX);
+        }
+    }
+}
+
+// A new save holding every chunk
+static void micro_prepare_save_write(micro_state_t* state) {
+    if (state->save) {
+        save_free(state->save);
+    }
+    state->save = save_new();
+    state->save->world.seed = state->seed;
+
+    for (u32 i = 0; i < MICRO_SAVE_CHUNKS; i++) {
+        const block_id_t* blocks = state->save_blocks + (usize)i * CHUNK_BLOCK_COUNT;
+        micro_save_chunk_position(i, state->chunk->position);
+        for (u32 j = 0; j < CHUNK_BLOCK_COUNT; j++) {
+            state->chunk->blocks[j].id = blocks[j];
+        }
+        save_add_chunk(state->save, state->chunk);
+    }
+}
+
+static void micro_save_write(micro_state_t* state, u32 sample) {
+    (void)sample;
+    save_write(state->save, state->save_path);
+}
+
+static void micro_setup_save_read(micro_state_t* state) {
+    micro_setup_save(state);
+    micro_prepare_save_write(state);
+    save_write(state->save, state->save_path);
+}
+
+static void micro_prepare_save_read(micro_state_t* state) {
+    if (state->save) {
+        save_free(state->save);
+        state->save = NULL;
+    }
+}
+
+// Loading the save and reading every chunk back, per chunk
+static void micro_save_read(micro_state_t* state, u32 sample) {
+    (void)sample;
+    state->save = save_load(state->save_path);
+    if (!state->save) {
+        LOG_ERROR("Failed to load %s\n", state->save_path);
+        exit(1);
+    }
+
+    u32 missing = 0;
+    for (u32 i = 0; i < MICRO_SAVE_CHUNKS; i++) {
+        ivec3 position;
+        micro_save_chunk_position(i, position);
+        missing += save_get_chunk_blocks(state->save, position, state->scratch) == NULL;
+    }
+    if (missing) {
+        LOG_ERROR("%u saved chunks were missing when read back\n", missing);
+        exit(1);
+    }
+}
+
+static const micro_kernel_t micro_kernels[] = {
+    { "perlin2d", MICRO_POINTS, 200, micro_setup_noise, NULL, micro_perlin2d },
+    { "perlin3d", MICRO_POINTS, 200, micro_setup_noise, NULL, micro_perlin3d },
+    { "chunk_generate", 1, 500, micro_setup_chunk, NULL, micro_chunk_generate },
+    { "chunk_mesh", 1, 500, micro_setup_world, NULL, micro_chunk_mesh },
+    { "block_mesh_face", MICRO_POINTS, 200, micro_setup_mesh, NULL, micro_block_mesh_face },
+    {
+        "ray_intersect_block",
+        MICRO_RAYS_PER_SAMPLE,
+        200,
+        micro_setup_world,
+        NULL,
+        micro_ray_intersect_block,
+    },
+    { "world_get_chunk", MICRO_POINTS, 200, micro_setup_world, NULL, micro_world_get_chunk },
+    {
+        "save_write",
+        MICRO_SAVE_CHUNKS,
+        30,
+        micro_setup_save,
+        micro_prepare_save_write,
+        micro_save_write,
+    },
+    {
+        "save_read",
+        MICRO_SAVE_CHUNKS,
+        30,
+        micro_setup_save_read,
+        micro_prepare_save_read,
+        micro_save_read,
+    },
+};
+
+#define MICRO_KERNEL_COUNT (sizeof(micro_kernels) / sizeof(micro_kernels[0]))
+
+static micro_args_t micro_parse_args(int argc, char** argv) {
+    micro_args_t args = {
+        .seed = 1,
+        .warmup = 10,
+        .threshold = 10.0,
+    };
+    args.kernels = malloc(sizeof(const char*) * (usize)argc);
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--samples") == 0 && has_value) {
+            args.samples = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--warmup") == 0 && has_value) {
+            args.warmup = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            args.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+            args.baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && has_value) {
+            args.threshold = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--list") == 0) {
+            for (u32 k = 0; k < MICRO_KERNEL_COUNT; k++) {
+                printf("%s\n", micro_kernels[k].name);
+            }
+            exit(0);
+        } else if (argv[i][0] != '-') {
+            args.kernels[args.kernel_count++] = argv[i];
+        } else {
+            LOG_ERROR("Unknown or incomplete argument %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    for (u32 i = 0; i < args.kernel_count; i++) {
+        bool known = false;
+        for (u32 k = 0; k < MICRO_KERNEL_COUNT; k++) {
+            known |= strcmp(args.kernels[i], micro_kernels[k].name) == 0;
+        }
+        if (!known) {
+            LOG_ERROR("Unknown kernel %s, see --list\n", args.kernels[i]);
+            exit(1);
+        }
+    }
+    return args;
+}
+
+static bool micro_is_selected(const micro_args_t* args, const char* name) {
+    if (!args->kernel_count) {
+        return true;
+    }
+    for (u32 i = 0; i < args->kernel_count; i++) {
+        if (strcmp(args->kernels[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The earlier run's output as a string, NULL if it can't be read
+static char* micro_read_baseline(const char* path) {
+    file_map_t map;
+    if (!file_map_open(&map, path)) {
+        LOG_ERROR("Failed to open baseline %s\n", path);
+        return NULL;
+    }
+
+    char* text = malloc(map.size + 1);
+    memcpy(text, map.data, map.size);
+    text[map.size] = '\0';
+    file_map_close(&map);
+    return text;
+}
+
+// A kernel's median in an earlier run's output, 0 if it isn't there
+static f64 micro_baseline_median(const char* baseline, const char* name) {
+    char needle[64];
+    snprintf(needle, sizeof(needle), "\"name\": \"%s\"", name);
+
+    const char* kernel = strstr(baseline, needle);
+    const char* median = kernel ? strstr(kernel, "\"median_ns\":") : NULL;
+    f64 value = 0.0;
+    if (!median || sscanf(median, "\"median_ns\": %lf", &value) != 1) {
+        return 0.0;
+    }
+    return value;
+}
+
+// Time a kernel and print its JSON object, returns whether it regressed past the baseline
+static bool micro_run(
+    const micro_kernel_t* kernel,
+    micro_state_t* state,
+    const micro_args_t* args,
+    const char* baseline,
+    bool first
+) {
+    u32 samples = args->samples ? args->samples : kernel->samples;
+    f64* times = malloc(sizeof(f64) * samples);
+
+    kernel->setup(state);
+    for (u32 i = 0; i < args->warmup + samples; i++) {
+        if (kernel->prepare) {
+            kernel->prepare(state);
+        }
+
+        f64 start = time_now_ms();
+        kernel->run(state, i);
+        f64 ns = (time_now_ms() - start) * 1000000.0 / (f64)kernel->calls;
+
+        if (i >= args->warmup) {
+            times[i - args->warmup] = ns;
+        }
+    }
+
+    f64 total = 0.0;
+    for (u32 i = 0; i < samples; i++) {
+        total += times[i];
+    }
+    bench_sort(times, samples);
+    f64 median = bench_percentile(times, samples, 50.0);
+
+    printf(
+        "%s    {\n"
+        "      \"name\": \"%s\",\n"
+        "      \"calls\": %u,\n"
+        "      \"samples\": %u,\n"
+        "      \"median_ns\": %.3f,\n"
+        "      \"p99_ns\": %.3f,\n"
+        "      \"min_ns\": %.3f,\n"
+        "      \"mean_ns\": %.3f,\n"
+        "      \"max_ns\": %.3f",
+        first ? "" : ",\n",
+        kernel->name,
+        kernel->calls,
+        samples,
+        median,
+        bench_percentile(times, samples, 99.0),
+        times[0],
+        total / (f64)samples,
+        times[samples - 1]
+    );
+
+    bool regressed = false;
+    f64 baseline_median = baseline ? micro_baseline_median(baseline, kernel->name) : 0.0;
+    if (baseline_median > 0.0) {
+        f64 change = (median - baseline_median) / baseline_median * 100.0;
+        regressed = change > args->threshold;
+        printf(
+            ",\n"
+            "      \"baseline_median_ns\": %.3f,\n"
+            "      \"change_percent\": %.2f,\n"
+            "      \"regressed\": %s",
+            baseline_median,
+            change,
+            regressed ? "true" : "false"
+        );
+
+        if (regressed) {
+            LOG_WARNING(
+                "%s: %.1f ns per call, %+.1f%% from the baseline's %.1f ns\n",
+                kernel->name,
+                median,
+                change,
+                baseline_median
+            );
+        } else {
+            LOG_INFO(
+                "%s: %.1f ns per call, %+.1f%% from the baseline\n",
+                kernel->name,
+                median,
+                change
+            );
+        }
+    } else if (baseline) {
+        LOG_WARNING("%s isn't in the baseline\n", kernel->name);
+    }
+
+    printf("\n    }");
+    fflush(stdout);
+    free(times);
+    return regressed;
+}
+
+int main(int argc, char** argv) {
+    log_init();
+    micro_args_t args = micro_parse_args(argc, argv);
+
+    char* baseline = NULL;
+    if (args.baseline) {
+        baseline = micro_read_baseline(args.baseline);
+        if (!baseline) {
+            return 1;
+        }
+    }
+
+    u32 cores = thread_hardware_concurrency();
+    job_pool_init(&g_job_pool, cores > 1 ? cores - 1 : 0);
+    world_generator_init(args.seed);
+    // loaded chunks come from the generator, like in a new game
+    g_save = save_new();
+    g_save->world.seed = args.seed;
+
+    micro_state_t* state = calloc(1, sizeof(micro_state_t));
+    state->seed = args.seed;
+
+    printf("{\n");
+    printf("  \"seed\": %llu,\n", (unsigned long long)args.seed);
+    printf("  \"kernels\": [\n");
+
+    u32 regressions = 0;
+    bool first = true;
+    for (u32 k = 0; k < MICRO_KERNEL_COUNT; k++) {
+        if (micro_is_selected(&args, micro_kernels[k].name)) {
+            regressions += micro_run(&micro_kernels[k], state, &args, baseline, first);
+            first = false;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    if (regressions) {
+        LOG_ERROR(
+            "%u kernels regressed by more than %.1f%%\n",
+            regressions,
+            args.threshold
+        );
+    }
+
+    if (state->save) {
+        save_free(state->save);
+    }
+    // whichever save kernel ran last, the file lists every region written
+    save_t* written = state->save_blocks ? save_load(state->save_path) : NULL;
+    if (written) {
+        save_remove(written, state->save_path);
+        save_free(written);
+    }
+    if (state->world) {
+        world_free(state->world);
+    }
+    free(state->mesh.vertices);
+    free(state->mesh.indices);
+    free(state->loaded);
+    free(state->chunk);
+    free(state->save_blocks);
+    free(state->scratch);
+    free(state);
+    free(baseline);
+    free(args.kernels);
+
+    save_free(g_save);
+    job_pool_free(&g_job_pool);
+    log_close();
+    return regressions ? 1 : 0;
+}
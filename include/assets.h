@@ -3,6 +3,20 @@
 #include "types.h"
 
 #define ASSET_PATH "assets/"
+// Looked up in the executable's directory unless --asset-pack is given
+#define ASSET_PACK_PATH "assets.pak"
+
+// Mount the build's asset source, the data compiled in from asset_data.h or, when built with
+// ASSET_SOURCE_PACK, the pack at pack_path mapped read-only
+bool assets_open(const char* pack_path);
+void assets_close(void);
+
+// Asset by its path under assets/ without the extension, e.g. "shaders/world_vert"
+// Points straight into the embedded data or the mapping, NULL when there's no such asset
+const u8* asset_get(const char* name, usize* size);
+
+// Same, for text assets, which are always NUL terminated. Missing assets give ""
+const char* asset_get_text(const char* name);
 
 u8* read_file(const char* path, usize* size);
 u8* read_asset(const char* path, usize* size);
@@ -12,6 +26,8 @@ void free_file(u8* file);
 #define ATLAS_TEXTURE_SLOT_SIZE 16
 #define ATLAS_TEXTURE_SLOT_COUNT 16
 #define ATLAS_TEXTURE_SIZE (ATLAS_TEXTURE_SLOT_SIZE * ATLAS_TEXTURE_SLOT_SIZE)
+// Smallest mip level where a texel stays inside one slot, below it blocks blend together
+#define ATLAS_TEXTURE_MAX_LEVEL 4
 
 #define ATLAS_TEXTURE_SLOT_UV(x, y)                                                            \
     { (f32)(x) / (f32)ATLAS_TEXTURE_SLOT_COUNT, (f32)(y) / (f32)ATLAS_TEXTURE_SLOT_COUNT }
@@ -48,8 +64,41 @@ typedef struct texture {
 
 extern texture_t g_magic_pixel;
 
+#define TEXTURE_MAX_LEVELS 16
+
+typedef struct texture_level {
+    const u8* data;
+    u32 width;
+    u32 height;
+    u32 size;
+} texture_level_t;
+
+// CPU half of a texture load, decoding touches no GL state so it can run on any thread
+// Levels point into the source data when it's already in upload form, so it has to outlive
+// the image
+typedef struct texture_image {
+    i32 width;
+    i32 height;
+    i32 channels;
+    u32 format; // GL_RGB, GL_RGBA or GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+    bool generate_mipmaps;
+    texture_level_t levels[TEXTURE_MAX_LEVELS];
+    u32 level_count;
+    // last mip level sampled, 0 for all of them
+    u32 max_level;
+    // decoded copies, freed with the image
+    u8* owned[TEXTURE_MAX_LEVELS];
+} texture_image_t;
+
+bool texture_decode(texture_image_t* image, const u8* data, usize size);
+// GL half, on the thread that owns the context
+texture_t texture_upload(texture_image_t* image);
+void texture_image_free(texture_image_t* image);
+
 texture_t texture_load(const char* path);
 texture_t texture_load_from_memory(const u8* data, usize size);
+// Texture from asset_get, baked or not
+texture_t texture_load_asset(const char* name);
 texture_t texture_load_from_memory_raw(u8* data, i32 width, i32 height, i32 channels);
 
 void texture_free(texture_t* texture);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mesh.h"
+#include "physics.h"
 #include "shader.h"
 #include "types.h"
 #include "world.h"
@@ -36,6 +37,8 @@ void camera_screen_to_world(
     vec3* world_position,
     vec3* world_direction
 );
+// Ray from the camera through the middle of the window
+void ray_from_camera(ray_t* ray, camera_t* camera);
 bool camera_pointed_block(
     camera_t* camera,
     world_t* world,
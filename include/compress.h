@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+
+// Small-buffer codecs for save data, values are stored in files so never renumber them
+typedef enum compress_encoding {
+    COMPRESS_RAW = 0,
+    // (run length - 1, byte) pairs, runs of up to 256
+    COMPRESS_RLE = 1,
+    // LZ4 block format: literal runs and back references of up to 64 KiB
+    COMPRESS_LZ = 2,
+    COMPRESS_ENCODING_COUNT,
+} compress_encoding_t;
+
+extern const char* compress_encoding_names[COMPRESS_ENCODING_COUNT];
+
+// Size written to dst, 0 if the result wouldn't fit in capacity
+usize compress_encode(
+    compress_encoding_t encoding,
+    const u8* src,
+    usize size,
+    u8* dst,
+    usize capacity
+);
+
+// Fails unless src decodes to exactly dst_size bytes, never reads or writes out of bounds
+bool compress_decode(
+    compress_encoding_t encoding,
+    const u8* src,
+    usize size,
+    u8* dst,
+    usize dst_size
+);
@@ -1,4 +1,4 @@
 #pragma once
 
 #include "types.h"
-#define SAVE_FORMAT_VERSION 1
+#define SAVE_FORMAT_VERSION 5
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+
+// Texture container baked at build time by tools/texbake.c, so startup uploads it as is
+// instead of decoding a PNG and generating mipmaps
+//
+// Layout: ctex_header_t, mip_count ctex_level_t, then the level data, largest first
+// All fields are little endian
+
+#define CTEX_MAGIC_STR "CTEX"
+#define CTEX_FORMAT_VERSION 1
+#define CTEX_MAX_LEVELS 16
+
+typedef enum ctex_format {
+    CTEX_FORMAT_RGBA8, // 4 bytes per pixel
+    CTEX_FORMAT_BC1,   // 8 bytes per 4x4 block, 1 bit alpha
+} ctex_format_t;
+
+typedef struct ctex_header {
+    u32 magic;
+    u32 format_version;
+    u32 format;
+    u32 width;
+    u32 height;
+    // channels of the source image, the baked data always has alpha
+    u32 channels;
+    u32 mip_count;
+} ctex_header_t;
+
+typedef struct ctex_level {
+    u32 width;
+    u32 height;
+    // from the start of the file
+    u32 offset;
+    u32 size;
+} ctex_level_t;
+
+inline static u32 ctex_level_size(ctex_format_t format, u32 width, u32 height) {
+    if (format == CTEX_FORMAT_BC1) {
+        return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+    }
+
+    return width * height * 4;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "types.h"
+
+// Read-only mapping of a whole file, pages are only read in once touched
+typedef struct file_map {
+    const u8* data;
+    usize size;
+
+    // platform mapping handles
+    void* file_handle;
+    void* mapping_handle;
+} file_map_t;
+
+// Fails for missing and empty files
+bool file_map_open(file_map_t* map, const char* path);
+
+void file_map_close(file_map_t* map);
@@ -3,9 +3,11 @@
 #include "assets.h"
 #include "lighting.h"
 #include "mesh.h"
+#include "render_queue.h"
 #include "shader.h"
 #include "types.h"
 #include "ui.h"
+#include "uniforms.h"
 #include "world.h"
 
 typedef void (*window_size_callback)(int width, int height);
@@ -18,9 +20,8 @@ typedef struct content {
     texture_t sun;
 
     shader_t sprite_shader;
-    shader_t world_shader;
-    shader_t unlit_shader;
-    shader_t gizmo_shader;
+    // world, sun and gizmos, one permutation per feature set, see game_world_features
+    shader_base_t world_shader;
     shader_t ui_shader;
     shader_t shadow_shader;
 
@@ -41,8 +42,18 @@ typedef struct game_state {
     content_t content;
     instances_t instances;
     ui_t ui;
+    uniform_buffers_t uniforms;
+    render_queue_t render_queue;
+    // Last captured frame, replayed instead of the live queue while replay is on
+    render_queue_t render_capture;
     world_t* world; // big, stored on heap
+    // starting chunks, generating from game_load_content until game_init
+    world_load_t world_load;
     f32 time;
+    // seconds since the dirty chunks were last flushed to the save journal
+    f32 journal_timer;
+    // main thread time the last autosave took
+    f64 autosave_ms;
     vec3 sky_color;
     GLuint depth_map_fbo;
 } game_state_t;
@@ -55,10 +66,21 @@ int game_init(void);
 
 void game_update(f32 delta_time);
 
+// Features the world is drawn with this frame, following the debug toggles and the
+// sun's shadow quality
+u32 game_world_features(void);
+
 void game_draw(void);
 
 void game_draw_debug(void);
 
 void game_draw_ui(void);
 
+// Sort and execute everything submitted by the draw functions this frame
+void game_render(void);
+
+// Render the same frame with every shadow quality tier and log the average frame time of
+// each, relative to shadows off. Meant for headless runs, see `just bench-shadows`.
+void game_bench_shadows(u32 frames);
+
 void game_free(void);
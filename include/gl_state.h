@@ -0,0 +1,59 @@
+#pragma once
+
+#include "types.h"
+
+#include <GL/glew.h>
+
+// Thin cache in front of the GL state machine
+// All binds and capability toggles should go through here, so redundant
+// calls can be skipped. Anything that changes GL state behind its back
+// (ImGui, debug tools) has to call gl_state_invalidate afterwards.
+
+#define GL_STATE_TEXTURE_UNITS 8
+// Texture targets tracked per unit, see gl_state_target_index
+#define GL_STATE_TEXTURE_TARGETS 2
+
+typedef struct gl_state_stats {
+    u32 issued;
+    u32 skipped;
+} gl_state_stats_t;
+
+typedef struct gl_state {
+    GLuint program;
+    GLuint vertex_array;
+    GLuint framebuffer;
+    u32 active_texture_unit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGETS];
+    GLint viewport[4];
+    // -1 unknown, 0 disabled, 1 enabled
+    i8 blend;
+    i8 depth_test;
+    i8 cull_face;
+
+    gl_state_stats_t frame_stats;
+    gl_state_stats_t last_frame_stats;
+} gl_state_t;
+
+extern gl_state_t g_gl_state;
+
+// Forget all cached state, the next call of every kind will be issued
+void gl_state_invalidate(void);
+
+// Roll the per-frame issued/skipped counters into last_frame_stats
+void gl_state_frame_end(void);
+
+void gl_state_use_program(GLuint program);
+void gl_state_bind_vertex_array(GLuint vertex_array);
+void gl_state_bind_framebuffer(GLuint framebuffer);
+void gl_state_bind_texture(u32 unit, GLenum target, GLuint texture);
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+void gl_state_set_blend(bool enabled);
+void gl_state_set_depth_test(bool enabled);
+void gl_state_set_cull_face(bool enabled);
+
+// Call before deleting an object, so a recycled name isn't mistaken for a bound one
+void gl_state_forget_program(GLuint program);
+void gl_state_forget_vertex_array(GLuint vertex_array);
+void gl_state_forget_framebuffer(GLuint framebuffer);
+void gl_state_forget_texture(GLuint texture);
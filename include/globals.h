@@ -43,6 +43,8 @@ typedef struct debug_tools {
     bool no_chunk_load;
     bool no_lighting;
     bool force_day;
+    bool capture_render_queue;
+    bool replay_render_queue;
 } debug_tools_t;
 
 extern debug_tools_t g_debug_tools;
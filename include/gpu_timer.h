@@ -0,0 +1,54 @@
+#pragma once
+
+#include "render_queue.h"
+#include "types.h"
+
+#include <GL/glew.h>
+
+// GPU time of every render pass and of ImGui, from GL_TIME_ELAPSED queries
+// Each frame records into its own set of queries and reads back the set recorded
+// GPU_TIMER_FRAMES - 1 frames earlier, only if the GPU is done with it, so the CPU never
+// waits for the results. Without timer queries everything here does nothing.
+
+#define GPU_TIMER_FRAMES 3
+
+// Timers of the render passes are their render_pass_id_t
+#define GPU_TIMER_IMGUI RENDER_PASS_COUNT
+#define GPU_TIMER_COUNT (RENDER_PASS_COUNT + 1)
+
+// GPU_TIMER_COUNT of them
+extern const char* gpu_timer_names[];
+
+typedef struct gpu_timers {
+    bool supported;
+
+    GLuint queries[GPU_TIMER_FRAMES][GPU_TIMER_COUNT];
+    bool issued[GPU_TIMER_FRAMES][GPU_TIMER_COUNT];
+    u32 frame; // set of queries being recorded
+    // timer between gpu_timer_begin and gpu_timer_end, -1 for none, queries can't overlap
+    i32 active;
+
+    // last frame read back, 0 for timers that didn't run in it
+    f64 last_ms[GPU_TIMER_COUNT];
+    // per frame over the last second of frames read back
+    f64 average_ms[GPU_TIMER_COUNT];
+    f64 average_total_ms;
+    // frames whose queries were reused before the GPU finished them, their results are lost
+    u32 late_frames;
+
+    f64 window_seconds;
+    f64 window_ms[GPU_TIMER_COUNT];
+    u32 window_frames;
+} gpu_timers_t;
+
+extern gpu_timers_t g_gpu_timers;
+
+// Needs the GL context
+void gpu_timers_init(void);
+void gpu_timers_free(void);
+
+void gpu_timer_begin(u32 timer);
+void gpu_timer_end(u32 timer);
+
+// Move on to the next set of queries, reading back its previous results first
+void gpu_timers_frame_end(f32 delta_time);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "thread.h"
+#include "types.h"
+
+#define JOB_POOL_MAX_THREADS 16
+
+typedef void (*job_fn)(void* arg);
+
+// Counts a batch of outstanding jobs, see job_group_wait
+typedef struct job_group {
+    u32 pending;
+    f64 done_ms; // time_now_ms when pending last dropped to 0
+} job_group_t;
+
+typedef struct job {
+    job_fn fn;
+    void* arg;
+    job_group_t* group;
+} job_t;
+
+// Fixed set of worker threads pulling from one FIFO queue
+typedef struct job_pool {
+    thread_t threads[JOB_POOL_MAX_THREADS];
+    u32 thread_count;
+
+    // ring buffer, grows when full
+    job_t* queue;
+    usize queue_capacity;
+    usize queue_head;
+    usize queue_count;
+
+    mutex_t mutex;
+    cond_t work_available;
+    cond_t job_done;
+    bool stopping;
+} job_pool_t;
+
+extern job_pool_t g_job_pool;
+
+// With 0 threads jobs run on the thread that waits for them
+void job_pool_init(job_pool_t* pool, u32 thread_count);
+
+// Runs whatever is still queued, then joins the workers
+void job_pool_free(job_pool_t* pool);
+
+// group may be NULL for fire and forget jobs
+// Without job_pool_init the job runs right away on the calling thread
+void job_submit(job_pool_t* pool, job_group_t* group, job_fn fn, void* arg);
+
+// Block until every job of the group ran, running queued jobs in the meantime
+void job_group_wait(job_pool_t* pool, job_group_t* group);
+// Whether every job of the group ran, without waiting or running any
+bool job_group_done(job_pool_t* pool, job_group_t* group);
+
+// 0 on threads outside the pool, 1 and up on its workers
+u32 job_worker_index(void);
+
+// Jobs waiting for a worker
+usize job_pool_queued(job_pool_t* pool);
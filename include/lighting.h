@@ -1,35 +1,127 @@
 #pragma once
 
+#include "render_queue.h"
 #include "shader.h"
 #include "types.h"
+#include "uniforms.h"
 
 #include <GL/glew.h>
 #include <cglm/types.h>
 
-#define SHADOW_MAP_SIZE 8192
+// Most cascades a sun can have, one render pass and one FrameUniforms matrix each
+#define SHADOW_CASCADE_MAX UNIFORMS_SHADOW_CASCADES
 
-// shadow map framebuffer
+// How far behind a cascade (towards the sun) casters are still rendered
+#define SHADOW_CASTER_DISTANCE 96.0f
+
+// Shadow filtering, each tier is its own world shader permutation, see
+// shadow_quality_features
+typedef enum shadow_quality {
+    SHADOW_QUALITY_OFF,       // no shadow passes, no shadow sampling
+    SHADOW_QUALITY_HARD,      // 1 hardware PCF tap
+    SHADOW_QUALITY_POISSON_4, // 4 hardware PCF taps on a Poisson disk rotated per pixel
+    SHADOW_QUALITY_POISSON_9, // 9 hardware PCF taps on a hashed Poisson disk
+    SHADOW_QUALITY_COUNT,
+} shadow_quality_t;
+
+// Short names used on the command line and in the Debug window
+extern const char* shadow_quality_names[SHADOW_QUALITY_COUNT];
+
+// Shader features selecting the tier in world_frag.glsl, 0 for SHADOW_QUALITY_OFF
+u32 shadow_quality_features(shadow_quality_t quality);
+
+// Side of the tiled per-pixel rotation texture used by SHADOW_QUALITY_POISSON_4
+#define SHADOW_NOISE_SIZE 32
+
+typedef enum shadow_depth_format {
+    SHADOW_DEPTH_16,
+    SHADOW_DEPTH_24,
+} shadow_depth_format_t;
+
+typedef struct shadow_settings {
+    shadow_quality_t quality;
+    u32 cascade_count; // 1 to SHADOW_CASCADE_MAX
+    u32 resolution;    // width and height of every cascade
+    shadow_depth_format_t depth_format;
+    f32 max_distance; // view distance covered by the last cascade
+    // 0 splits the view range evenly, 1 logarithmically
+    f32 split_lambda;
+    // Cascades are fitted this much larger than needed, so they can be reused until the
+    // camera leaves the padded volume
+    f32 cache_padding;
+    // Light direction change in degrees that forces a cascade to re-render
+    f32 light_angle_threshold;
+} shadow_settings_t;
+
+// 3 cascades of 2048x2048 at 16 bits, 24 MiB
+#define SHADOW_SETTINGS_DEFAULT                                                                \
+    ((shadow_settings_t){                                                                      \
+        .quality = SHADOW_QUALITY_POISSON_4,                                                   \
+        .cascade_count = 3,                                                                    \
+        .resolution = 2048,                                                                    \
+        .depth_format = SHADOW_DEPTH_16,                                                       \
+        .max_distance = 160.0f,                                                                \
+        .split_lambda = 0.75f,                                                                 \
+        .cache_padding = 0.2f,                                                                 \
+        .light_angle_threshold = 0.5f,                                                         \
+    })
+
+// Cascaded shadow map, one layer of a depth texture array per cascade
+// Every layer gets its own framebuffer so each cascade can be its own render pass
+// Comparison is done by the sampler, shaders read it as a sampler2DArrayShadow
 typedef struct shadow_map {
-    GLuint fbo;
     GLuint texture;
-    GLuint depth;
+    GLuint noise_texture;
+    GLuint fbos[SHADOW_CASCADE_MAX];
+    shadow_settings_t settings;
 } shadow_map_t;
 
-void shadow_map_init(shadow_map_t* shadow_map);
+void shadow_map_init(shadow_map_t* shadow_map, shadow_settings_t settings);
+
+void shadow_map_free(shadow_map_t* shadow_map);
 
-void shadow_map_bind(shadow_map_t* shadow_map);
+// Texture memory used by the shadow map, in bytes
+usize shadow_map_size_bytes(shadow_map_t* shadow_map);
 
-void shadow_map_unbind(void);
+// A cascade's depth is kept between frames and only re-rendered when it goes stale,
+// see light_sun_shadow_update
+typedef struct shadow_cascade {
+    mat4 view_projection;
+    // far end of the cascade's slice of the view, in view space distance
+    f32 split;
+    // chunks submitted to the cascade's pass last time it rendered
+    u32 caster_count;
 
-void shadow_map_free(shadow_map_t* shadow_map);
+    bool valid;
+    // volume the cached depth covers, and the light direction it was rendered with
+    vec3 center;
+    f32 radius;
+    vec3 light_direction;
+} shadow_cascade_t;
+
+typedef struct shadow_stats {
+    // cascade renders recorded this frame
+    u32 frame_renders;
+
+    // rolled over once a second
+    f32 renders_per_second;
+    f64 average_pass_ms;
+
+    f64 window_seconds;
+    u32 window_renders;
+    f64 window_pass_ms;
+} shadow_stats_t;
 
 typedef struct light_sun {
     vec3 position;
     vec3 direction;
     vec3 color;
     f32 intensity;
-    mat4 light_view_projection;
     shadow_map_t shadow_map;
+    shadow_cascade_t cascades[SHADOW_CASCADE_MAX];
+    // next far cascade to get a turn at re-rendering
+    u32 next_far_cascade;
+    shadow_stats_t stats;
 } light_sun_t;
 
 void light_sun_init(
@@ -42,6 +134,37 @@ void light_sun_init(
 
 void light_sun_free(light_sun_t* light_sun);
 
-void light_sun_shadow_update(light_sun_t* light_sun);
+// Reallocate the shadow map with new settings
+void light_sun_set_shadow_settings(light_sun_t* light_sun, shadow_settings_t settings);
+
+// Fit the cascades to the camera described by view and projection and record a shadow pass
+// for every cascade that went stale: the camera left its volume, the light turned past
+// light_angle_threshold, or a chunk inside it changed. The nearest cascade and cascades
+// that were invalidated are re-rendered right away, other far cascades take turns, one per
+// frame. The shadow map is only written when the queue executes.
+void light_sun_shadow_update(
+    light_sun_t* light_sun,
+    render_queue_t* queue,
+    mat4 view,
+    mat4 projection
+);
+
+// Switch filtering tier, the shadow map itself is kept
+void light_sun_set_shadow_quality(light_sun_t* light_sun, shadow_quality_t quality);
+
+// Drop all cached cascades, they re-render on the next update
+void light_sun_shadow_invalidate(light_sun_t* light_sun);
+
+// Account the shadow passes the queue just executed, call after render_queue_execute
+void light_sun_shadow_frame_end(
+    light_sun_t* light_sun,
+    render_queue_stats_t* queue_stats,
+    f32 delta_time
+);
+
+// Bind the shadow map depth texture array to the given texture unit, and the rotation
+// noise to the unit after it
+void light_sun_shadow_bind(light_sun_t* light_sun, u32 slot);
 
-void light_sun_shadow_set_uniforms(light_sun_t* light_sun, shader_t* shader);
+// Fill in the light direction, intensity and cascade matrices of the frame uniforms
+void light_sun_set_frame_uniforms(light_sun_t* light_sun, frame_uniforms_t* frame);
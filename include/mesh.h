@@ -1,5 +1,6 @@
 #pragma once
 
+#include "render_queue.h"
 #include "types.h"
 #include <cglm/types.h>
 #include <GL/glew.h>
@@ -38,5 +39,15 @@ mesh_instance_t mesh_instance_new(mesh_t* mesh);
 
 void mesh_instance_draw(mesh_instance_t* instance);
 
+// Record the instance into a render queue pass, sorted by its distance from eye
+void mesh_instance_submit(
+    mesh_instance_t* instance,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye
+);
+
 // Requires all mesh instances to have the same mesh
 void mesh_instance_batch_draw(mesh_instance_t* instances, usize count);
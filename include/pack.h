@@ -0,0 +1,46 @@
+#pragma once
+
+#include "file_map.h"
+#include "types.h"
+
+// Asset archive written at build time by tools/assetpack.c and mapped read-only at runtime
+//
+// Layout: pack_header_t, entry_count pack_entry_t sorted by name, then the data
+// Every entry's data is followed by a NUL byte not counted in its size, so text assets can
+// be used as C strings straight from the mapping
+
+#define PACK_MAGIC_STR "CPAK"
+#define PACK_FORMAT_VERSION 1
+#define PACK_NAME_MAX 56
+#define PACK_DATA_ALIGNMENT 16
+
+typedef struct pack_header {
+    u32 magic;
+    u32 format_version;
+    u32 entry_count;
+    u32 reserved;
+} pack_header_t;
+
+typedef struct pack_entry {
+    // path under assets/ without the extension, NUL padded
+    char name[PACK_NAME_MAX];
+    u32 offset; // from the start of the file
+    u32 size;
+} pack_entry_t;
+
+typedef struct pack {
+    const u8* data;
+    usize size;
+    const pack_entry_t* entries;
+    u32 entry_count;
+
+    file_map_t map;
+} pack_t;
+
+// Map the whole file, pages are only read in once an asset is touched
+bool pack_open(pack_t* pack, const char* path);
+
+void pack_close(pack_t* pack);
+
+// Pointer into the mapping, NULL when the pack has no such asset
+const u8* pack_find(const pack_t* pack, const char* name, usize* size);
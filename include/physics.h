@@ -3,7 +3,6 @@
 #include <cglm/cglm.h>
 #include <cglm/types.h>
 
-#include "camera.h"
 #include "math.h"
 #include "glm_extra.h"
 #include "world.h"
@@ -13,8 +12,6 @@ typedef struct ray {
     vec3 direction;
 } ray_t;
 
-void ray_from_camera(ray_t* ray, camera_t* camera);
-
 bool ray_intersect_block(
     ray_t r,
     world_t* world,
@@ -6,6 +6,7 @@
 #include <GLFW/glfw3.h>
 
 #include "camera.h"
+#include "uniforms.h"
 
 #define PLAYER_HEIGHT 1.8f
 #define PLAYER_RADIUS 0.3f
@@ -52,4 +53,5 @@ player_t player_new(vec3 position, vec3 rotation, camera_t camera);
 
 void player_update(player_t* player);
 
-void player_set_uniforms(player_t* player, shader_t* shader);
+// Fill in the camera matrices and eye position of the frame uniforms
+void player_set_frame_uniforms(player_t* player, frame_uniforms_t* frame);
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "job.h"
+#include "thread.h"
+#include "types.h"
+
+// PROFILE_SCOPE("name") times the rest of the enclosing block. Scopes nest, every thread
+// records the ones it closes into its own ring, and profile_frame_end sums them into a
+// tree per frame: one for the main thread, one for all the job workers together.
+// While a trace is captured the same events, and PROFILE_COUNTER values, are also kept
+// and written as Chrome Trace Event JSON for Perfetto or chrome://tracing.
+
+#define PROFILE_MAX_THREADS (JOB_POOL_MAX_THREADS + 1) // by job_worker_index
+#define PROFILE_RING_SIZE 2048                         // events per thread
+#define PROFILE_MAX_DEPTH 16
+#define PROFILE_MAX_NODES 128 // per tree
+// Frames the averages are over
+#define PROFILE_HISTORY 120
+// Where profile_trace_stop writes, and the most events a trace keeps
+#define PROFILE_TRACE_PATH "trace.json"
+#define PROFILE_TRACE_MAX_EVENTS (1u << 20)
+
+#define PROFILE_NO_PARENT 0xFFFFFFFFu
+
+typedef enum profile_event_type {
+    PROFILE_EVENT_SCOPE,
+    PROFILE_EVENT_SCOPE_CHUNK, // a scope working on the chunk at position
+    PROFILE_EVENT_COUNTER,     // value at start_ms, only recorded while tracing
+} profile_event_type_t;
+
+typedef struct profile_event {
+    const char* name;
+    f64 start_ms;
+    f64 end_ms;
+    u32 depth; // scopes open around it on its thread
+    profile_event_type_t type;
+    union {
+        i32 position[3];
+        f64 value;
+    };
+} profile_event_t;
+
+// Written by its thread, read by profile_frame_end
+typedef struct profile_ring {
+    profile_event_t events[PROFILE_RING_SIZE];
+    u64 head;
+    u64 tail;
+    u64 dropped; // events that didn't fit
+    mutex_t mutex;
+} profile_ring_t;
+
+// Every call of one scope under the same parent, nodes are kept once seen
+typedef struct profile_node {
+    const char* name;
+    u32 parent; // PROFILE_NO_PARENT for the roots
+    u32 depth;
+
+    // filled while the frame is summed
+    f64 frame_ms;
+    u32 frame_calls;
+
+    // last frame and the averages over the last PROFILE_HISTORY ones
+    f64 last_ms;
+    u32 last_calls;
+    f64 average_ms;
+    f32 average_calls;
+    f32 history_ms[PROFILE_HISTORY];
+    u32 history_calls[PROFILE_HISTORY];
+    f64 history_sum_ms;
+    u64 history_sum_calls;
+} profile_node_t;
+
+// Nodes are in the order they were first seen, parents before their children
+typedef struct profile_tree {
+    profile_node_t nodes[PROFILE_MAX_NODES];
+    u32 node_count;
+} profile_tree_t;
+
+typedef enum profile_tree_id {
+    PROFILE_TREE_MAIN,
+    PROFILE_TREE_WORKERS,
+    PROFILE_TREE_COUNT,
+} profile_tree_id_t;
+
+typedef struct profile_trace_event {
+    profile_event_t event;
+    u32 thread; // job_worker_index
+} profile_trace_event_t;
+
+typedef struct profile_trace {
+    bool capturing;
+    f64 start_ms;
+    f64 stop_ms; // profile_frame_end stops the capture past this, 0 to keep going
+    // grows by doubling up to PROFILE_TRACE_MAX_EVENTS
+    profile_trace_event_t* events;
+    u32 event_count;
+    u32 event_capacity;
+    u64 dropped;
+} profile_trace_t;
+
+typedef struct profile {
+    // scopes record nothing until profile_init, or while this is off
+    bool enabled;
+    profile_ring_t rings[PROFILE_MAX_THREADS];
+    profile_tree_t trees[PROFILE_TREE_COUNT];
+
+    u32 history_index;
+    u32 history_count;
+    f64 frame_start_ms;
+    f32 history_frame_ms[PROFILE_HISTORY];
+    f64 history_sum_frame_ms;
+    f64 average_frame_ms;
+
+    // events lost to full rings or trees, since profile_init
+    u64 dropped;
+
+    profile_trace_t trace;
+} profile_t;
+
+extern profile_t g_profile;
+
+// A scope being timed, see PROFILE_SCOPE
+typedef struct profile_scope {
+    const char* name; // NULL when the profiler was off as it began
+    f64 start_ms;
+    bool has_position;
+    i32 position[3];
+} profile_scope_t;
+
+void profile_init(void);
+void profile_free(void);
+
+// Names must be string literals
+profile_scope_t profile_scope_begin(const char* name);
+// The chunk position shows in the trace, the tree sums every chunk together
+profile_scope_t profile_scope_begin_chunk(const char* name, const i32 position[3]);
+void profile_scope_end(profile_scope_t* scope);
+
+// Record a value, like a queue depth, while a trace is captured
+void profile_counter(const char* name, f64 value);
+
+// Sum the scopes every thread closed since the last call into the trees and roll the
+// averages, once per frame on the main thread. Worker scopes still open stay queued.
+void profile_frame_end(void);
+
+// Keep every event from now on, for seconds or until profile_trace_stop if 0
+// Turns recording on, needs profile_init
+void profile_trace_start(f64 seconds);
+// Write the capture to PROFILE_TRACE_PATH
+void profile_trace_stop(void);
+// Stop a running capture, or start one until stopped, for the F11 key and the debug window
+void profile_trace_toggle(void);
+
+// if shipping, strip all profiling, the scopes need a compiler that runs cleanups
+#if !defined(SHIPPING) && defined(__GNUC__)
+
+#define __PROFILE_CONCAT_INNER(a, b) a##b
+#define __PROFILE_CONCAT(a, b) __PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name)                                                                    \
+    profile_scope_t __PROFILE_CONCAT(__profile_scope_, __LINE__)                               \
+        __attribute__((cleanup(profile_scope_end))) = profile_scope_begin(name)
+#define PROFILE_SCOPE_CHUNK(name, position)                                                    \
+    profile_scope_t __PROFILE_CONCAT(__profile_scope_, __LINE__)                               \
+        __attribute__((cleanup(profile_scope_end))) =                                          \
+            profile_scope_begin_chunk(name, position)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_SCOPE_CHUNK(name, position)
+
+#endif
+
+#ifndef SHIPPING
+#define PROFILE_COUNTER(name, value) profile_counter(name, (f64)(value))
+#else
+#define PROFILE_COUNTER(name, value)
+#endif
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "types.h"
+#include "uniforms.h"
+
+#include <GL/glew.h>
+#include <cglm/types.h>
+#include <stdio.h>
+
+// mesh.h submits into the queue, so only the tag is used here
+struct mesh;
+
+// Render passes, executed in this order
+typedef enum render_pass_id {
+    // one per shadow cascade, keep in sync with SHADOW_CASCADE_MAX
+    RENDER_PASS_SHADOW_CASCADE_0,
+    RENDER_PASS_SHADOW_CASCADE_1,
+    RENDER_PASS_SHADOW_CASCADE_2,
+    RENDER_PASS_SHADOW_CASCADE_3,
+    RENDER_PASS_WORLD,
+    RENDER_PASS_SKY,
+    RENDER_PASS_GIZMO,
+    RENDER_PASS_UI,
+    RENDER_PASS_COUNT // Keep last, at most 16 passes fit in the sort key
+} render_pass_id_t;
+
+typedef enum render_sort_mode {
+    // Sort by program, then texture, then depth, front to back
+    RENDER_SORT_STATE,
+    // Keep submission order, for passes that rely on painter's order
+    RENDER_SORT_SUBMISSION,
+} render_sort_mode_t;
+
+// Textures bound for the whole pass, starting at unit 1
+// Unit 0 belongs to the per-packet texture
+#define RENDER_PASS_MAX_TEXTURES 2
+
+typedef struct render_pass_texture {
+    GLenum target;
+    GLuint id;
+} render_pass_texture_t;
+
+typedef struct render_pass {
+    bool active;
+    render_sort_mode_t sort_mode;
+
+    GLuint framebuffer;
+    GLint viewport[4];
+    GLbitfield clear;
+    vec4 clear_color;
+
+    bool depth_test;
+    bool cull_face;
+    bool blend;
+
+    render_pass_texture_t textures[RENDER_PASS_MAX_TEXTURES];
+
+    pass_uniforms_t uniforms;
+} render_pass_t;
+
+// A single draw, everything needed to issue it without looking back at the submitter
+typedef struct render_packet {
+    struct mesh* mesh;
+    GLuint program;
+    GLuint texture;
+    mat4 model;
+    vec4 color;
+} render_packet_t;
+
+// Bumped whenever a mesh or program is freed, a copy made before may point at it
+extern u64 g_render_resource_generation;
+
+// Farthest depth that still sorts distinctly, anything past it shares the last bucket
+#define RENDER_QUEUE_MAX_DEPTH 1024.0f
+
+typedef struct render_queue_stats {
+    u32 packets;
+    u32 passes;
+    u32 program_changes;
+    u32 texture_changes;
+    // CPU time spent issuing each pass, in milliseconds
+    f64 pass_ms[RENDER_PASS_COUNT];
+} render_queue_stats_t;
+
+// Draw packets are recorded with a sort key, radix sorted and then executed,
+// so building the frame's draw list never touches GL
+// A sorted queue can be copied and replayed later, see render_queue_copy
+typedef struct render_queue {
+    render_packet_t* packets;
+    u64* keys;
+    u32* order;
+    usize count;
+    usize capacity;
+    bool sorted;
+
+    // scratch space for the radix sort
+    u64* sort_keys;
+    u32* sort_order;
+
+    frame_uniforms_t frame;
+    render_pass_t passes[RENDER_PASS_COUNT];
+
+    render_queue_stats_t stats;
+
+    // g_render_resource_generation when render_queue_copy made this, see render_queue_stale
+    u64 generation;
+} render_queue_t;
+
+void render_queue_init(render_queue_t* queue);
+void render_queue_free(render_queue_t* queue);
+
+// Drop all packets and deactivate all passes, call at the start of the frame
+void render_queue_reset(render_queue_t* queue);
+
+// Activate a pass for this frame
+void render_queue_set_pass(
+    render_queue_t* queue,
+    render_pass_id_t id,
+    const render_pass_t* pass
+);
+
+// Record a draw
+// texture 0 leaves whatever is bound to unit 0, depth is the distance to the viewer
+void render_queue_submit(
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    struct mesh* mesh,
+    GLuint program,
+    GLuint texture,
+    mat4 model,
+    vec4 color,
+    f32 depth
+);
+
+void render_queue_sort(render_queue_t* queue);
+
+// Sort if needed and issue every packet, changing GL state only between packets that differ
+// Uploads the queue's frame uniforms and each pass's uniforms along the way
+void render_queue_execute(render_queue_t* queue, uniform_buffers_t* uniforms);
+
+// Deep copy of the recorded stream, dst must be initialized
+// Packets point at meshes, a copy can only be replayed while they are alive
+void render_queue_copy(render_queue_t* dst, const render_queue_t* src);
+// A mesh or program was freed since the copy was made, it must not be executed
+bool render_queue_stale(const render_queue_t* queue);
+
+// Print the sorted command stream, one line per packet
+void render_queue_dump(render_queue_t* queue, FILE* file);
@@ -3,26 +3,158 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "compress.h"
+#include "file_map.h"
+#include "job.h"
+#include "thread.h"
 #include "types.h"
 #include "world.h"
 
 #define SAVE_MAGIC_STR "CGSV"
 #define SAVE_MAGIC_LEN 4
 
+// Older single file formats, converted to regions when loaded
+// Version 1: chunk records with their coordinates, no index
+// Version 2: a sorted (x, y, z) index, then the block data of every chunk in index order
+#define SAVE_FORMAT_VERSION_V1 1
+#define SAVE_FORMAT_VERSION_V2 2
+// Version 3 regions only store raw chunks, version 4 ones no deltas, both tables read the
+// same as the current version's. Neither records a generator version.
+#define SAVE_FORMAT_VERSION_V3 3
+#define SAVE_FORMAT_VERSION_V4 4
+
+// Chunks live in region files of SAVE_REGION_SIZE^3 chunks, in a directory next to the
+// save file named <save path>SAVE_REGION_DIRECTORY_SUFFIX. The save file itself only
+// holds the seed, the generator version and the list of regions.
+#define SAVE_REGION_SIZE 16
+#define SAVE_REGION_CHUNKS (SAVE_REGION_SIZE * SAVE_REGION_SIZE * SAVE_REGION_SIZE)
+#define SAVE_REGION_MAGIC_STR "CGRG"
+#define SAVE_REGION_DIRECTORY_SUFFIX ".regions"
+
+// Chunks added since the last save_write are appended to <save path>SAVE_JOURNAL_SUFFIX,
+// so a crash only loses what wasn't flushed yet. Loading replays it, save_write empties it.
+#define SAVE_JOURNAL_SUFFIX ".journal"
+#define SAVE_JOURNAL_MAGIC_STR "CGJN"
+// Journal size past which a flush compacts it into the regions
+#define SAVE_JOURNAL_COMPACT_BYTES (16 * 1024 * 1024)
+// Seconds between flushes of the dirty chunks to the journal
+#define SAVE_JOURNAL_INTERVAL 10.0f
+
 typedef struct world_save_chunk {
     i32 x;
     i32 y;
     i32 z;
-    u32 _pad;
+    // added since the journal was last flushed
+    bool journal_pending;
 
     block_id_t block_data[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
 } world_save_chunk_t;
 
+// Version 2 index entry, and an entry of the region list in the save file
+typedef struct save_index_entry {
+    i32 x;
+    i32 y;
+    i32 z;
+    u32 _pad;
+} save_index_entry_t;
+
+// Where a chunk's blocks are in its region file, offset 0 if the region doesn't have it
+typedef struct save_region_entry {
+    u32 offset;
+    u16 size;    // encoded, CHUNK_BLOCK_COUNT when raw
+    u8 encoding; // compress_encoding_t or SAVE_CHUNK_DELTA
+    u8 _pad;
+} save_region_entry_t;
+
+// Region entry encoding of a chunk stored as its edits to chunk_generate_blocks' output:
+// a u16 edit count, then up to SAVE_DELTA_LIST_MAX (u16 index, u8 id) records, or past
+// that a bitmap of the edited blocks followed by their ids in block order
+#define SAVE_CHUNK_DELTA COMPRESS_ENCODING_COUNT
+#define SAVE_DELTA_LIST_MAX 256
+// Chunks with more edits than this are always stored whole, deltas are also only used
+// when they beat the chunk's full encoding
+#define SAVE_DELTA_MAX_EDITS (CHUNK_BLOCK_COUNT / 4)
+
+// How save_write encodes changed chunks, chunks that don't shrink are always stored raw
+typedef enum save_encoding {
+    SAVE_ENCODING_RAW = COMPRESS_RAW,
+    SAVE_ENCODING_RLE = COMPRESS_RLE,
+    SAVE_ENCODING_LZ = COMPRESS_LZ,
+    // every encoding, keeping the smallest
+    SAVE_ENCODING_BEST,
+    SAVE_ENCODING_COUNT,
+} save_encoding_t;
+
+// Names used on the command line
+extern const char* save_encoding_names[SAVE_ENCODING_COUNT];
+
+// Generated terrain is mostly vertical runs, RLE usually wins and LZ catches what it doesn't
+#define SAVE_ENCODING_DEFAULT SAVE_ENCODING_BEST
+
+// Follows the journal's save_header_t for every chunk, then size bytes of the chunk encoded
+// the same way as in a region. Records of torn writes fail the checksum and end the replay.
+typedef struct save_journal_record {
+    i32 x;
+    i32 y;
+    i32 z;
+    u16 size;
+    u8 encoding;
+    u8 _pad;
+    u64 checksum; // hash_fnv1a of the fields above and the data
+} save_journal_record_t;
+
+// Pending chunks a journal flush copied out of the save, appended to the journal on
+// g_job_pool while the save keeps changing
+typedef struct save_journal_batch {
+    world_save_chunk_t* chunks;
+    u32 chunk_count;
+    u32 chunk_capacity; // kept between flushes
+    bool written;
+    f64 write_ms;
+} save_journal_batch_t;
+
+// The last journal batch that finished writing
+typedef struct save_journal_stats {
+    u32 chunk_count;
+    f64 snapshot_ms; // copying the chunks, on the thread that flushed
+    f64 write_ms;    // encoding, appending and syncing them, on the pool
+} save_journal_stats_t;
+
+// Start of every region file, chunks are indexed x + y * size + z * size * size within
+// the region. The table is fixed size so it can be used straight from the mapping.
+typedef struct save_region_header {
+    u32 magic;
+    u32 format_version;
+    i32 x;
+    i32 y;
+    i32 z;
+    u32 chunk_count;
+    save_region_entry_t entries[SAVE_REGION_CHUNKS];
+} save_region_header_t;
+
+// A region listed in the save, mapped the first time one of its chunks is read
+typedef struct save_region {
+    i32 x;
+    i32 y;
+    i32 z;
+    bool opened;
+    file_map_t map; // unmapped if the file is missing or corrupt
+} save_region_t;
+
 typedef struct world_save {
     u64 seed;
-    u32 chunk_count;
+    // WORLD_GENERATOR_VERSION of the generator the save's deltas apply to
+    u32 generator_version;
 
+    // Chunks changed since the last save_write, newer than their regions
+    u32 chunk_count;
+    u32 chunk_capacity; // grows by doubling
     world_save_chunk_t* chunks;
+
+    // Open addressing from chunk coordinates to chunk index + 1, 0 is an empty slot
+    // Power of two capacity, kept at most half full
+    u32* index;
+    u32 index_capacity;
 } world_save_t;
 
 typedef struct save_header {
@@ -30,23 +162,124 @@ typedef struct save_header {
     u32 save_format_version;
 } save_header_t;
 
+// A region a compaction rewrites
+typedef struct save_region_job {
+    struct save* save;
+    u32 region; // index into the save's regions
+    bool ok;
+} save_region_job_t;
+
+// Changed chunks being written to the regions of path on g_job_pool. The new files replace
+// the old ones only once all of them are written, chunks keep loading from the old ones
+// until then.
+typedef struct save_compaction {
+    bool running;
+    char* path;
+    // the save's changed chunks when it started, the save collects new ones meanwhile
+    world_save_t world;
+    save_region_job_t* jobs;
+    u32 job_count;
+    job_group_t group;
+    f64 start_ms;
+} save_compaction_t;
+
 typedef struct save {
     save_header_t header;
     world_save_t world;
+    // format version of a save_load that save_convert still has to convert, 0 if current
+    u32 convert_version;
+
+    // where the regions are read from, NULL until the save is loaded or written
+    char* path;
+    save_region_t* regions;
+    u32 region_count;
+    u32 region_capacity;
+    // regions are opened from the threads loading chunks
+    mutex_t region_mutex;
+
+    save_encoding_t encoding;
+    // store edited chunks as their edits to the generator's output, see SAVE_CHUNK_DELTA
+    bool delta;
+
+    // NULL until save_journal_open
+    FILE* journal;
+    char* journal_save_path; // the save the journal compacts into
+    u64 journal_size; // only up to date while no batch is writing
+    // at most one batch writes at a time, the next flush waits for it
+    save_journal_batch_t journal_batch;
+    job_group_t journal_group;
+    save_journal_stats_t journal_stats;
+
+    save_compaction_t compaction;
 } save_t;
 
 extern save_t* g_save;
 
 save_t* save_new();
+// Only reads the region list, chunks are read from their region when first loaded
+// Older formats are read whole, save_convert then writes them as regions
 save_t* save_load(const char* path);
 void save_free(save_t* save);
 
-void save_write(const save_t* save, const char* path);
+// Write a save loaded from an older format at path as regions, keeping the original as
+// <path>.bak. Deltas are encoded against the world generator, so it has to be seeded with
+// the save first. False if the original couldn't be kept, nothing was written then.
+bool save_convert(save_t* save, const char* path);
 
-void save_write_world(const world_save_t* world, FILE* file);
-void save_write_chunk(const world_save_chunk_t* chunk, FILE* file);
+// Everything between loading the save and loading the world, in the order it has to
+// happen: seed the world generator with the save, convert it and recover its journal,
+// see save_journal_open. Both write regions on g_job_pool, start it first.
+bool save_start(save_t* save, const char* path, bool replay);
 
-bool save_read_world(FILE* file, world_save_t* world);
+// Delete a written save with its regions, returning how many bytes it took
+// The journal and a conversion's backup are left alone
+u64 save_remove(save_t* save, const char* path);
+
+// Rewrites every region with changed chunks, then the save file, each through a temporary
+// file and a rename. Writing to another path copies every region.
+// Regions are encoded and written on g_job_pool, a compaction still running is finished
+// first.
+void save_write(save_t* save, const char* path);
+
+bool save_read_world_v2(FILE* file, world_save_t* world);
+bool save_read_world_v1(FILE* file, world_save_t* world);
 bool save_read_chunk(FILE* file, world_save_chunk_t* chunk);
 
+// Changed chunk not yet written to a region, NULL if there is none
+// Pointers are invalidated by save_add_chunk
+world_save_chunk_t* save_find_chunk(const world_save_t* world, ivec3 position);
+
+// Block ids of a saved chunk, NULL if the save doesn't have it
+// Raw chunks point into their region mapping, compressed ones are decoded into scratch and
+// deltas are regenerated into it
+// Valid until the next save_add_chunk or save_write. Safe to call from several threads
+// while nothing modifies the save.
+const block_id_t* save_get_chunk_blocks(
+    save_t* save,
+    ivec3 position,
+    block_id_t scratch[CHUNK_BLOCK_COUNT]
+);
+
 void save_add_chunk(save_t* save, const chunk_t* chunk);
+
+// Start journaling the save, that will be written to path. With replay, the chunks of an
+// existing journal are recovered and compacted into the regions, otherwise it's discarded.
+void save_journal_open(save_t* save, const char* path, bool replay);
+// Copy the chunks added since the last flush, then append them to the journal and sync it
+// on g_job_pool, the save can be changed again as soon as this returns. Waits for the
+// previous flush's write first.
+// Also starts compacting the journal into the regions on g_job_pool once it's past
+// SAVE_JOURNAL_COMPACT_BYTES, or if the save file wasn't written yet. The journal keeps
+// every chunk until the regions are in place, which a later flush does once they're written.
+void save_journal_flush(save_t* save);
+// Block until the last flush is on disk
+void save_journal_wait(save_t* save);
+// Block until a compaction started by a flush is written, then put its regions in place
+// save_write, save_remove and save_free do this themselves
+void save_compact_wait(save_t* save);
+
+// Build a save of chunk_count chunks, write it to path, load it back and read every
+// chunk, logging the time each step took. Then time a journal flush of up to
+// SAVE_BENCH_AUTOSAVE_CHUNKS of them, on the calling thread and on the pool.
+#define SAVE_BENCH_AUTOSAVE_CHUNKS 1000
+void save_bench(u32 chunk_count, const char* path);
@@ -8,7 +8,47 @@ typedef struct shader {
 
 extern shader_t g_shader_current;
 
+// Source inserted after the #version line of every shader compiled from now on,
+// used for the shared uniform blocks
+void shader_set_preamble(const char* preamble);
+
 shader_t shader_new(const char* vertex_shader_source, const char* fragment_shader_source);
+// defines is GLSL source, usually #define lines, inserted before the preamble
+shader_t shader_new_with_defines(
+    const char* vertex_shader_source,
+    const char* fragment_shader_source,
+    const char* defines
+);
+// An in-flight compile and link, see shader_build_begin
+typedef struct shader_build {
+    u32 program;
+    u32 vertex_shader;
+    u32 fragment_shader;
+    u64 cache_key;
+    // loaded from the program cache, nothing to wait for
+    bool cached;
+    f64 start_ms;
+} shader_build_t;
+
+// Let the driver compile on its own threads when it supports
+// KHR/ARB_parallel_shader_compile, call once after GLEW is up
+void shader_enable_parallel_compile(void);
+
+// Issue the compile and link without checking either, so a driver compiling in parallel
+// can work on several programs while the caller does something else
+shader_build_t shader_build_begin(
+    const char* vertex_shader_source,
+    const char* fragment_shader_source,
+    const char* defines
+);
+
+// Whether shader_build_finish would return without blocking, always true without parallel
+// compile
+bool shader_build_ready(shader_build_t* build);
+
+// Check the results and hand out the program, program 0 if it failed to compile
+shader_t shader_build_finish(shader_build_t* build);
+
 shader_t shader_from_assets(const char* vertex_shader_path, const char* fragment_shader_path);
 void shader_free(shader_t* shader);
 
@@ -21,3 +61,69 @@ void shader_set_vec2(shader_t* shader, const char* name, vec2 value);
 void shader_set_vec3(shader_t* shader, const char* name, vec3 value);
 void shader_set_vec4(shader_t* shader, const char* name, vec4 value);
 void shader_set_mat4(shader_t* shader, const char* name, mat4 value);
+
+// Features a shader permutation is compiled with, each one becomes a #define
+// FEATURE_<NAME> in both stages, see shader_feature_names
+typedef enum shader_feature {
+    SHADER_FEATURE_TEXTURE = 1 << 0,
+    SHADER_FEATURE_LIGHTING = 1 << 1,
+    SHADER_FEATURE_FOG = 1 << 2,
+    // shadow filtering tiers, at most one is set and only with lighting
+    SHADER_FEATURE_SHADOW_HARD = 1 << 3,
+    SHADER_FEATURE_SHADOW_POISSON_4 = 1 << 4,
+    SHADER_FEATURE_SHADOW_POISSON_9 = 1 << 5,
+} shader_feature_t;
+
+#define SHADER_FEATURE_COUNT 6
+#define SHADER_PERMUTATION_COUNT (1u << SHADER_FEATURE_COUNT)
+
+extern const char* shader_feature_names[SHADER_FEATURE_COUNT];
+
+#define SHADER_BASE_MAX_SAMPLERS 4
+
+typedef struct shader_sampler {
+    const char* name;
+    i32 unit;
+} shader_sampler_t;
+
+// One vertex/fragment source pair compiled into a program per feature combination
+// Permutations are compiled the first time they're asked for and kept until
+// shader_base_free
+typedef struct shader_base {
+    const char* name;
+    const char* vertex_source;
+    const char* fragment_source;
+    // features the sources know about, the rest are masked off
+    u32 supported_features;
+
+    // sampler units, set on every permutation after it links
+    shader_sampler_t samplers[SHADER_BASE_MAX_SAMPLERS];
+    u32 sampler_count;
+
+    shader_t permutations[SHADER_PERMUTATION_COUNT];
+    // permutations started with shader_base_prepare and not yet picked up
+    shader_build_t builds[SHADER_PERMUTATION_COUNT];
+    // permutations that didn't compile, shader_base_get hands out the base one instead
+    bool failed[SHADER_PERMUTATION_COUNT];
+    u32 permutation_count;
+} shader_base_t;
+
+// The sources are not copied, they have to outlive the base
+void shader_base_init(
+    shader_base_t* base,
+    const char* name,
+    const char* vertex_source,
+    const char* fragment_source,
+    u32 supported_features
+);
+
+void shader_base_add_sampler(shader_base_t* base, const char* name, i32 unit);
+
+// Start compiling a permutation ahead of its first use
+void shader_base_prepare(shader_base_t* base, u32 features);
+
+// Program for a feature mask, compiled on first use
+// Falls back to the permutation without features if that mask failed to compile
+shader_t* shader_base_get(shader_base_t* base, u32 features);
+
+void shader_base_free(shader_base_t* base);
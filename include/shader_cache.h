@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.h"
+
+#include <GL/glew.h>
+
+// Linked programs are stored with glGetProgramBinary, one file per program
+#define SHADER_CACHE_DIRECTORY "shader_cache"
+
+#define SHADER_CACHE_MAGIC_STR "CGPB"
+#define SHADER_CACHE_FORMAT_VERSION 1
+
+typedef struct shader_cache_header {
+    u32 magic;
+    u32 format_version;
+    u64 key;
+    GLenum binary_format;
+    u32 binary_length;
+    u64 binary_hash;
+} shader_cache_header_t;
+
+typedef struct shader_cache_stats {
+    u32 hits;
+    u32 misses;
+    // entries that existed but were corrupt, from another driver or refused by it
+    u32 rejected;
+} shader_cache_stats_t;
+
+extern shader_cache_stats_t g_shader_cache_stats;
+
+// Needs a current GL context, the driver identity is part of every key
+// Stays disabled when the driver has no program binary formats or directory is NULL
+void shader_cache_init(const char* directory);
+
+bool shader_cache_enabled(void);
+
+// Key of a program built from these sources on this driver
+u64 shader_cache_key(
+    const char* vertex_source,
+    const char* fragment_source,
+    const char* defines,
+    const char* preamble
+);
+
+// Program linked from the cached binary, 0 on a miss
+// Entries that fail to load are deleted so the next store replaces them
+GLuint shader_cache_load(u64 key);
+
+// The program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+void shader_cache_store(u64 key, GLuint program);
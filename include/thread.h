@@ -0,0 +1,59 @@
+#pragma once
+
+#include "types.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Thin wrapper over pthreads and Win32 threads, just what the job pool needs
+
+typedef void (*thread_fn)(void* arg);
+
+typedef struct thread {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    thread_fn fn;
+    void* arg;
+} thread_t;
+
+typedef struct mutex {
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} mutex_t;
+
+typedef struct cond {
+#ifdef _WIN32
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+} cond_t;
+
+// The thread struct has to stay alive until thread_join
+bool thread_create(thread_t* thread, thread_fn fn, void* arg);
+void thread_join(thread_t* thread);
+
+// Logical processors available to the process, at least 1
+u32 thread_hardware_concurrency(void);
+
+void mutex_init(mutex_t* mutex);
+void mutex_free(mutex_t* mutex);
+void mutex_lock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+void cond_init(cond_t* cond);
+void cond_free(cond_t* cond);
+// mutex must be locked, it is again when this returns
+void cond_wait(cond_t* cond, mutex_t* mutex);
+void cond_signal(cond_t* cond);
+void cond_broadcast(cond_t* cond);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "thread.h"
+#include "types.h"
+
+#define TIMELINE_MAX_SPANS 64
+#define TIMELINE_THREAD_POOL 0xFFFFFFFFu
+
+// Wall clock span of one phase of work, on whichever thread ran it
+typedef struct timeline_span {
+    const char* name;
+    f64 start_ms;
+    f64 end_ms;
+    u32 thread; // job_worker_index of the thread that began it
+} timeline_span_t;
+
+// Records named spans from any thread and logs them relative to the first one
+typedef struct timeline {
+    timeline_span_t spans[TIMELINE_MAX_SPANS];
+    u32 span_count;
+    f64 origin_ms;
+    mutex_t mutex;
+} timeline_t;
+
+// Spans of everything from main() to the first frame
+extern timeline_t g_startup_timeline;
+
+void timeline_init(timeline_t* timeline);
+void timeline_free(timeline_t* timeline);
+
+// Returns the span to pass to timeline_end, names must be string literals
+u32 timeline_begin(timeline_t* timeline, const char* name);
+void timeline_end(timeline_t* timeline, u32 span);
+
+// Record a span measured elsewhere, thread is TIMELINE_THREAD_POOL for work spread over
+// the job pool
+void timeline_add(
+    timeline_t* timeline,
+    const char* name,
+    f64 start_ms,
+    f64 end_ms,
+    u32 thread
+);
+
+// One line per span: offset, duration, thread and a bar scaled to the whole timeline
+void timeline_log(timeline_t* timeline, const char* title);
@@ -2,6 +2,7 @@
 
 #include "assets.h"
 #include "mesh.h"
+#include "render_queue.h"
 #include <cglm/types.h>
 
 typedef enum ui_element_type {
@@ -68,7 +69,8 @@ void ui_init(ui_t* ui);
 
 void ui_update(ui_t* ui);
 
-void ui_draw(ui_t* ui);
+// Record the whole tree into the UI pass, parents before children
+void ui_submit(ui_t* ui, render_queue_t* queue, GLuint program);
 
 void ui_free(ui_t* ui);
 
@@ -89,7 +91,7 @@ ui_element_create_image(ui_element_position_t position_style, rect_t pos, textur
 
 void ui_element_update(ui_element_t* element);
 
-void ui_element_draw(ui_element_t* element);
+void ui_element_submit(ui_element_t* element, render_queue_t* queue, GLuint program);
 
 void ui_element_free(ui_element_t* element);
 
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.h"
+
+#include <GL/glew.h>
+#include <cglm/types.h>
+
+// Uniform buffer binding points, shared by every program
+#define UNIFORMS_FRAME_BINDING 0
+#define UNIFORMS_PASS_BINDING 1
+
+#define UNIFORMS_FRAME_BLOCK_NAME "FrameUniforms"
+#define UNIFORMS_PASS_BLOCK_NAME "PassUniforms"
+
+// Size of the cascade arrays in FrameUniforms
+#define UNIFORMS_SHADOW_CASCADES 4
+
+// Values that stay the same for every draw in a frame
+// Mirrors the std140 FrameUniforms block in assets/shaders/uniforms.glsl, keep them in sync
+typedef struct frame_uniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 light_view_projection[UNIFORMS_SHADOW_CASCADES];
+    vec3 world_eye;
+    f32 fog_start;
+    vec3 light_dir;
+    f32 light_intensity;
+    vec4 ambient_color;
+    vec4 fog_color;
+    // far view distance of each cascade
+    vec4 shadow_splits;
+    f32 fog_end;
+    f32 fog_density;
+    i32 shadow_cascade_count;
+    f32 shadow_texel_size;
+} frame_uniforms_t;
+
+// Values that change between render passes (shadow, world, ui)
+// Mirrors the std140 PassUniforms block in assets/shaders/uniforms.glsl
+typedef struct pass_uniforms {
+    mat4 view_projection;
+} pass_uniforms_t;
+
+typedef struct uniform_buffers {
+    GLuint frame_ubo;
+    GLuint pass_ubo;
+
+    frame_uniforms_t frame;
+    pass_uniforms_t pass;
+} uniform_buffers_t;
+
+void uniforms_init(uniform_buffers_t* uniforms);
+
+void uniforms_free(uniform_buffers_t* uniforms);
+
+// Point a linked program's uniform blocks at the shared binding points
+// Programs that don't use a block are left alone
+void uniforms_bind_program(u32 program);
+
+// Upload uniforms->frame, call once per frame before drawing
+void uniforms_upload_frame(uniform_buffers_t* uniforms);
+
+// Upload uniforms->pass, call at the start of every render pass
+void uniforms_upload_pass(uniform_buffers_t* uniforms);
@@ -1,8 +1,58 @@
+#pragma once
+
 #include "types.h"
 
-f32 perlin2d(f32 x, f32 y);
+// Wall clock in milliseconds, for measuring spans of work
+f64 time_now_ms(void);
+
+#define HASH_FNV1A_SEED 0xcbf29ce484222325ull
+
+// 64 bit FNV-1a, pass the previous result as hash to continue over more data
+u64 hash_fnv1a(const void* data, usize size, u64 hash);
+
+typedef enum noise_isa {
+    NOISE_ISA_SCALAR,
+    NOISE_ISA_SSE2, // 4 points at a time
+    NOISE_ISA_AVX2, // 8 points at a time, picked at runtime
+    NOISE_ISA_COUNT,
+} noise_isa_t;
+
+extern const char* noise_isa_names[NOISE_ISA_COUNT];
+
+// Perlin gradient noise over a permutation of 0..255 shuffled by a seed, stored twice so
+// corner lookups never wrap. Coordinates are mirrored around 0 and must stay below 2^31,
+// results are in 0..1.
+typedef struct noise {
+    i32 perm[512];
+    // what the batch functions run with, the best the CPU has after noise_init
+    noise_isa_t isa;
+} noise_t;
+
+void noise_init(noise_t* noise, u64 seed);
+
+f32 noise_perlin2d(const noise_t* noise, f32 x, f32 y);
+f32 noise_perlin3d(const noise_t* noise, f32 x, f32 y, f32 z);
+
+// count points at once, bit-identical to the single point functions whatever the isa
+void noise_perlin2d_batch(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    f32* out,
+    u32 count
+);
+void noise_perlin3d_batch(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    const f32* z,
+    f32* out,
+    u32 count
+);
 
-f32 perlin3d(f32 x, f32 y, f32 z);
+// Log samples per second of the single point and batch functions with every isa the CPU
+// has, after checking the batches match the single point results
+void noise_bench(u32 samples);
 
 inline static int posmod(int a, int b) {
     int r = a % b;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "job.h"
 #include "mesh.h"
+#include "render_queue.h"
 #include "types.h"
 
 #include <cglm/types.h>
@@ -79,6 +81,27 @@ typedef struct chunk {
 } chunk_t;
 
 #define MAX_LOADED_CHUNKS 1024
+#define WORLD_CHANGED_CHUNKS_MAX 64
+
+// Block columns of a chunk column, indexed x + z * CHUNK_SIZE
+#define WORLD_COLUMN_AREA (CHUNK_SIZE * CHUNK_SIZE)
+#define WORLD_COLUMN_NO_TOP INT32_MIN
+// Ends the list of chunk slots in a column
+#define WORLD_COLUMN_END UINT32_MAX
+
+// Heights of the chunks stacked at one chunk (x, z), shared by every loaded chunk there
+// Created when the first of them loads, dropped with the last one
+typedef struct world_column {
+    i32 x;
+    i32 z;
+    u32 chunk_count;
+    // slot of one of the loaded chunks, world->chunk_slot_column_next leads to the others
+    u32 first_slot;
+    // where the generator put the surface, before caves and edits
+    i32 terrain_height[WORLD_COLUMN_AREA];
+    // highest solid block of the loaded chunks, WORLD_COLUMN_NO_TOP if they have none
+    i32 top[WORLD_COLUMN_AREA];
+} world_column_t;
 
 typedef struct world {
     chunk_t* chunks;
@@ -87,17 +110,67 @@ typedef struct world {
     u8 chunk_slot_remeshed_bitmap[MAX_LOADED_CHUNKS / 8];
     u32 chunk_slot_remesh_queue[MAX_LOADED_CHUNKS];
     u32 chunk_slot_remesh_queue_count;
+    // next slot in the same column as each loaded chunk, WORLD_COLUMN_END after the last
+    u32 chunk_slot_column_next[MAX_LOADED_CHUNKS];
+
+    // Chunks whose mesh appeared, changed or went away since the last
+    // world_changed_chunks_clear, for caches of rendered geometry like shadow maps.
+    // On overflow the list is incomplete and every cache has to be dropped.
+    ivec3 changed_chunks[WORLD_CHANGED_CHUNKS_MAX];
+    u32 changed_chunk_count;
+    bool changed_chunks_overflow;
+
+    // One per chunk (x, z) with loaded chunks, packed at the front
+    world_column_t* columns;
+    u32 column_count;
+
+    // A full world unloads the chunk farthest from here to make room, kept at the player
+    vec3 focus;
 } world_t;
 
-// Initialize a chunk in place
+// Initialize a chunk in place, adding it to its column
 void chunk_init(chunk_t* chunk, world_t* world, ivec3 position);
+// Fill in the chunk's blocks from the save or the generator, without meshing it
+// terrain_height is its column's, NULL to generate it here
+// Touches neither GL nor the world, safe on any thread
+void chunk_load_blocks(chunk_t* chunk, ivec3 position, const i32* terrain_height);
 // Destroy a chunk in place, freeing all memory associated with it
 // Does not free the chunk itself
 void chunk_forget(chunk_t* chunk);
 
+// Bumped whenever chunk_generate's output changes, saves store chunks as edits to it
+#define WORLD_GENERATOR_VERSION 3
+
+// Cave density is sampled every WORLD_CAVE_LATTICE_SPACING blocks and trilinearly
+// interpolated in between, the lattice points on a chunk's faces are shared with its
+// neighbours
+#define WORLD_CAVE_LATTICE_SPACING 4
+#define WORLD_CAVE_LATTICE_POINTS (CHUNK_SIZE / WORLD_CAVE_LATTICE_SPACING + 1)
+#define WORLD_CAVE_LATTICE_COUNT                                                               \
+    (WORLD_CAVE_LATTICE_POINTS * WORLD_CAVE_LATTICE_POINTS * WORLD_CAVE_LATTICE_POINTS)
+
+// Seed the terrain noise, before any chunk is generated
+void world_generator_init(u64 seed);
+
+// Surface height the generator gives every block column of the chunk column at (x, z)
+void world_generate_terrain_height(i32 x, i32 z, i32 terrain_height[WORLD_COLUMN_AREA]);
+
 // Generate chunk blocks
 // Does not mesh the chunk
-void chunk_generate(chunk_t* chunk);
+void chunk_generate(chunk_t* chunk, const i32* terrain_height);
+// Block ids chunk_generate gives the chunk at position, safe on any thread
+// terrain_height is from world_generate_terrain_height, NULL to generate it here
+void chunk_generate_blocks(
+    ivec3 position,
+    const i32* terrain_height,
+    block_id_t blocks[CHUNK_BLOCK_COUNT]
+);
+
+// Time generating chunk_count chunks in columns WORLD_GENERATOR_BENCH_HEIGHT high with
+// cave noise sampled at every block and on the lattice, then log how much the two differ
+// and write top down maps of both cave layouts and their difference to a PNG at image_path
+#define WORLD_GENERATOR_BENCH_HEIGHT 4
+void world_generator_bench(u32 chunk_count, const char* image_path);
 
 // Can be used to remove a block from a chunk, ie. set it to air
 void chunk_set_block(chunk_t* chunk, world_t* world, ivec3 position, block_id_t id);
@@ -107,6 +180,11 @@ block_t* chunk_get_block(chunk_t* chunk, ivec3 position);
 // Takes into account the chunk's position in the world
 // Does not free the chunk's previous mesh
 void chunk_mesh(chunk_t* chunk, world_t* world);
+// The two halves of chunk_mesh
+// Building only reads the world, so chunks can build in parallel while nothing modifies it
+void chunk_build_mesh(chunk_t* chunk, world_t* world);
+// Uploading needs the GL context
+void chunk_upload_mesh(chunk_t* chunk, world_t* world);
 
 void chunk_remesh(chunk_t* chunk, world_t* world);
 void chunk_remesh_block(
@@ -120,7 +198,15 @@ void chunk_remesh_block(
 // Does not free the chunk itself or its blocks
 void chunk_forget_mesh(chunk_t* chunk);
 
-void chunk_draw(chunk_t* chunk);
+// Record the chunk's mesh into a render queue pass, sorted by its distance from eye
+void chunk_submit(
+    chunk_t* chunk,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye
+);
 
 // Create a new world
 // World must be freed with world_free
@@ -135,8 +221,10 @@ chunk_t* world_get_chunk(world_t* world, ivec3 position);
 chunk_t* world_get_or_load_chunk(world_t* world, ivec3 position);
 // Get a chunk slot from the world
 // If the chunks array can fit the chunk, loaded_chunk_count is incremented
-// If the chunks array cannot fit the chunk, the most-useless chunk is unloaded
+// If the chunks array cannot fit the chunk, the chunk farthest from focus is unloaded
 chunk_t* world_get_chunk_slot(world_t* world);
+// Whether slot index of the chunks array holds a loaded chunk
+bool world_chunk_slot_is_taken(world_t* world, u32 index);
 
 block_t* world_get_block_at(world_t* world, ivec3 position);
 void world_set_block_at(world_t* world, ivec3 position, block_id_t id);
@@ -147,8 +235,77 @@ void world_unload_chunk(world_t* world, ivec3 position);
 // Unload all chunks from the world
 // Does not free the world itself
 void world_unload_all_chunks(world_t* world);
+// Hand every loaded chunk with unsaved edits to g_save, for the next journal flush
+void world_save_dirty_chunks(world_t* world);
+
+// Column of the chunk column at (x, z), NULL if none of its chunks is loaded
+world_column_t* world_get_column(world_t* world, i32 x, i32 z);
+// Heights of the block column at world (x, z), false if no chunk of it is loaded
+// See world_column_t, top is WORLD_COLUMN_NO_TOP when the loaded chunks there are empty
+bool world_get_column_height(world_t* world, i32 x, i32 z, i32* terrain_height, i32* top);
+// Whether no solid block of the loaded chunks is above position
+bool world_is_sky_visible(world_t* world, ivec3 position);
+
+void world_submit(
+    world_t* world,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye
+);
+
+// Like world_submit, but only records chunks whose bounds intersect the clip volume of
+// an orthographic view_projection. Returns the number of chunks recorded.
+u32 world_submit_ortho_culled(
+    world_t* world,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye,
+    mat4 view_projection
+);
+
+// Whether a chunk's bounds intersect the clip volume of an orthographic view_projection
+bool world_chunk_intersects_ortho(ivec3 chunk_position, mat4 view_projection);
+
+void world_mark_chunk_changed(world_t* world, ivec3 chunk_position);
+
+typedef struct world_load_job {
+    world_t* world;
+    chunk_t* chunk;
+    const i32* terrain_height; // of the chunk's column
+} world_load_job_t;
+
+// A box of chunks generated and meshed on the job pool, see world_load_begin
+typedef struct world_load {
+    world_t* world;
+    world_load_job_t* jobs;
+    u32 chunk_count;
+    job_group_t group;
+
+    // time_now_ms at each step, for the startup timeline
+    f64 start_ms;
+    f64 generated_ms;
+    f64 meshed_ms;
+} world_load_t;
+
+// Claim slots for every chunk in [min, max) that is not loaded yet and start generating
+// their blocks on the pool. Stops early if the world runs out of free slots.
+// Nothing may touch the world until world_load_finish.
+void world_load_begin(
+    world_load_t* load,
+    world_t* world,
+    job_pool_t* pool,
+    ivec3 min,
+    ivec3 max
+);
 
-void world_draw(world_t* world);
+// Wait for generation, mesh every chunk on the pool, then upload the meshes
+// Needs the GL context
+void world_load_finish(world_load_t* load, job_pool_t* pool);
+void world_changed_chunks_clear(world_t* world);
 
 void world_get_chunk_position(ivec3 position, ivec3 chunk_position);
 void world_get_chunk_positionf(vec3 position, ivec3 chunk_position);
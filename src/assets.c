@@ -1,7 +1,10 @@
 #include "assets.h"
 
+#include "ctex.h"
 #include "types.h"
+#include "gl_state.h"
 #include "log.h"
+#include "pack.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,17 +13,86 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
+#ifndef ASSET_SOURCE_PACK
 #define ASSET_DATA_IMPLEMENTATION
 #include "asset_data.h"
+#endif
 
 texture_t g_magic_pixel;
 
+#ifdef ASSET_SOURCE_PACK
+static pack_t g_asset_pack;
+
+bool assets_open(const char* pack_path) {
+    return pack_open(&g_asset_pack, pack_path);
+}
+
+void assets_close(void) {
+    pack_close(&g_asset_pack);
+}
+
+const u8* asset_get(const char* name, usize* size) {
+    const u8* data = pack_find(&g_asset_pack, name, size);
+    if (!data) {
+        LOG_ERROR("No asset named %s in the pack\n", name);
+    }
+
+    return data;
+}
+#else
+typedef struct asset_embedded {
+    const char* name;
+    const u8* data;
+    usize size;
+} asset_embedded_t;
+
+#define ASSET_EMBEDDED(group, asset)                                                           \
+    { #group "/" #asset, (const u8*)a_asset_data.group.asset, a_asset_data.group.asset##_len }
+
+bool assets_open(const char* pack_path) {
+    (void)pack_path;
+    LOG_INFO("Using compiled in assets\n");
+    return true;
+}
+
+void assets_close(void) {}
+
+const u8* asset_get(const char* name, usize* size) {
+    const asset_embedded_t assets[] = {
+        ASSET_EMBEDDED(shaders, shadow_frag),
+        ASSET_EMBEDDED(shaders, shadow_vert),
+        ASSET_EMBEDDED(shaders, ui_frag),
+        ASSET_EMBEDDED(shaders, ui_vert),
+        ASSET_EMBEDDED(shaders, uniforms),
+        ASSET_EMBEDDED(shaders, world_frag),
+        ASSET_EMBEDDED(shaders, world_vert),
+        ASSET_EMBEDDED(textures, atlas),
+        ASSET_EMBEDDED(textures, cursor),
+        ASSET_EMBEDDED(textures, sun),
+        ASSET_EMBEDDED(textures, ui_atlas),
+    };
+
+    for (usize i = 0; i < sizeof(assets) / sizeof(assets[0]); i++) {
+        if (strcmp(assets[i].name, name) == 0) {
+            if (size) {
+                *size = assets[i].size;
+            }
+            return assets[i].data;
+        }
+    }
+
+    LOG_ERROR("No asset named %s compiled in\n", name);
+    return NULL;
+}
+#endif
+
+const char* asset_get_text(const char* name) {
+    const char* text = (const char*)asset_get(name, NULL);
+    return text ? text : "";
+}
+
 u8* read_file(const char* path, usize* size) {
     FILE* file = fopen(path, "rb");
     if (!file) {
@@ -83,7 +155,7 @@ texture_t texture_load(const char* path) {
     }
 
     glGenTextures(1, &texture.id);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, texture.id);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -136,76 +208,273 @@ texture_t texture_load(const char* path) {
     return texture;
 }
 
-texture_t texture_load_from_memory(const u8* data, usize size) {
-    texture_t texture = { 0 };
+static void texture_bc1_color(u16 color, u8* rgba) {
+    u32 r = (color >> 11) & 31u;
+    u32 g = (color >> 5) & 63u;
+    u32 b = color & 31u;
+
+    rgba[0] = (u8)((r << 3) | (r >> 2));
+    rgba[1] = (u8)((g << 2) | (g >> 4));
+    rgba[2] = (u8)((b << 3) | (b >> 2));
+    rgba[3] = 255;
+}
+
+// For drivers without S3TC, BC1 levels are expanded back to RGBA on upload
+static u8* texture_bc1_decode(const u8* blocks, u32 width, u32 height) {
+    u8* rgba = malloc((usize)width * height * 4);
+
+    for (u32 block_y = 0; block_y < height; block_y += 4) {
+        for (u32 block_x = 0; block_x < width; block_x += 4) {
+            u16 color0 = (u16)(blocks[0] | (blocks[1] << 8));
+            u16 color1 = (u16)(blocks[2] | (blocks[3] << 8));
+            u32 indices = (u32)blocks[4] | ((u32)blocks[5] << 8) | ((u32)blocks[6] << 16) |
+                          ((u32)blocks[7] << 24);
+            blocks += 8;
+
+            u8 palette[4][4];
+            texture_bc1_color(color0, palette[0]);
+            texture_bc1_color(color1, palette[1]);
+
+            for (u32 c = 0; c < 3; c++) {
+                if (color0 > color1) {
+                    palette[2][c] = (u8)((2 * palette[0][c] + palette[1][c]) / 3);
+                    palette[3][c] = (u8)((palette[0][c] + 2 * palette[1][c]) / 3);
+                } else {
+                    palette[2][c] = (u8)((palette[0][c] + palette[1][c]) / 2);
+                    palette[3][c] = 0;
+                }
+            }
+            palette[2][3] = 255;
+            palette[3][3] = color0 > color1 ? 255 : 0;
+
+            for (u32 y = 0; y < 4 && block_y + y < height; y++) {
+                for (u32 x = 0; x < 4 && block_x + x < width; x++) {
+                    u32 index = (indices >> ((y * 4 + x) * 2)) & 3u;
+                    memcpy(&rgba[((block_y + y) * width + block_x + x) * 4], palette[index], 4);
+                }
+            }
+        }
+    }
+
+    return rgba;
+}
+
+// Baked by tools/texbake.c, the levels point straight into data, nothing is decoded unless
+// BC1 has to be expanded
+static bool texture_decode_ctex(texture_image_t* image, const u8* data, usize size) {
+    ctex_header_t header;
+    memcpy(&header, data, sizeof(ctex_header_t));
+
+    usize levels_end = sizeof(ctex_header_t) + sizeof(ctex_level_t) * header.mip_count;
+    if (header.format_version != CTEX_FORMAT_VERSION || header.mip_count == 0 ||
+        header.mip_count > CTEX_MAX_LEVELS || levels_end > size ||
+        header.format > CTEX_FORMAT_BC1) {
+        LOG_ERROR("Unsupported texture container\n");
+        return false;
+    }
 
-    u8* image_data = stbi_load_from_memory(
+    ctex_level_t levels[CTEX_MAX_LEVELS];
+    memcpy(levels, data + sizeof(ctex_header_t), sizeof(ctex_level_t) * header.mip_count);
+
+    for (u32 i = 0; i < header.mip_count; i++) {
+        ctex_level_t* level = &levels[i];
+        u32 expected_size =
+            ctex_level_size((ctex_format_t)header.format, level->width, level->height);
+
+        if ((usize)level->offset + level->size > size || level->size < expected_size) {
+            LOG_ERROR("Truncated texture container\n");
+            return false;
+        }
+    }
+
+    bool bc1 = header.format == CTEX_FORMAT_BC1;
+    bool compressed = bc1 && GLEW_EXT_texture_compression_s3tc;
+
+    image->width = (i32)header.width;
+    image->height = (i32)header.height;
+    image->channels = (i32)header.channels;
+    image->format = compressed ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_RGBA;
+    image->level_count = header.mip_count;
+
+    for (u32 i = 0; i < header.mip_count; i++) {
+        texture_level_t* level = &image->levels[i];
+        level->data = data + levels[i].offset;
+        level->width = levels[i].width;
+        level->height = levels[i].height;
+        level->size = levels[i].size;
+
+        if (bc1 && !compressed) {
+            image->owned[i] = texture_bc1_decode(level->data, level->width, level->height);
+            level->data = image->owned[i];
+            level->size = level->width * level->height * 4;
+        }
+    }
+
+    LOG_DEBUG(
+        "Decoded baked texture (%dx%d:%d, %u levels%s)\n",
+        image->width,
+        image->height,
+        image->channels,
+        image->level_count,
+        bc1 ? (compressed ? ", BC1" : ", BC1 expanded") : ""
+    );
+
+    return true;
+}
+
+bool texture_decode(texture_image_t* image, const u8* data, usize size) {
+    memset(image, 0, sizeof(texture_image_t));
+
+    if (size >= sizeof(ctex_header_t) && memcmp(data, CTEX_MAGIC_STR, 4) == 0) {
+        return texture_decode_ctex(image, data, size);
+    }
+
+    // anything that isn't a baked container goes through stb_image, PNG mostly
+    u8* pixels = stbi_load_from_memory(
         data,
         (int)size,
-        &texture.width,
-        &texture.height,
-        &texture.channels,
+        &image->width,
+        &image->height,
+        &image->channels,
         0
     );
 
-    if (!image_data) {
+    if (!pixels) {
         LOG_ERROR("Failed to load texture from memory\n");
+        return false;
+    }
+
+    if (image->channels != 3 && image->channels != 4) {
+        LOG_ERROR("Unsupported texture format\n");
+        stbi_image_free(pixels);
+        return false;
+    }
+
+    image->format = image->channels == 3 ? GL_RGB : GL_RGBA;
+    image->generate_mipmaps = true;
+    image->level_count = 1;
+    image->owned[0] = pixels;
+    image->levels[0] = (texture_level_t){
+        .data = pixels,
+        .width = (u32)image->width,
+        .height = (u32)image->height,
+        .size = (u32)(image->width * image->height * image->channels),
+    };
+
+    LOG_DEBUG(
+        "Decoded texture from memory (%dx%d:%d)\n",
+        image->width,
+        image->height,
+        image->channels
+    );
+
+    return true;
+}
+
+texture_t texture_upload(texture_image_t* image) {
+    texture_t texture = {
+        .width = image->width,
+        .height = image->height,
+        .channels = image->channels,
+    };
+
+    if (image->level_count == 0) {
         return texture;
     }
 
     glGenTextures(1, &texture.id);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, texture.id);
 
+    // texels stay sharp up close, far away the levels are blended instead of aliasing
+    bool mipmapped = image->generate_mipmaps || image->level_count > 1;
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(
+        GL_TEXTURE_2D,
+        GL_TEXTURE_MIN_FILTER,
+        mipmapped ? GL_NEAREST_MIPMAP_LINEAR : GL_NEAREST
+    );
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    LOG_DEBUG(
-        "Loaded texture from memory (%dx%d:%d)\n",
-        texture.width,
-        texture.height,
-        texture.channels
-    );
+    // GL's default of 1000 levels is fine for generated mipmaps
+    u32 max_level = image->generate_mipmaps ? 1000 : image->level_count - 1;
+    if (image->max_level && image->max_level < max_level) {
+        max_level = image->max_level;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)max_level);
+
+    // RGB rows aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (u32 i = 0; i < image->level_count; i++) {
+        texture_level_t* level = &image->levels[i];
+
+        if (image->format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) {
+            glCompressedTexImage2D(
+                GL_TEXTURE_2D,
+                (GLint)i,
+                image->format,
+                (GLsizei)level->width,
+                (GLsizei)level->height,
+                0,
+                (GLsizei)level->size,
+                level->data
+            );
+        } else {
+            glTexImage2D(
+                GL_TEXTURE_2D,
+                (GLint)i,
+                (GLint)image->format,
+                (GLsizei)level->width,
+                (GLsizei)level->height,
+                0,
+                image->format,
+                GL_UNSIGNED_BYTE,
+                level->data
+            );
+        }
+    }
 
-    if (texture.channels == 3) {
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RGB,
-            texture.width,
-            texture.height,
-            0,
-            GL_RGB,
-            GL_UNSIGNED_BYTE,
-            image_data
-        );
-    } else if (texture.channels == 4) {
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RGBA,
-            texture.width,
-            texture.height,
-            0,
-            GL_RGBA,
-            GL_UNSIGNED_BYTE,
-            image_data
-        );
-    } else {
-        LOG_ERROR("Unsupported texture format\n");
-        stbi_image_free(image_data);
-        texture.id = 0;
-        return texture;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (image->generate_mipmaps) {
+        glGenerateMipmap(GL_TEXTURE_2D);
     }
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+    return texture;
+}
 
-    stbi_image_free(image_data);
+void texture_image_free(texture_image_t* image) {
+    for (u32 i = 0; i < TEXTURE_MAX_LEVELS; i++) {
+        // stb_image allocates with malloc unless told otherwise
+        free(image->owned[i]);
+    }
+
+    memset(image, 0, sizeof(texture_image_t));
+}
+
+texture_t texture_load_from_memory(const u8* data, usize size) {
+    texture_image_t image;
+    if (!texture_decode(&image, data, size)) {
+        return (texture_t){ 0 };
+    }
+
+    texture_t texture = texture_upload(&image);
+    texture_image_free(&image);
 
     return texture;
 }
 
+texture_t texture_load_asset(const char* name) {
+    usize size = 0;
+    const u8* data = asset_get(name, &size);
+    if (!data) {
+        return (texture_t){ 0 };
+    }
+
+    return texture_load_from_memory(data, size);
+}
+
 texture_t texture_load_from_memory_raw(u8* data, i32 width, i32 height, i32 channels) {
     texture_t texture = { 0 };
 
@@ -214,7 +483,7 @@ texture_t texture_load_from_memory_raw(u8* data, i32 width, i32 height, i32 chan
     texture.channels = channels;
 
     glGenTextures(1, &texture.id);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, texture.id);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -257,10 +526,10 @@ texture_t texture_load_from_memory_raw(u8* data, i32 width, i32 height, i32 chan
 }
 
 void texture_free(texture_t* texture) {
+    gl_state_forget_texture(texture->id);
     glDeleteTextures(1, &texture->id);
 }
 
 void texture_bind(texture_t* texture, u32 slot) {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, texture->id);
+    gl_state_bind_texture(slot, GL_TEXTURE_2D, texture->id);
 }
@@ -118,6 +118,15 @@ void camera_screen_to_world(
     glm_quat_rotatev(camera->rotation, VEC3_FORWARD, *world_direction);
 }
 
+void ray_from_camera(ray_t* ray, camera_t* camera) {
+    camera_screen_to_world(
+        camera,
+        (vec2){ (float)g_window_size[0] / 2, (float)g_window_size[1] / 2 },
+        &ray->origin,
+        &ray->direction
+    );
+}
+
 bool camera_pointed_block(
     camera_t* camera,
     world_t* world,
@@ -0,0 +1,299 @@
+#include "compress.h"
+
+#include "types.h"
+
+#include <string.h>
+
+#define COMPRESS_LZ_MIN_MATCH 4
+#define COMPRESS_LZ_MAX_OFFSET 65535
+#define COMPRESS_LZ_HASH_BITS 12
+// the format wants the last 5 bytes as literals and no match starting in the last 12
+#define COMPRESS_LZ_LAST_LITERALS 5
+#define COMPRESS_LZ_MATCH_LIMIT 12
+
+const char* compress_encoding_names[COMPRESS_ENCODING_COUNT] = {
+    "raw",
+    "rle",
+    "lz",
+};
+
+static usize compress_rle_encode(const u8* src, usize size, u8* dst, usize capacity) {
+    usize out = 0;
+
+    for (usize i = 0; i < size;) {
+        u8 value = src[i];
+        usize run = 1;
+        while (run < 256 && i + run < size && src[i + run] == value) {
+            run++;
+        }
+
+        if (out + 2 > capacity) {
+            return 0;
+        }
+        dst[out++] = (u8)(run - 1);
+        dst[out++] = value;
+        i += run;
+    }
+
+    return out;
+}
+
+static bool compress_rle_decode(const u8* src, usize size, u8* dst, usize dst_size) {
+    if (size % 2 != 0) {
+        return false;
+    }
+
+    usize out = 0;
+    for (usize i = 0; i < size; i += 2) {
+        usize run = (usize)src[i] + 1;
+        if (out + run > dst_size) {
+            return false;
+        }
+        memset(dst + out, src[i + 1], run);
+        out += run;
+    }
+
+    return out == dst_size;
+}
+
+static u32 compress_read32(const u8* p) {
+    u32 value;
+    memcpy(&value, p, sizeof(u32));
+    return value;
+}
+
+static u32 compress_lz_hash(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - COMPRESS_LZ_HASH_BITS);
+}
+
+// Length above the 4 bits in the token, as a run of 255s and a remainder
+static bool compress_lz_write_length(usize length, u8* dst, usize* out, usize capacity) {
+    for (; length >= 255; length -= 255) {
+        if (*out >= capacity) {
+            return false;
+        }
+        dst[(*out)++] = 255;
+    }
+
+    if (*out >= capacity) {
+        return false;
+    }
+    dst[(*out)++] = (u8)length;
+
+    return true;
+}
+
+static bool compress_lz_write_sequence(
+    const u8* literals,
+    usize literal_count,
+    usize offset,
+    usize match_length,
+    u8* dst,
+    usize* out,
+    usize capacity
+) {
+    if (*out >= capacity) {
+        return false;
+    }
+
+    usize match_code = match_length ? match_length - COMPRESS_LZ_MIN_MATCH : 0;
+    u8* token = &dst[(*out)++];
+    *token = (u8)(((literal_count < 15 ? literal_count : 15) << 4) |
+                  (match_code < 15 ? match_code : 15));
+
+    if (literal_count >= 15 &&
+        !compress_lz_write_length(literal_count - 15, dst, out, capacity)) {
+        return false;
+    }
+
+    if (*out + literal_count > capacity) {
+        return false;
+    }
+    memcpy(dst + *out, literals, literal_count);
+    *out += literal_count;
+
+    // the last sequence is literals only
+    if (!match_length) {
+        return true;
+    }
+
+    if (*out + 2 > capacity) {
+        return false;
+    }
+    dst[(*out)++] = (u8)(offset & 0xFF);
+    dst[(*out)++] = (u8)(offset >> 8);
+
+    if (match_code >= 15 && !compress_lz_write_length(match_code - 15, dst, out, capacity)) {
+        return false;
+    }
+
+    return true;
+}
+
+// Greedy single probe matcher, fast rather than tight
+static usize compress_lz_encode(const u8* src, usize size, u8* dst, usize capacity) {
+    u32 table[1 << COMPRESS_LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    usize out = 0;
+    usize anchor = 0;
+
+    if (size > COMPRESS_LZ_MATCH_LIMIT) {
+        usize match_limit = size - COMPRESS_LZ_MATCH_LIMIT;
+        usize extend_limit = size - COMPRESS_LZ_LAST_LITERALS;
+
+        for (usize i = 0; i < match_limit;) {
+            u32 sequence = compress_read32(src + i);
+            u32 hash = compress_lz_hash(sequence);
+            u32 candidate = table[hash];
+            table[hash] = (u32)i;
+
+            if (candidate == 0xFFFFFFFFu || i - candidate > COMPRESS_LZ_MAX_OFFSET ||
+                compress_read32(src + candidate) != sequence) {
+                i++;
+                continue;
+            }
+
+            usize length = COMPRESS_LZ_MIN_MATCH;
+            while (i + length < extend_limit && src[candidate + length] == src[i + length]) {
+                length++;
+            }
+
+            if (!compress_lz_write_sequence(
+                    src + anchor,
+                    i - anchor,
+                    i - candidate,
+                    length,
+                    dst,
+                    &out,
+                    capacity
+                )) {
+                return 0;
+            }
+
+            i += length;
+            anchor = i;
+        }
+    }
+
+    if (!compress_lz_write_sequence(src + anchor, size - anchor, 0, 0, dst, &out, capacity)) {
+        return 0;
+    }
+
+    return out;
+}
+
+static bool compress_lz_read_length(const u8* src, usize size, usize* in, usize* length) {
+    u8 byte;
+    do {
+        if (*in >= size) {
+            return false;
+        }
+        byte = src[(*in)++];
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+static bool compress_lz_decode(const u8* src, usize size, u8* dst, usize dst_size) {
+    usize in = 0;
+    usize out = 0;
+
+    while (in < size) {
+        u8 token = src[in++];
+
+        usize literal_count = token >> 4;
+        if (literal_count == 15 && !compress_lz_read_length(src, size, &in, &literal_count)) {
+            return false;
+        }
+
+        if (literal_count > size - in || literal_count > dst_size - out) {
+            return false;
+        }
+        memcpy(dst + out, src + in, literal_count);
+        in += literal_count;
+        out += literal_count;
+
+        if (in == size) {
+            break;
+        }
+
+        if (size - in < 2) {
+            return false;
+        }
+        usize offset = (usize)src[in] | ((usize)src[in + 1] << 8);
+        in += 2;
+
+        usize length = token & 0x0F;
+        if (length == 15 && !compress_lz_read_length(src, size, &in, &length)) {
+            return false;
+        }
+        length += COMPRESS_LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > out || length > dst_size - out) {
+            return false;
+        }
+
+        const u8* match = dst + out - offset;
+        if (offset >= length) {
+            memcpy(dst + out, match, length);
+        } else if (offset == 1) {
+            memset(dst + out, *match, length);
+        } else {
+            // overlapping, repeats the last offset bytes
+            for (usize i = 0; i < length; i++) {
+                dst[out + i] = match[i];
+            }
+        }
+        out += length;
+    }
+
+    return out == dst_size;
+}
+
+usize compress_encode(
+    compress_encoding_t encoding,
+    const u8* src,
+    usize size,
+    u8* dst,
+    usize capacity
+) {
+    switch (encoding) {
+        case COMPRESS_RAW:
+            if (size > capacity) {
+                return 0;
+            }
+            memcpy(dst, src, size);
+            return size;
+        case COMPRESS_RLE:
+            return compress_rle_encode(src, size, dst, capacity);
+        case COMPRESS_LZ:
+            return compress_lz_encode(src, size, dst, capacity);
+        default:
+            return 0;
+    }
+}
+
+bool compress_decode(
+    compress_encoding_t encoding,
+    const u8* src,
+    usize size,
+    u8* dst,
+    usize dst_size
+) {
+    switch (encoding) {
+        case COMPRESS_RAW:
+            if (size != dst_size) {
+                return false;
+            }
+            memcpy(dst, src, size);
+            return true;
+        case COMPRESS_RLE:
+            return compress_rle_decode(src, size, dst, dst_size);
+        case COMPRESS_LZ:
+            return compress_lz_decode(src, size, dst, dst_size);
+        default:
+            return false;
+    }
+}
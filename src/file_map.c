@@ -0,0 +1,96 @@
+#include "file_map.h"
+
+#include "types.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool file_map_open(file_map_t* map, const char* path) {
+    memset(map, 0, sizeof(file_map_t));
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    const u8* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    map->data = data;
+    map->size = (usize)file_size.QuadPart;
+    map->file_handle = file;
+    map->mapping_handle = mapping;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void* data = mmap(NULL, (usize)file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping keeps the file alive on its own
+    close(file);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    map->data = data;
+    map->size = (usize)file_stat.st_size;
+#endif
+
+    return true;
+}
+
+void file_map_close(file_map_t* map) {
+    if (map->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(map->data);
+        CloseHandle(map->mapping_handle);
+        CloseHandle(map->file_handle);
+#else
+        munmap((void*)map->data, map->size);
+#endif
+    }
+
+    memset(map, 0, sizeof(file_map_t));
+}
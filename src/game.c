@@ -1,16 +1,23 @@
 #include "game.h"
 #include "assets.h"
-#include "asset_data.h"
 #include "camera.h"
 #include "glm_extra.h"
 #include "globals.h"
+#include "job.h"
 #include "lighting.h"
 #include "log.h"
 #include "mesh.h"
 #include "physics.h"
 #include "player.h"
+#include "profile.h"
+#include "render_queue.h"
+#include "saves.h"
 #include "shader.h"
+#include "shader_cache.h"
+#include "timeline.h"
 #include "ui.h"
+#include "uniforms.h"
+#include "utils.h"
 #include "world.h"
 
 #include <cglm/affine-pre.h>
@@ -20,7 +27,12 @@
 #include <cglm/util.h>
 #include <cglm/vec3.h>
 #include <cglm/mat4.h>
+#include <math.h>
 #include <stb_image_write.h>
+#include <stdio.h>
+
+// F9 writes the captured command stream here
+#define RENDER_QUEUE_CAPTURE_PATH "render_queue.txt"
 
 // Disable clang-format for this block
 // clang-format off
@@ -118,7 +130,31 @@ const u32 magic_plane_indices[] = {
 
 // clang-format on
 
+typedef struct texture_decode_job {
+    const char* name;
+    texture_t* texture;
+    texture_image_t image;
+    u32 max_level; // see texture_image_t
+    bool decoded;
+} texture_decode_job_t;
+
+static void texture_decode_job(void* arg) {
+    texture_decode_job_t* job = arg;
+    u32 span = timeline_begin(&g_startup_timeline, job->name);
+
+    usize size = 0;
+    const u8* data = asset_get(job->name, &size);
+    job->decoded = data && texture_decode(&job->image, data, size);
+
+    timeline_end(&g_startup_timeline, span);
+}
+
+// Startup runs as a small task graph: textures decode and the starting chunks generate on
+// the job pool while the main thread issues every shader compile, then textures upload in
+// one batch, shaders are picked up and game_init meshes the world
 int game_load_content(void) {
+    u32 span = timeline_begin(&g_startup_timeline, "Meshes");
+
     g_game.content.plain_axes = (mesh_t){
         .draw_mode = GL_LINES,
         .vertex_count = 6,
@@ -149,83 +185,159 @@ int game_load_content(void) {
 
     mesh_init(&g_game.content.quad);
 
+    timeline_end(&g_startup_timeline, span);
+
     LOG_INFO("Meshes initialized\n");
 
-    texture_t atlas =
-        texture_load_from_memory(a_asset_data.textures.atlas, a_asset_data.textures.atlas_len);
+    f64 texture_start = time_now_ms();
+
+    texture_decode_job_t texture_jobs[] = {
+        {
+            .name = "textures/atlas",
+            .texture = &g_game.content.atlas,
+            .max_level = ATLAS_TEXTURE_MAX_LEVEL,
+        },
+        { .name = "textures/ui_atlas", .texture = &g_game.content.ui_atlas },
+        { .name = "textures/sun", .texture = &g_game.content.sun },
+        { .name = "textures/cursor", .texture = &g_game.content.cursor },
+    };
+    u32 texture_job_count = sizeof(texture_jobs) / sizeof(texture_jobs[0]);
 
-    if (!atlas.id) {
-        LOG_ERROR("Failed to load texture\n");
-        return -1;
+    job_group_t texture_group = { 0 };
+    for (u32 i = 0; i < texture_job_count; i++) {
+        job_submit(&g_job_pool, &texture_group, texture_decode_job, &texture_jobs[i]);
     }
 
-    g_game.content.atlas = atlas;
+    // meshed in game_init, once the GL side of startup is out of the way
+    g_game.world = world_new();
+    world_load_begin(
+        &g_game.world_load,
+        g_game.world,
+        &g_job_pool,
+        (ivec3){ 0, 0, 0 },
+        (ivec3){ 8, 2, 8 }
+    );
+
+    uniforms_init(&g_game.uniforms);
+    render_queue_init(&g_game.render_queue);
+    render_queue_init(&g_game.render_capture);
+
+    f64 shader_start = time_now_ms();
+    span = timeline_begin(&g_startup_timeline, "Shader compile issue");
+
+    shader_set_preamble(asset_get_text("shaders/uniforms"));
 
-    texture_t ui_atlas = texture_load_from_memory(
-        a_asset_data.textures.ui_atlas,
-        a_asset_data.textures.ui_atlas_len
+    shader_build_t ui_build = shader_build_begin(
+        asset_get_text("shaders/ui_vert"),
+        asset_get_text("shaders/ui_frag"),
+        NULL
+    );
+    shader_build_t shadow_build = shader_build_begin(
+        asset_get_text("shaders/shadow_vert"),
+        asset_get_text("shaders/shadow_frag"),
+        NULL
     );
 
-    if (!ui_atlas.id) {
-        LOG_ERROR("Failed to load ui texture\n");
-        return -1;
-    }
+    shader_base_t* world_shader = &g_game.content.world_shader;
+    shader_base_init(
+        world_shader,
+        "world",
+        asset_get_text("shaders/world_vert"),
+        asset_get_text("shaders/world_frag"),
+        SHADER_FEATURE_TEXTURE | SHADER_FEATURE_LIGHTING | SHADER_FEATURE_FOG |
+            SHADER_FEATURE_SHADOW_HARD | SHADER_FEATURE_SHADOW_POISSON_4 |
+            SHADER_FEATURE_SHADOW_POISSON_9
+    );
+    shader_base_add_sampler(world_shader, "u_texture", 0);
+    shader_base_add_sampler(world_shader, "u_shadow_map", 1);
+    shader_base_add_sampler(world_shader, "u_shadow_noise", 2);
 
-    g_game.content.ui_atlas = ui_atlas;
+    // compile the permutations the game starts with now, the others on first use
+    u32 start_features = SHADER_FEATURE_TEXTURE | SHADER_FEATURE_LIGHTING |
+                         SHADER_FEATURE_FOG |
+                         shadow_quality_features(SHADOW_SETTINGS_DEFAULT.quality);
+    shader_base_prepare(world_shader, start_features);
+    shader_base_prepare(world_shader, SHADER_FEATURE_TEXTURE);
+    shader_base_prepare(world_shader, 0);
 
-    texture_t sun =
-        texture_load_from_memory(a_asset_data.textures.sun, a_asset_data.textures.sun_len);
+    timeline_end(&g_startup_timeline, span);
 
-    if (!ui_atlas.id) {
-        LOG_ERROR("Failed to load ui texture\n");
-        return -1;
-    }
+    // the driver keeps compiling while the main thread uploads
+    job_group_wait(&g_job_pool, &texture_group);
+
+    span = timeline_begin(&g_startup_timeline, "Texture upload");
+
+    bool textures_ok = true;
+    for (u32 i = 0; i < texture_job_count; i++) {
+        texture_decode_job_t* job = &texture_jobs[i];
+
+        if (job->decoded) {
+            job->image.max_level = job->max_level;
+            *job->texture = texture_upload(&job->image);
+        }
+        texture_image_free(&job->image);
 
-    g_game.content.sun = sun;
+        if (!job->texture->id) {
+            LOG_ERROR("Failed to load texture %s\n", job->name);
+            textures_ok = false;
+        }
+    }
 
     u8 magic_pixel_data[4] = { 255, 255, 255, 255 };
     g_magic_pixel = texture_load_from_memory_raw(magic_pixel_data, 1, 1, 4);
     if (!g_magic_pixel.id) {
         LOG_ERROR("Failed to create magic pixel\n");
-        return -1;
+        textures_ok = false;
     }
 
-    texture_t cursor = texture_load_from_memory(
-        a_asset_data.textures.cursor,
-        a_asset_data.textures.cursor_len
-    );
+    timeline_end(&g_startup_timeline, span);
 
-    if (!cursor.id) {
-        LOG_ERROR("Failed to load cursor texture\n");
+    if (!textures_ok) {
         return -1;
     }
 
-    g_game.content.cursor = cursor;
+    LOG_INFO("Textures loaded in %.1f ms\n", time_now_ms() - texture_start);
 
-    LOG_INFO("Textures loaded\n");
+    span = timeline_begin(&g_startup_timeline, "Shader link");
 
-    shader_t shader = shader_new(a_asset_data.shaders.ui_vert, a_asset_data.shaders.ui_frag);
+    shader_t shader = shader_build_finish(&ui_build);
 
     g_game.content.ui_shader = shader;
     g_game.content.sprite_shader = shader;
 
-    g_game.content.unlit_shader =
-        shader_new(a_asset_data.shaders.world_vert, a_asset_data.shaders.unlit_frag);
-
-    g_game.content.world_shader =
-        shader_new(a_asset_data.shaders.world_vert, a_asset_data.shaders.world_frag);
+    g_game.content.shadow_shader = shader_build_finish(&shadow_build);
 
-    g_game.content.gizmo_shader =
-        shader_new(a_asset_data.shaders.world_vert, a_asset_data.shaders.gizmo_frag);
+    shader_base_get(world_shader, start_features);
+    shader_base_get(world_shader, SHADER_FEATURE_TEXTURE);
+    shader_base_get(world_shader, 0);
 
-    g_game.content.shadow_shader =
-        shader_new(a_asset_data.shaders.shadow_vert, a_asset_data.shaders.shadow_frag);
+    timeline_end(&g_startup_timeline, span);
 
-    LOG_INFO("Shader initialized\n");
+    LOG_INFO(
+        "Shaders ready in %.1f ms, %u from the cache, %u compiled\n",
+        time_now_ms() - shader_start,
+        g_shader_cache_stats.hits,
+        g_shader_cache_stats.misses
+    );
 
     return 0;
 }
 
+u32 game_world_features(void) {
+    u32 features = SHADER_FEATURE_FOG;
+
+    if (!g_debug_tools.no_textures) {
+        features |= SHADER_FEATURE_TEXTURE;
+    }
+
+    if (!g_debug_tools.no_lighting) {
+        features |= SHADER_FEATURE_LIGHTING;
+        features |= shadow_quality_features(g_game.instances.sun.shadow_map.settings.quality);
+    }
+
+    return features;
+}
+
 int game_init(void) {
     g_game.instances.plain_axes_instance = mesh_instance_new(&g_game.content.plain_axes);
 
@@ -288,16 +400,39 @@ int game_init(void) {
 
     LOG_INFO("Player initialized\n");
 
-    g_game.world = world_new();
-    for (i32 x = 0; x < 8; x++) {
-        for (i32 y = 0; y < 2; y++) {
-            for (i32 z = 0; z < 8; z++) {
-                world_get_or_load_chunk(g_game.world, (ivec3){ x, y, z });
-            }
-        }
-    }
+    world_load_t* load = &g_game.world_load;
+    world_load_finish(load, &g_job_pool);
 
-    LOG_INFO("World initialized\n");
+    timeline_add(
+        &g_startup_timeline,
+        "World generate",
+        load->start_ms,
+        load->generated_ms,
+        TIMELINE_THREAD_POOL
+    );
+    timeline_add(
+        &g_startup_timeline,
+        "World mesh",
+        load->generated_ms,
+        load->meshed_ms,
+        TIMELINE_THREAD_POOL
+    );
+    timeline_add(&g_startup_timeline, "World upload", load->meshed_ms, time_now_ms(), 0);
+
+    LOG_INFO("World initialized, %u chunks\n", load->chunk_count);
+
+    // stand on the ground of the spawn column instead of falling onto it
+    i32 terrain_height;
+    i32 top;
+    if (world_get_column_height(
+            g_game.world,
+            (i32)floorf(g_player.position[0]),
+            (i32)floorf(g_player.position[2]),
+            &terrain_height,
+            &top
+        )) {
+        g_player.position[1] = (f32)(terrain_height > top ? terrain_height : top) + 1.0f;
+    }
 
     g_game.time = 0.0f;
 
@@ -305,6 +440,7 @@ int game_init(void) {
 }
 
 void game_update(f32 delta_time) {
+    PROFILE_SCOPE("game_update");
     g_game.time += delta_time;
 
     player_update(&g_player);
@@ -361,23 +497,30 @@ void game_update(f32 delta_time) {
     }
 
     world_remesh_queue_process(g_game.world);
-}
-
-void game_draw(void) {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glClearColor(g_game.sky_color[0], g_game.sky_color[1], g_game.sky_color[2], 1.0f);
 
-    shader_t* current_shader = NULL;
+    PROFILE_COUNTER("remesh_queue", g_game.world->chunk_slot_remesh_queue_count);
+    PROFILE_COUNTER("loaded_chunks", g_game.world->loaded_chunk_count);
+    PROFILE_COUNTER("job_queue", job_pool_queued(&g_job_pool));
 
-    light_sun_shadow_update(&g_game.instances.sun);
+    // a crash loses at most SAVE_JOURNAL_INTERVAL seconds of edits
+    g_game.journal_timer += delta_time;
+    if (g_save != NULL && g_game.journal_timer >= SAVE_JOURNAL_INTERVAL) {
+        g_game.journal_timer = 0.0f;
 
-    if (g_debug_tools.no_lighting) {
-        shader_use(&g_game.content.unlit_shader);
-        current_shader = &g_game.content.unlit_shader;
-    } else {
-        shader_use(&g_game.content.world_shader);
-        current_shader = &g_game.content.world_shader;
+        // only copying the chunks out stalls the frame, they're written on the pool
+        f64 start = time_now_ms();
+        world_save_dirty_chunks(g_game.world);
+        save_journal_flush(g_save);
+        g_game.autosave_ms = time_now_ms() - start;
     }
+}
+
+void game_draw(void) {
+    PROFILE_SCOPE("game_draw");
+    render_queue_t* queue = &g_game.render_queue;
+    render_queue_reset(queue);
+
+    frame_uniforms_t* frame = &queue->frame;
 
     // Get light dir based on time of day
     f32 time_of_day =
@@ -398,8 +541,6 @@ void game_draw(void) {
     // rotate it around the y axis so it's not boring
     glm_vec3_rotate(light_dir, glm_rad(30.0f), (vec3){ 0.0f, 1.0f, 0.0f });
 
-    shader_set_vec3(&g_game.content.world_shader, "u_light_dir", light_dir);
-
     f32 light_intensity = 0.0f;
 
     if (time_of_day >= 6.0f && time_of_day <= 18.0f) {
@@ -455,78 +596,220 @@ void game_draw(void) {
         glm_vec3_lerp((f32*)nighttime_sky_color, (f32*)daytime_sky_color, t, g_game.sky_color);
     }
 
-    player_set_uniforms(&g_player, current_shader);
+    glm_vec3_negate_to(light_dir, g_game.instances.sun.direction);
+    glm_vec3_copy(sun_pos, g_game.instances.sun.position);
+    g_game.instances.sun.intensity = light_intensity;
 
-    if (!g_debug_tools.no_lighting) {
-        shader_set_float(&g_game.content.world_shader, "u_light_intensity", light_intensity);
-        float ambient_intensity = glm_lerp(0.4f, 0.2f, light_intensity);
+    // Everything shared by the passes below goes up in a single upload
+    player_set_frame_uniforms(&g_player, frame);
 
-        shader_set_vec4(
-            &g_game.content.world_shader,
-            "u_ambient_color",
-            (vec4){ ambient_intensity, ambient_intensity, ambient_intensity, 1.0f }
-        );
+    light_sun_shadow_update(&g_game.instances.sun, queue, frame->view, frame->projection);
+    light_sun_set_frame_uniforms(&g_game.instances.sun, frame);
 
-        shader_set_vec4(
-            &g_game.content.world_shader,
-            "u_fog_color",
-            (vec4){ g_game.sky_color[0], g_game.sky_color[1], g_game.sky_color[2], 1.0f }
-        );
+    float ambient_intensity = glm_lerp(0.4f, 0.2f, light_intensity);
+    glm_vec4_copy(
+        (vec4){ ambient_intensity, ambient_intensity, ambient_intensity, 1.0f },
+        frame->ambient_color
+    );
+    glm_vec4_copy(
+        (vec4){ g_game.sky_color[0], g_game.sky_color[1], g_game.sky_color[2], 1.0f },
+        frame->fog_color
+    );
+    frame->fog_start = 0.0f;
+    frame->fog_end = 200.0f;
+    frame->fog_density = 0.0001f;
+
+    i32 framebuffer_width, framebuffer_height;
+    glfwGetFramebufferSize(g_window, &framebuffer_width, &framebuffer_height);
+
+    render_pass_t world_pass = {
+        .sort_mode = RENDER_SORT_STATE,
+        .framebuffer = 0,
+        .viewport = { 0, 0, framebuffer_width, framebuffer_height },
+        .clear = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+        .clear_color = { g_game.sky_color[0], g_game.sky_color[1], g_game.sky_color[2], 1.0f },
+        .depth_test = true,
+        .cull_face = !g_debug_tools.no_cull,
+        .blend = true,
+        .textures = {
+            { GL_TEXTURE_2D_ARRAY, g_game.instances.sun.shadow_map.texture },
+            { GL_TEXTURE_2D, g_game.instances.sun.shadow_map.noise_texture },
+        },
+    };
+    glm_mat4_mul(frame->projection, frame->view, world_pass.uniforms.view_projection);
+    render_queue_set_pass(queue, RENDER_PASS_WORLD, &world_pass);
+
+    // The sun and gizmos draw over the world with the same setup, minus the clear
+    render_pass_t overlay_pass = world_pass;
+    overlay_pass.clear = 0;
+    render_queue_set_pass(queue, RENDER_PASS_SKY, &overlay_pass);
+    render_queue_set_pass(queue, RENDER_PASS_GIZMO, &overlay_pass);
+
+    // features that are off are compiled out of the permutation, not skipped at runtime
+    u32 world_features = game_world_features();
+    shader_base_t* world_shader = &g_game.content.world_shader;
+    shader_t* gizmo_shader = shader_base_get(world_shader, 0);
+
+    world_submit(
+        g_game.world,
+        queue,
+        RENDER_PASS_WORLD,
+        shader_base_get(world_shader, world_features)->program,
+        (world_features & SHADER_FEATURE_TEXTURE) ? g_game.content.atlas.id : 0,
+        frame->world_eye
+    );
 
-        shader_set_vec4(
-            &g_game.content.world_shader,
-            "u_color",
-            (vec4){ 1.0f, 1.0f, 1.0f, 1.0f }
-        );
+    mesh_instance_submit(
+        &g_game.instances.sun_instance,
+        queue,
+        RENDER_PASS_SKY,
+        shader_base_get(world_shader, SHADER_FEATURE_TEXTURE)->program,
+        g_game.content.sun.id,
+        frame->world_eye
+    );
+
+    mesh_instance_submit(
+        &g_game.instances.plain_axes_instance,
+        queue,
+        RENDER_PASS_GIZMO,
+        gizmo_shader->program,
+        0,
+        frame->world_eye
+    );
 
-        shader_set_float(&g_game.content.world_shader, "u_fog_start", 0.0f);
-        shader_set_float(&g_game.content.world_shader, "u_fog_end", 200.0f);
-        shader_set_float(&g_game.content.world_shader, "u_fog_density", 0.0001f);
+    if (g_player.block_selected) {
+        mesh_instance_submit(
+            &g_game.instances.cube_skeleton_instance,
+            queue,
+            RENDER_PASS_GIZMO,
+            gizmo_shader->program,
+            0,
+            frame->world_eye
+        );
     }
+}
 
-    shader_set_uint(&g_game.content.world_shader, "u_texture", 0);
+void game_draw_debug(void) {}
 
-    if (g_debug_tools.no_textures) {
-        texture_bind(&g_magic_pixel, 0);
-    } else {
-        texture_bind(&g_game.content.atlas, 0);
+void game_draw_ui(void) {
+    i32 framebuffer_width, framebuffer_height;
+    glfwGetFramebufferSize(g_window, &framebuffer_width, &framebuffer_height);
+
+    render_pass_t ui_pass = {
+        .sort_mode = RENDER_SORT_SUBMISSION,
+        .framebuffer = 0,
+        .viewport = { 0, 0, framebuffer_width, framebuffer_height },
+        .depth_test = false,
+        .cull_face = !g_debug_tools.no_cull,
+        .blend = true,
+    };
+    glm_mat4_mul(g_game.ui.projection, g_game.ui.view, ui_pass.uniforms.view_projection);
+    render_queue_set_pass(&g_game.render_queue, RENDER_PASS_UI, &ui_pass);
+
+    ui_submit(&g_game.ui, &g_game.render_queue, g_game.content.ui_shader.program);
+}
+
+void game_render(void) {
+    PROFILE_SCOPE("game_render");
+    render_queue_t* queue = &g_game.render_queue;
+    render_queue_sort(queue);
+
+    if (g_debug_tools.capture_render_queue) {
+        g_debug_tools.capture_render_queue = false;
+        render_queue_copy(&g_game.render_capture, queue);
+
+        FILE* file = fopen(RENDER_QUEUE_CAPTURE_PATH, "w");
+        if (file) {
+            render_queue_dump(&g_game.render_capture, file);
+            fclose(file);
+            LOG_INFO(
+                "Captured %zu render packets to %s\n",
+                g_game.render_capture.count,
+                RENDER_QUEUE_CAPTURE_PATH
+            );
+        } else {
+            LOG_ERROR("Failed to open %s\n", RENDER_QUEUE_CAPTURE_PATH);
+        }
     }
 
-    glm_vec3_negate(light_dir);
-    glm_vec3_copy(light_dir, g_game.instances.sun.direction);
-    glm_vec3_copy(sun_pos, g_game.instances.sun.position);
-    light_sun_shadow_set_uniforms(&g_game.instances.sun, current_shader);
+    if (g_debug_tools.replay_render_queue && g_game.render_capture.count > 0 &&
+        render_queue_stale(&g_game.render_capture)) {
+        // chunks unloaded or remeshed, or the world was reset, since it was captured
+        LOG_WARNING("Render capture draws freed meshes, dropping it, capture again with F9\n");
+        render_queue_reset(&g_game.render_capture);
+        g_debug_tools.replay_render_queue = false;
+    }
 
-    world_draw(g_game.world);
+    if (g_debug_tools.replay_render_queue && g_game.render_capture.count > 0) {
+        queue = &g_game.render_capture;
+        // the capture overwrites the cached shadow cascades with its own
+        light_sun_shadow_invalidate(&g_game.instances.sun);
+    }
 
-    shader_use(&g_game.content.unlit_shader);
-    player_set_uniforms(&g_player, &g_game.content.unlit_shader);
+    render_queue_execute(queue, &g_game.uniforms);
+    g_game.render_queue.stats = queue->stats;
 
-    texture_bind(&g_game.content.sun, 0);
+    light_sun_shadow_frame_end(&g_game.instances.sun, &queue->stats, g_gametime.delta_time);
+}
 
-    mesh_instance_draw(&g_game.instances.sun_instance);
+void game_bench_shadows(u32 frames) {
+    light_sun_t* sun = &g_game.instances.sun;
+    shadow_quality_t previous_quality = sun->shadow_map.settings.quality;
+    bool previous_force_day = g_debug_tools.force_day;
+
+    // a fixed, lit scene, the camera and sun don't move so cascades stay cached and the
+    // difference between tiers is the shadow sampling in the world pass
+    g_debug_tools.force_day = true;
+
+    i32 width, height;
+    glfwGetFramebufferSize(g_window, &width, &height);
+    f64 pixels = (f64)width * (f64)height;
+
+    LOG_INFO(
+        "Shadow quality benchmark: %u frames per tier at %dx%d on %s\n",
+        frames,
+        width,
+        height,
+        (const char*)glGetString(GL_RENDERER)
+    );
 
-    shader_use(&g_game.content.gizmo_shader);
-    player_set_uniforms(&g_player, &g_game.content.gizmo_shader);
+    f64 baseline_ms = 0.0;
 
-    shader_set_float(&g_game.content.gizmo_shader, "u_fog_start", 0.0f);
-    shader_set_float(&g_game.content.gizmo_shader, "u_fog_end", 200.0f);
-    shader_set_float(&g_game.content.gizmo_shader, "u_fog_density", 0.0001f);
+    for (u32 i = 0; i < SHADOW_QUALITY_COUNT; i++) {
+        light_sun_set_shadow_quality(sun, (shadow_quality_t)i);
 
-    mesh_instance_draw(&g_game.instances.plain_axes_instance);
+        // compiles the permutation and fills the cascades
+        for (u32 frame = 0; frame < 8; frame++) {
+            game_draw();
+            game_draw_ui();
+            game_render();
+        }
+        glFinish();
 
-    if (g_player.block_selected) {
-        mesh_instance_draw(&g_game.instances.cube_skeleton_instance);
-    }
-}
+        f64 start = time_now_ms();
+        for (u32 frame = 0; frame < frames; frame++) {
+            game_draw();
+            game_draw_ui();
+            game_render();
+        }
+        glFinish();
+        f64 frame_ms = (time_now_ms() - start) / (f64)frames;
 
-void game_draw_debug(void) {}
+        if (i == SHADOW_QUALITY_OFF) {
+            baseline_ms = frame_ms;
+        }
 
-void game_draw_ui(void) {
-    shader_set_mat4(&g_game.content.ui_shader, "u_view", g_game.ui.view);
-    shader_set_mat4(&g_game.content.ui_shader, "u_projection", g_game.ui.projection);
+        LOG_INFO(
+            "  %-9s %8.3f ms/frame  %+8.3f ms vs off  %6.2f ns/pixel\n",
+            shadow_quality_names[i],
+            frame_ms,
+            frame_ms - baseline_ms,
+            (frame_ms - baseline_ms) * 1000000.0 / pixels
+        );
+    }
 
-    ui_draw(&g_game.ui);
+    light_sun_set_shadow_quality(sun, previous_quality);
+    g_debug_tools.force_day = previous_force_day;
 }
 
 void game_free(void) {
@@ -535,12 +818,14 @@ void game_free(void) {
 
     light_sun_free(&g_game.instances.sun);
 
-    shader_free(&g_game.content.world_shader);
+    uniforms_free(&g_game.uniforms);
+    render_queue_free(&g_game.render_queue);
+    render_queue_free(&g_game.render_capture);
+
+    shader_base_free(&g_game.content.world_shader);
     shader_free(&g_game.content.ui_shader);
     shader_free(&g_game.content.shadow_shader);
     // shader_free(&g_game.content.sprite_shader);
-    shader_free(&g_game.content.gizmo_shader);
-    shader_free(&g_game.content.unlit_shader);
 
     texture_free(&g_game.content.atlas);
     texture_free(&g_magic_pixel);
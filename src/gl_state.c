@@ -0,0 +1,183 @@
+#include "gl_state.h"
+
+#include "log.h"
+#include "types.h"
+
+#include <GL/glew.h>
+#include <string.h>
+
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+gl_state_t g_gl_state = {
+    .program = GL_STATE_UNKNOWN,
+    .vertex_array = GL_STATE_UNKNOWN,
+    .framebuffer = GL_STATE_UNKNOWN,
+    .active_texture_unit = GL_STATE_UNKNOWN,
+    .viewport = { -1, -1, -1, -1 },
+    .blend = -1,
+    .depth_test = -1,
+    .cull_face = -1,
+};
+
+// Returns -1 for targets that aren't tracked, binds to those are always issued
+static i32 gl_state_target_index(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_2D_ARRAY:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+void gl_state_invalidate(void) {
+    g_gl_state.program = GL_STATE_UNKNOWN;
+    g_gl_state.vertex_array = GL_STATE_UNKNOWN;
+    g_gl_state.framebuffer = GL_STATE_UNKNOWN;
+    g_gl_state.active_texture_unit = GL_STATE_UNKNOWN;
+    memset(g_gl_state.textures, 0xFF, sizeof(g_gl_state.textures));
+    g_gl_state.viewport[0] = -1;
+    g_gl_state.viewport[1] = -1;
+    g_gl_state.viewport[2] = -1;
+    g_gl_state.viewport[3] = -1;
+    g_gl_state.blend = -1;
+    g_gl_state.depth_test = -1;
+    g_gl_state.cull_face = -1;
+}
+
+void gl_state_frame_end(void) {
+    g_gl_state.last_frame_stats = g_gl_state.frame_stats;
+    g_gl_state.frame_stats = (gl_state_stats_t){ 0 };
+}
+
+void gl_state_use_program(GLuint program) {
+    if (g_gl_state.program == program) {
+        g_gl_state.frame_stats.skipped++;
+        return;
+    }
+
+    glUseProgram(program);
+    g_gl_state.program = program;
+    g_gl_state.frame_stats.issued++;
+}
+
+void gl_state_bind_vertex_array(GLuint vertex_array) {
+    if (g_gl_state.vertex_array == vertex_array) {
+        g_gl_state.frame_stats.skipped++;
+        return;
+    }
+
+    glBindVertexArray(vertex_array);
+    g_gl_state.vertex_array = vertex_array;
+    g_gl_state.frame_stats.issued++;
+}
+
+void gl_state_bind_framebuffer(GLuint framebuffer) {
+    if (g_gl_state.framebuffer == framebuffer) {
+        g_gl_state.frame_stats.skipped++;
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    g_gl_state.framebuffer = framebuffer;
+    g_gl_state.frame_stats.issued++;
+}
+
+void gl_state_bind_texture(u32 unit, GLenum target, GLuint texture) {
+    i32 target_index = gl_state_target_index(target);
+
+    if (unit >= GL_STATE_TEXTURE_UNITS || target_index < 0) {
+        LOG_WARNING("Untracked texture bind (unit %u, target 0x%x)\n", unit, target);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        g_gl_state.active_texture_unit = unit;
+        g_gl_state.frame_stats.issued += 2;
+        return;
+    }
+
+    if (g_gl_state.textures[unit][target_index] == texture) {
+        g_gl_state.frame_stats.skipped++;
+        return;
+    }
+
+    if (g_gl_state.active_texture_unit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        g_gl_state.active_texture_unit = unit;
+        g_gl_state.frame_stats.issued++;
+    }
+
+    glBindTexture(target, texture);
+    g_gl_state.textures[unit][target_index] = texture;
+    g_gl_state.frame_stats.issued++;
+}
+
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (g_gl_state.viewport[0] == x && g_gl_state.viewport[1] == y &&
+        g_gl_state.viewport[2] == width && g_gl_state.viewport[3] == height) {
+        g_gl_state.frame_stats.skipped++;
+        return;
+    }
+
+    glViewport(x, y, width, height);
+    g_gl_state.viewport[0] = x;
+    g_gl_state.viewport[1] = y;
+    g_gl_state.viewport[2] = width;
+    g_gl_state.viewport[3] = height;
+    g_gl_state.frame_stats.issued++;
+}
+
+static void gl_state_set_capability(i8* cached, GLenum capability, bool enabled) {
+    if (*cached == (i8)enabled) {
+        g_gl_state.frame_stats.skipped++;
+        return;
+    }
+
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    *cached = (i8)enabled;
+    g_gl_state.frame_stats.issued++;
+}
+
+void gl_state_set_blend(bool enabled) {
+    gl_state_set_capability(&g_gl_state.blend, GL_BLEND, enabled);
+}
+
+void gl_state_set_depth_test(bool enabled) {
+    gl_state_set_capability(&g_gl_state.depth_test, GL_DEPTH_TEST, enabled);
+}
+
+void gl_state_set_cull_face(bool enabled) {
+    gl_state_set_capability(&g_gl_state.cull_face, GL_CULL_FACE, enabled);
+}
+
+void gl_state_forget_program(GLuint program) {
+    if (g_gl_state.program == program) {
+        g_gl_state.program = GL_STATE_UNKNOWN;
+    }
+}
+
+void gl_state_forget_vertex_array(GLuint vertex_array) {
+    if (g_gl_state.vertex_array == vertex_array) {
+        g_gl_state.vertex_array = GL_STATE_UNKNOWN;
+    }
+}
+
+void gl_state_forget_framebuffer(GLuint framebuffer) {
+    if (g_gl_state.framebuffer == framebuffer) {
+        g_gl_state.framebuffer = GL_STATE_UNKNOWN;
+    }
+}
+
+void gl_state_forget_texture(GLuint texture) {
+    for (u32 unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+        for (u32 target = 0; target < GL_STATE_TEXTURE_TARGETS; target++) {
+            if (g_gl_state.textures[unit][target] == texture) {
+                g_gl_state.textures[unit][target] = GL_STATE_UNKNOWN;
+            }
+        }
+    }
+}
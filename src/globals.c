@@ -1,7 +1,9 @@
 #include "globals.h"
 
 #include "game.h"
+#include "gl_state.h"
 #include "player.h"
+#include "profile.h"
 #include "types.h"
 #include "world.h"
 #include <GLFW/glfw3.h>
@@ -29,7 +31,11 @@ void debug_tools_key_callback(int key, int action, int mods) {
                 g_player.movement_mode = 0;
             }
         } else if (key == GLFW_KEY_F2) {
-            // reserved
+            light_sun_t* sun = &g_game.instances.sun;
+            light_sun_set_shadow_quality(
+                sun,
+                (sun->shadow_map.settings.quality + 1) % SHADOW_QUALITY_COUNT
+            );
         } else if (key == GLFW_KEY_F3) {
             g_debug_tools.show_wireframe = !g_debug_tools.show_wireframe;
             glPolygonMode(GL_FRONT_AND_BACK, g_debug_tools.show_wireframe ? GL_LINE : GL_FILL);
@@ -41,15 +47,17 @@ void debug_tools_key_callback(int key, int action, int mods) {
             g_debug_tools.no_lighting = !g_debug_tools.no_lighting;
         } else if (key == GLFW_KEY_F6) {
             g_debug_tools.no_cull = !g_debug_tools.no_cull;
-            if (g_debug_tools.no_cull) {
-                glDisable(GL_CULL_FACE);
-            } else {
-                glEnable(GL_CULL_FACE);
-            }
+            gl_state_set_cull_face(!g_debug_tools.no_cull);
         } else if (key == GLFW_KEY_F7) {
             g_debug_tools.no_chunk_load = !g_debug_tools.no_chunk_load;
         } else if (key == GLFW_KEY_F8) {
             g_debug_tools.force_day = !g_debug_tools.force_day;
+        } else if (key == GLFW_KEY_F9) {
+            g_debug_tools.capture_render_queue = true;
+        } else if (key == GLFW_KEY_F10) {
+            g_debug_tools.replay_render_queue = !g_debug_tools.replay_render_queue;
+        } else if (key == GLFW_KEY_F11) {
+            profile_trace_toggle();
         } else if (key == GLFW_KEY_R) {
             world_free(g_game.world);
             g_game.world = world_new();
@@ -0,0 +1,138 @@
+#include "gpu_timer.h"
+
+#include "log.h"
+#include "render_queue.h"
+#include "types.h"
+
+#include <GL/glew.h>
+#include <string.h>
+
+gpu_timers_t g_gpu_timers = { .active = -1 };
+
+// keep in sync with render_pass_id_t, ImGui last
+const char* gpu_timer_names[] = {
+    "Shadow cascade 0",
+    "Shadow cascade 1",
+    "Shadow cascade 2",
+    "Shadow cascade 3",
+    "World",
+    "Sky",
+    "Gizmos",
+    "UI",
+    "ImGui",
+};
+_Static_assert(
+    sizeof(gpu_timer_names) / sizeof(gpu_timer_names[0]) == GPU_TIMER_COUNT,
+    "every render pass and ImGui need a GPU timer name"
+);
+
+void gpu_timers_init(void) {
+    memset(&g_gpu_timers, 0, sizeof(gpu_timers_t));
+    g_gpu_timers.active = -1;
+
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) {
+        LOG_WARNING("No timer queries, GPU pass times are unavailable\n");
+        return;
+    }
+
+    // some software rasterizers expose the queries without a counter behind them
+    GLint bits = 0;
+    glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits == 0) {
+        LOG_WARNING("Timer queries have no counter bits, GPU pass times are unavailable\n");
+        return;
+    }
+
+    glGenQueries(GPU_TIMER_FRAMES * GPU_TIMER_COUNT, &g_gpu_timers.queries[0][0]);
+    g_gpu_timers.supported = glGetError() == GL_NO_ERROR;
+    if (!g_gpu_timers.supported) {
+        LOG_WARNING("Failed to create timer queries, GPU pass times are unavailable\n");
+    }
+}
+
+void gpu_timers_free(void) {
+    if (g_gpu_timers.supported) {
+        glDeleteQueries(GPU_TIMER_FRAMES * GPU_TIMER_COUNT, &g_gpu_timers.queries[0][0]);
+    }
+    g_gpu_timers.supported = false;
+}
+
+void gpu_timer_begin(u32 timer) {
+    if (!g_gpu_timers.supported || g_gpu_timers.active >= 0) {
+        return;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, g_gpu_timers.queries[g_gpu_timers.frame][timer]);
+    g_gpu_timers.active = (i32)timer;
+}
+
+void gpu_timer_end(u32 timer) {
+    if (g_gpu_timers.active != (i32)timer) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+    g_gpu_timers.issued[g_gpu_timers.frame][timer] = true;
+    g_gpu_timers.active = -1;
+}
+
+void gpu_timers_frame_end(f32 delta_time) {
+    if (!g_gpu_timers.supported) {
+        return;
+    }
+
+    g_gpu_timers.frame = (g_gpu_timers.frame + 1) % GPU_TIMER_FRAMES;
+    u32 frame = g_gpu_timers.frame;
+
+    // the last query of a frame finishes last, if it isn't ready the frame is dropped
+    // rather than waited for
+    i32 last = -1;
+    for (u32 i = 0; i < GPU_TIMER_COUNT; i++) {
+        if (g_gpu_timers.issued[frame][i]) {
+            last = (i32)i;
+        }
+    }
+
+    if (last >= 0) {
+        GLint available = 0;
+        glGetQueryObjectiv(
+            g_gpu_timers.queries[frame][last],
+            GL_QUERY_RESULT_AVAILABLE,
+            &available
+        );
+
+        if (available) {
+            for (u32 i = 0; i < GPU_TIMER_COUNT; i++) {
+                GLuint64 elapsed_ns = 0;
+                if (g_gpu_timers.issued[frame][i]) {
+                    glGetQueryObjectui64v(
+                        g_gpu_timers.queries[frame][i],
+                        GL_QUERY_RESULT,
+                        &elapsed_ns
+                    );
+                }
+                g_gpu_timers.last_ms[i] = (f64)elapsed_ns / 1000000.0;
+                g_gpu_timers.window_ms[i] += g_gpu_timers.last_ms[i];
+            }
+            g_gpu_timers.window_frames++;
+        } else {
+            g_gpu_timers.late_frames++;
+        }
+    }
+    memset(g_gpu_timers.issued[frame], 0, sizeof(g_gpu_timers.issued[frame]));
+
+    g_gpu_timers.window_seconds += (f64)delta_time;
+    if (g_gpu_timers.window_seconds >= 1.0) {
+        f64 frames = (f64)g_gpu_timers.window_frames;
+        g_gpu_timers.average_total_ms = 0.0;
+        for (u32 i = 0; i < GPU_TIMER_COUNT; i++) {
+            g_gpu_timers.average_ms[i] =
+                frames > 0.0 ? g_gpu_timers.window_ms[i] / frames : 0.0;
+            g_gpu_timers.average_total_ms += g_gpu_timers.average_ms[i];
+            g_gpu_timers.window_ms[i] = 0.0;
+        }
+
+        g_gpu_timers.window_seconds = 0.0;
+        g_gpu_timers.window_frames = 0;
+    }
+}
@@ -0,0 +1,202 @@
+#include "job.h"
+
+#include "log.h"
+#include "thread.h"
+#include "types.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define JOB_QUEUE_INITIAL_CAPACITY 256
+
+job_pool_t g_job_pool;
+
+static _Thread_local u32 t_worker_index = 0;
+
+typedef struct job_worker {
+    job_pool_t* pool;
+    u32 index;
+} job_worker_t;
+
+static job_worker_t g_job_workers[JOB_POOL_MAX_THREADS];
+
+// mutex must be held
+static bool job_pool_pop(job_pool_t* pool, job_t* job) {
+    if (pool->queue_count == 0) {
+        return false;
+    }
+
+    *job = pool->queue[pool->queue_head];
+    pool->queue_head = (pool->queue_head + 1) % pool->queue_capacity;
+    pool->queue_count--;
+
+    return true;
+}
+
+// mutex must not be held, retakes it to account the job
+static void job_run(job_pool_t* pool, job_t* job) {
+    job->fn(job->arg);
+
+    mutex_lock(&pool->mutex);
+    if (job->group && --job->group->pending == 0) {
+        job->group->done_ms = time_now_ms();
+    }
+    cond_broadcast(&pool->job_done);
+    mutex_unlock(&pool->mutex);
+}
+
+static void job_worker_main(void* arg) {
+    job_worker_t* worker = arg;
+    job_pool_t* pool = worker->pool;
+    t_worker_index = worker->index;
+
+    mutex_lock(&pool->mutex);
+    for (;;) {
+        job_t job;
+        if (job_pool_pop(pool, &job)) {
+            mutex_unlock(&pool->mutex);
+            job_run(pool, &job);
+            mutex_lock(&pool->mutex);
+            continue;
+        }
+
+        if (pool->stopping) {
+            break;
+        }
+
+        cond_wait(&pool->work_available, &pool->mutex);
+    }
+    mutex_unlock(&pool->mutex);
+}
+
+void job_pool_init(job_pool_t* pool, u32 thread_count) {
+    memset(pool, 0, sizeof(job_pool_t));
+    mutex_init(&pool->mutex);
+    cond_init(&pool->work_available);
+    cond_init(&pool->job_done);
+
+    pool->queue = malloc(sizeof(job_t) * JOB_QUEUE_INITIAL_CAPACITY);
+    pool->queue_capacity = JOB_QUEUE_INITIAL_CAPACITY;
+
+    if (thread_count > JOB_POOL_MAX_THREADS) {
+        thread_count = JOB_POOL_MAX_THREADS;
+    }
+
+    for (u32 i = 0; i < thread_count; i++) {
+        g_job_workers[i] = (job_worker_t){ .pool = pool, .index = i + 1 };
+        if (!thread_create(&pool->threads[i], job_worker_main, &g_job_workers[i])) {
+            LOG_WARNING("Failed to start job worker %u\n", i + 1);
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    LOG_INFO("Job pool started with %u workers\n", pool->thread_count);
+}
+
+void job_pool_free(job_pool_t* pool) {
+    mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    cond_broadcast(&pool->work_available);
+    mutex_unlock(&pool->mutex);
+
+    for (u32 i = 0; i < pool->thread_count; i++) {
+        thread_join(&pool->threads[i]);
+    }
+
+    // without workers nothing else would run them
+    job_t job;
+    while (job_pool_pop(pool, &job)) {
+        job_run(pool, &job);
+    }
+
+    free(pool->queue);
+    cond_free(&pool->job_done);
+    cond_free(&pool->work_available);
+    mutex_free(&pool->mutex);
+    memset(pool, 0, sizeof(job_pool_t));
+}
+
+void job_submit(job_pool_t* pool, job_group_t* group, job_fn fn, void* arg) {
+    // before job_pool_init, or after job_pool_free, there is nothing to queue on
+    if (!pool->queue) {
+        fn(arg);
+        return;
+    }
+
+    mutex_lock(&pool->mutex);
+
+    if (pool->queue_count == pool->queue_capacity) {
+        usize capacity = pool->queue_capacity * 2;
+        job_t* queue = malloc(sizeof(job_t) * capacity);
+
+        for (usize i = 0; i < pool->queue_count; i++) {
+            queue[i] = pool->queue[(pool->queue_head + i) % pool->queue_capacity];
+        }
+
+        free(pool->queue);
+        pool->queue = queue;
+        pool->queue_capacity = capacity;
+        pool->queue_head = 0;
+    }
+
+    usize tail = (pool->queue_head + pool->queue_count) % pool->queue_capacity;
+    pool->queue[tail] = (job_t){ .fn = fn, .arg = arg, .group = group };
+    pool->queue_count++;
+
+    if (group) {
+        group->pending++;
+    }
+
+    cond_signal(&pool->work_available);
+    mutex_unlock(&pool->mutex);
+}
+
+void job_group_wait(job_pool_t* pool, job_group_t* group) {
+    if (!pool->queue) {
+        return;
+    }
+
+    mutex_lock(&pool->mutex);
+
+    while (group->pending > 0) {
+        job_t job;
+        if (job_pool_pop(pool, &job)) {
+            mutex_unlock(&pool->mutex);
+            job_run(pool, &job);
+            mutex_lock(&pool->mutex);
+            continue;
+        }
+
+        cond_wait(&pool->job_done, &pool->mutex);
+    }
+
+    mutex_unlock(&pool->mutex);
+}
+
+bool job_group_done(job_pool_t* pool, job_group_t* group) {
+    if (!pool->queue) {
+        return group->pending == 0;
+    }
+
+    mutex_lock(&pool->mutex);
+    bool done = group->pending == 0;
+    mutex_unlock(&pool->mutex);
+    return done;
+}
+
+u32 job_worker_index(void) {
+    return t_worker_index;
+}
+
+usize job_pool_queued(job_pool_t* pool) {
+    if (!pool->queue) {
+        return 0;
+    }
+
+    mutex_lock(&pool->mutex);
+    usize queued = pool->queue_count;
+    mutex_unlock(&pool->mutex);
+    return queued;
+}
@@ -1,73 +1,169 @@
 #include "lighting.h"
 
 #include "game.h"
+#include "gl_state.h"
 #include "globals.h"
 #include "log.h"
 #include "player.h"
+#include "profile.h"
+#include "render_queue.h"
 #include "shader.h"
 #include "types.h"
+#include "uniforms.h"
 #include "world.h"
 
 #include <GL/glew.h>
 #include <cglm/cam.h>
 #include <cglm/cglm.h>
+#include <math.h>
+#include <string.h>
 
-void shadow_map_init(shadow_map_t* shadow_map) {
-    glGenFramebuffers(1, &shadow_map->fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadow_map->fbo);
+const char* shadow_quality_names[SHADOW_QUALITY_COUNT] = {
+    "off",
+    "hard",
+    "poisson4",
+    "poisson9",
+};
 
-    glGenTextures(1, &shadow_map->texture);
-    glBindTexture(GL_TEXTURE_2D, shadow_map->texture);
+u32 shadow_quality_features(shadow_quality_t quality) {
+    switch (quality) {
+        case SHADOW_QUALITY_HARD:
+            return SHADER_FEATURE_SHADOW_HARD;
+        case SHADOW_QUALITY_POISSON_4:
+            return SHADER_FEATURE_SHADOW_POISSON_4;
+        case SHADOW_QUALITY_POISSON_9:
+            return SHADER_FEATURE_SHADOW_POISSON_9;
+        case SHADOW_QUALITY_OFF:
+        default:
+            return 0;
+    }
+}
+
+// Random rotations stored as (cos, sin) remapped to 0..1, tiled over the screen so
+// neighbouring pixels sample the Poisson disk at different angles
+static GLuint shadow_noise_texture_new(void) {
+    u8 noise[SHADOW_NOISE_SIZE * SHADOW_NOISE_SIZE * 2];
+    u32 state = 0x9E3779B9u;
+
+    for (u32 i = 0; i < SHADOW_NOISE_SIZE * SHADOW_NOISE_SIZE; i++) {
+        state = state * 1664525u + 1013904223u;
+        f32 angle = (f32)(state >> 8) / (f32)(1u << 24) * 2.0f * GLM_PIf;
+        noise[i * 2 + 0] = (u8)((cosf(angle) * 0.5f + 0.5f) * 255.0f + 0.5f);
+        noise[i * 2 + 1] = (u8)((sinf(angle) * 0.5f + 0.5f) * 255.0f + 0.5f);
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, texture);
     glTexImage2D(
         GL_TEXTURE_2D,
         0,
-        GL_DEPTH_COMPONENT,
-        SHADOW_MAP_SIZE,
-        SHADOW_MAP_SIZE,
+        GL_RG8,
+        SHADOW_NOISE_SIZE,
+        SHADOW_NOISE_SIZE,
         0,
-        GL_DEPTH_COMPONENT,
-        GL_FLOAT,
-        NULL
+        GL_RG,
+        GL_UNSIGNED_BYTE,
+        noise
     );
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_color);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    glFramebufferTexture2D(
-        GL_FRAMEBUFFER,
-        GL_DEPTH_ATTACHMENT,
-        GL_TEXTURE_2D,
-        shadow_map->texture,
-        0
+    return texture;
+}
+
+void shadow_map_init(shadow_map_t* shadow_map, shadow_settings_t settings) {
+    if (settings.cascade_count == 0) {
+        settings.cascade_count = 1;
+    } else if (settings.cascade_count > SHADOW_CASCADE_MAX) {
+        settings.cascade_count = SHADOW_CASCADE_MAX;
+    }
+    shadow_map->settings = settings;
+
+    GLenum internal_format = GL_DEPTH_COMPONENT16;
+    GLenum type = GL_UNSIGNED_SHORT;
+    if (settings.depth_format == SHADOW_DEPTH_24) {
+        internal_format = GL_DEPTH_COMPONENT24;
+        type = GL_UNSIGNED_INT;
+    }
+
+    glGenTextures(1, &shadow_map->texture);
+    gl_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, shadow_map->texture);
+    glTexImage3D(
+        GL_TEXTURE_2D_ARRAY,
+        0,
+        (GLint)internal_format,
+        (GLsizei)settings.resolution,
+        (GLsizei)settings.resolution,
+        (GLsizei)settings.cascade_count,
+        0,
+        GL_DEPTH_COMPONENT,
+        type,
+        NULL
     );
+    // linear filtering with compare mode gives a free 2x2 PCF on most hardware
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border_color);
 
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
+    glGenFramebuffers((GLsizei)settings.cascade_count, shadow_map->fbos);
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        LOG_ERROR("Shadow map framebuffer incomplete");
+    for (u32 i = 0; i < settings.cascade_count; i++) {
+        gl_state_bind_framebuffer(shadow_map->fbos[i]);
+        glFramebufferTextureLayer(
+            GL_FRAMEBUFFER,
+            GL_DEPTH_ATTACHMENT,
+            shadow_map->texture,
+            0,
+            (GLint)i
+        );
+
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR("Shadow map framebuffer for cascade %u incomplete\n", i);
+        }
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
+    gl_state_bind_framebuffer(0);
 
-void shadow_map_bind(shadow_map_t* shadow_map) {
-    glBindFramebuffer(GL_FRAMEBUFFER, shadow_map->fbo);
-    glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
-    glClear(GL_DEPTH_BUFFER_BIT);
-}
+    shadow_map->noise_texture = shadow_noise_texture_new();
 
-void shadow_map_unbind(void) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, g_window_size[0], g_window_size[1]);
+    LOG_INFO(
+        "Shadow map: %u cascades of %ux%u, %u-bit depth, %.1f MiB\n",
+        settings.cascade_count,
+        settings.resolution,
+        settings.resolution,
+        settings.depth_format == SHADOW_DEPTH_24 ? 24 : 16,
+        (f64)shadow_map_size_bytes(shadow_map) / (1024.0 * 1024.0)
+    );
 }
 
 void shadow_map_free(shadow_map_t* shadow_map) {
-    glDeleteFramebuffers(1, &shadow_map->fbo);
+    for (u32 i = 0; i < shadow_map->settings.cascade_count; i++) {
+        gl_state_forget_framebuffer(shadow_map->fbos[i]);
+    }
+    gl_state_forget_texture(shadow_map->texture);
+    gl_state_forget_texture(shadow_map->noise_texture);
+    glDeleteFramebuffers((GLsizei)shadow_map->settings.cascade_count, shadow_map->fbos);
     glDeleteTextures(1, &shadow_map->texture);
+    glDeleteTextures(1, &shadow_map->noise_texture);
+}
+
+usize shadow_map_size_bytes(shadow_map_t* shadow_map) {
+    // 24-bit depth is stored in 32 bits by every driver we care about
+    usize texel_size = shadow_map->settings.depth_format == SHADOW_DEPTH_24 ? 4 : 2;
+
+    return (usize)shadow_map->settings.resolution * shadow_map->settings.resolution *
+           shadow_map->settings.cascade_count * texel_size;
 }
 
 void light_sun_init(
@@ -82,54 +178,343 @@ void light_sun_init(
     glm_vec3_copy(color, light_sun->color);
     light_sun->intensity = intensity;
 
-    shadow_map_init(&light_sun->shadow_map);
-
-    mat4 light_projection;
-    glm_ortho(-40.0f, 40.0f, -40.0f, 40.0f, 0.1f, 200.0f, light_projection);
-
-    mat4 light_view;
-    glm_look(light_sun->position, light_sun->direction, (vec3){ 0.0f, 1.0f, 0.0f }, light_view);
+    memset(light_sun->cascades, 0, sizeof(light_sun->cascades));
+    light_sun->next_far_cascade = 1;
+    memset(&light_sun->stats, 0, sizeof(light_sun->stats));
 
-    glm_mat4_mul(light_projection, light_view, light_sun->light_view_projection);
+    shadow_map_init(&light_sun->shadow_map, SHADOW_SETTINGS_DEFAULT);
 }
 
 void light_sun_free(light_sun_t* light_sun) {
     shadow_map_free(&light_sun->shadow_map);
 }
 
-void light_sun_shadow_update(light_sun_t* light_sun) {
-    mat4 light_projection;
-    glm_ortho(-100.0f, 100.0f, -100.0f, 100.0f, 0.1f, 200.0f, light_projection);
+void light_sun_set_shadow_settings(light_sun_t* light_sun, shadow_settings_t settings) {
+    shadow_map_free(&light_sun->shadow_map);
+    shadow_map_init(&light_sun->shadow_map, settings);
+    light_sun_shadow_invalidate(light_sun);
+}
+
+void light_sun_set_shadow_quality(light_sun_t* light_sun, shadow_quality_t quality) {
+    // nothing was rendered while shadows were off
+    if (light_sun->shadow_map.settings.quality == SHADOW_QUALITY_OFF) {
+        light_sun_shadow_invalidate(light_sun);
+    }
+    light_sun->shadow_map.settings.quality = quality;
+}
+
+void light_sun_shadow_invalidate(light_sun_t* light_sun) {
+    for (u32 i = 0; i < SHADOW_CASCADE_MAX; i++) {
+        light_sun->cascades[i].valid = false;
+    }
+}
+
+// Blend of even and logarithmic split distances, see split_lambda
+static f32 shadow_cascade_split(shadow_settings_t* settings, f32 near, f32 far, u32 index) {
+    f32 t = (f32)(index + 1) / (f32)settings->cascade_count;
+    f32 logarithmic = near * powf(far / near, t);
+    f32 even = near + (far - near) * t;
+
+    return glm_lerp(even, logarithmic, settings->split_lambda);
+}
+
+// Bounding sphere of a slice of the view frustum
+// Its size doesn't change as the camera turns, only its center moves
+static f32 shadow_slice_bound(
+    mat4 inverse_view,
+    f32 tan_x,
+    f32 tan_y,
+    f32 near,
+    f32 far,
+    vec3 center
+) {
+    vec3 corners[8];
+    glm_vec3_zero(center);
+
+    for (u32 i = 0; i < 8; i++) {
+        f32 depth = (i & 4) ? far : near;
+        vec4 view_corner = {
+            ((i & 1) ? 1.0f : -1.0f) * depth * tan_x,
+            ((i & 2) ? 1.0f : -1.0f) * depth * tan_y,
+            -depth,
+            1.0f,
+        };
+
+        vec4 world_corner;
+        glm_mat4_mulv(inverse_view, view_corner, world_corner);
+        glm_vec3_copy(world_corner, corners[i]);
+        glm_vec3_add(center, corners[i], center);
+    }
+
+    glm_vec3_scale(center, 1.0f / 8.0f, center);
+
+    f32 radius = 0.0f;
+    for (u32 i = 0; i < 8; i++) {
+        radius = glm_max(radius, glm_vec3_distance(center, corners[i]));
+    }
+
+    return radius;
+}
+
+// Fit an orthographic light volume around a sphere. Snapping the projection to whole
+// texels keeps the shadow edges from crawling as the camera moves.
+static void shadow_cascade_fit(
+    shadow_cascade_t* cascade,
+    vec3 light_direction,
+    vec3 center,
+    f32 radius,
+    u32 resolution,
+    vec3 light_eye
+) {
+    // round up so float noise doesn't change the texel size from fit to fit
+    radius = ceilf(radius * 16.0f) / 16.0f;
+
+    // glm_look can't take an up vector parallel to the view direction
+    vec3 up = { 0.0f, 1.0f, 0.0f };
+    if (fabsf(light_direction[1]) > 0.99f) {
+        glm_vec3_copy((vec3){ 0.0f, 0.0f, 1.0f }, up);
+    }
+
+    glm_vec3_scale(light_direction, -(radius + SHADOW_CASTER_DISTANCE), light_eye);
+    glm_vec3_add(center, light_eye, light_eye);
 
     mat4 light_view;
-    glm_look(
-        light_sun->position,
-        light_sun->direction,
-        (vec3){ 0.0f, 1.0f, 0.0f },
-        light_view
+    glm_look(light_eye, light_direction, up, light_view);
+
+    mat4 light_projection;
+    glm_ortho(
+        -radius,
+        radius,
+        -radius,
+        radius,
+        0.0f,
+        2.0f * radius + SHADOW_CASTER_DISTANCE,
+        light_projection
     );
 
-    glm_mat4_mul(light_projection, light_view, light_sun->light_view_projection);
-    shadow_map_bind(&light_sun->shadow_map);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glDisable(GL_CULL_FACE);
-    shader_use(&g_game.content.shadow_shader);
+    mat4 view_projection;
+    glm_mat4_mul(light_projection, light_view, view_projection);
+
+    vec4 origin = { 0.0f, 0.0f, 0.0f, 1.0f };
+    glm_mat4_mulv(view_projection, origin, origin);
+
+    f32 half_resolution = (f32)resolution * 0.5f;
+    f32 origin_x = origin[0] * half_resolution;
+    f32 origin_y = origin[1] * half_resolution;
+    light_projection[3][0] += (roundf(origin_x) - origin_x) / half_resolution;
+    light_projection[3][1] += (roundf(origin_y) - origin_y) / half_resolution;
+
+    glm_mat4_mul(light_projection, light_view, cascade->view_projection);
+
+    glm_vec3_copy(center, cascade->center);
+    cascade->radius = radius;
+    glm_vec3_copy(light_direction, cascade->light_direction);
+    cascade->valid = true;
+}
+
+// Drop cascades that contain a chunk whose mesh changed since the last update
+static void light_sun_shadow_consume_world_changes(light_sun_t* light_sun, world_t* world) {
+    u32 cascade_count = light_sun->shadow_map.settings.cascade_count;
+
+    if (world->changed_chunks_overflow) {
+        light_sun_shadow_invalidate(light_sun);
+    } else {
+        for (u32 i = 0; i < cascade_count; i++) {
+            shadow_cascade_t* cascade = &light_sun->cascades[i];
+
+            for (u32 j = 0; j < world->changed_chunk_count && cascade->valid; j++) {
+                if (world_chunk_intersects_ortho(
+                        world->changed_chunks[j],
+                        cascade->view_projection
+                    )) {
+                    cascade->valid = false;
+                }
+            }
+        }
+    }
+
+    world_changed_chunks_clear(world);
+}
 
-    shader_set_mat4(
-        &g_game.content.shadow_shader,
-        "u_light_view_projection",
-        light_sun->light_view_projection
+static void light_sun_shadow_record(
+    light_sun_t* light_sun,
+    render_queue_t* queue,
+    u32 index,
+    vec3 light_eye
+) {
+    shadow_settings_t* settings = &light_sun->shadow_map.settings;
+    shadow_cascade_t* cascade = &light_sun->cascades[index];
+    render_pass_id_t pass_id = RENDER_PASS_SHADOW_CASCADE_0 + index;
+
+    render_pass_t pass = {
+        .sort_mode = RENDER_SORT_STATE,
+        .framebuffer = light_sun->shadow_map.fbos[index],
+        .viewport = { 0, 0, (GLint)settings->resolution, (GLint)settings->resolution },
+        .clear = GL_DEPTH_BUFFER_BIT,
+        .depth_test = true,
+        .cull_face = false,
+        .blend = false,
+    };
+    glm_mat4_copy(cascade->view_projection, pass.uniforms.view_projection);
+    render_queue_set_pass(queue, pass_id, &pass);
+
+    cascade->caster_count = world_submit_ortho_culled(
+        g_game.world,
+        queue,
+        pass_id,
+        g_game.content.shadow_shader.program,
+        0,
+        light_eye,
+        cascade->view_projection
     );
 
-    world_draw(g_game.world);
+    light_sun->stats.frame_renders++;
+}
+
+void light_sun_shadow_update(
+    light_sun_t* light_sun,
+    render_queue_t* queue,
+    mat4 view,
+    mat4 projection
+) {
+    PROFILE_SCOPE("light_sun_shadow_update");
+    shadow_settings_t* settings = &light_sun->shadow_map.settings;
+
+    light_sun_shadow_consume_world_changes(light_sun, g_game.world);
+
+    if (settings->quality == SHADOW_QUALITY_OFF) {
+        return;
+    }
+
+    mat4 inverse_view;
+    glm_mat4_inv(view, inverse_view);
+
+    // glm_perspective layout, the frustum's shape can be read straight off the projection
+    f32 tan_x = 1.0f / projection[0][0];
+    f32 tan_y = 1.0f / projection[1][1];
+    f32 near = projection[3][2] / (projection[2][2] - 1.0f);
+    f32 far = projection[3][2] / (projection[2][2] + 1.0f);
+    far = glm_min(far, settings->max_distance);
+
+    f32 cos_threshold = cosf(glm_rad(settings->light_angle_threshold));
+
+    bool stale[SHADOW_CASCADE_MAX] = { 0 };
+    vec3 centers[SHADOW_CASCADE_MAX];
+    f32 radii[SHADOW_CASCADE_MAX];
 
-    glEnable(GL_CULL_FACE);
-    shadow_map_unbind();
+    f32 cascade_near = near;
+
+    for (u32 i = 0; i < settings->cascade_count; i++) {
+        shadow_cascade_t* cascade = &light_sun->cascades[i];
+        f32 cascade_far = shadow_cascade_split(settings, near, far, i);
+
+        radii[i] = shadow_slice_bound(
+            inverse_view,
+            tan_x,
+            tan_y,
+            cascade_near,
+            cascade_far,
+            centers[i]
+        );
+        cascade->split = cascade_far;
+
+        // the slice has to fit inside what the cached depth covers
+        bool contained =
+            glm_vec3_distance(centers[i], cascade->center) + radii[i] <= cascade->radius;
+        bool light_moved =
+            glm_vec3_dot(cascade->light_direction, light_sun->direction) < cos_threshold;
+
+        stale[i] = !cascade->valid || !contained || light_moved;
+
+        cascade_near = cascade_far;
+    }
+
+    // the near cascade re-renders as soon as it's stale, far cascades whose cached depth
+    // still holds something take turns, at most one of them per frame. A cascade without
+    // any, like after an invalidation, renders right away so the shaders never sample it.
+    u32 far_count = settings->cascade_count - 1;
+    u32 far_pick = 0;
+    for (u32 j = 0; j < far_count; j++) {
+        u32 candidate = 1 + (light_sun->next_far_cascade - 1 + j) % far_count;
+        if (stale[candidate] && light_sun->cascades[candidate].valid) {
+            far_pick = candidate;
+            break;
+        }
+    }
+    if (far_pick) {
+        light_sun->next_far_cascade = 1 + far_pick % far_count;
+    }
+
+    for (u32 i = 0; i < settings->cascade_count; i++) {
+        bool deferred = i > 0 && i != far_pick && light_sun->cascades[i].valid;
+        if (!stale[i] || deferred) {
+            continue;
+        }
+
+        vec3 light_eye;
+        shadow_cascade_fit(
+            &light_sun->cascades[i],
+            light_sun->direction,
+            centers[i],
+            radii[i] * (1.0f + settings->cache_padding),
+            settings->resolution,
+            light_eye
+        );
+
+        light_sun_shadow_record(light_sun, queue, i, light_eye);
+    }
+}
+
+void light_sun_shadow_frame_end(
+    light_sun_t* light_sun,
+    render_queue_stats_t* queue_stats,
+    f32 delta_time
+) {
+    shadow_stats_t* stats = &light_sun->stats;
+
+    for (u32 i = 0; i < light_sun->shadow_map.settings.cascade_count; i++) {
+        stats->window_pass_ms += queue_stats->pass_ms[RENDER_PASS_SHADOW_CASCADE_0 + i];
+    }
+
+    stats->window_renders += stats->frame_renders;
+    stats->frame_renders = 0;
+    stats->window_seconds += (f64)delta_time;
+
+    if (stats->window_seconds >= 1.0) {
+        stats->renders_per_second = (f32)((f64)stats->window_renders / stats->window_seconds);
+        stats->average_pass_ms =
+            stats->window_renders ? stats->window_pass_ms / (f64)stats->window_renders : 0.0;
+
+        stats->window_seconds = 0.0;
+        stats->window_renders = 0;
+        stats->window_pass_ms = 0.0;
+    }
 }
 
-void light_sun_shadow_set_uniforms(light_sun_t* light_sun, shader_t* shader) {
-    shader_set_int(shader, "u_shadow_map", 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, light_sun->shadow_map.texture);
-    shader_set_mat4(shader, "u_light_view_projection", light_sun->light_view_projection);
+void light_sun_shadow_bind(light_sun_t* light_sun, u32 slot) {
+    gl_state_bind_texture(slot, GL_TEXTURE_2D_ARRAY, light_sun->shadow_map.texture);
+    gl_state_bind_texture(slot + 1, GL_TEXTURE_2D, light_sun->shadow_map.noise_texture);
+}
+
+void light_sun_set_frame_uniforms(light_sun_t* light_sun, frame_uniforms_t* frame) {
+    shadow_settings_t* settings = &light_sun->shadow_map.settings;
+
+    // shaders want the direction towards the light
+    glm_vec3_negate_to(light_sun->direction, frame->light_dir);
+    frame->light_intensity = light_sun->intensity;
+
+    for (u32 i = 0; i < SHADOW_CASCADE_MAX; i++) {
+        shadow_cascade_t* cascade = &light_sun->cascades[i];
+
+        if (i < settings->cascade_count) {
+            glm_mat4_copy(cascade->view_projection, frame->light_view_projection[i]);
+            frame->shadow_splits[i] = cascade->split;
+        } else {
+            glm_mat4_identity(frame->light_view_projection[i]);
+            frame->shadow_splits[i] = 0.0f;
+        }
+    }
+
+    frame->shadow_cascade_count = (i32)settings->cascade_count;
+    frame->shadow_texel_size = 1.0f / (f32)settings->resolution;
 }
@@ -20,20 +20,115 @@
 
 #include "camera.h"
 #include "game.h"
+#include "gl_state.h"
 #include "globals.h"
+#include "gpu_timer.h"
+#include "job.h"
 #include "physics.h"
 #include "player.h"
+#include "profile.h"
 #include "types.h"
 #include "log.h"
 #include "shader.h"
+#include "shader_cache.h"
+#include "thread.h"
+#include "timeline.h"
 #include "mesh.h"
 #include "assets.h"
 #include "ui.h"
+#include "utils.h"
 #include "world.h"
-#include "asset_data.h"
 
 #define FRAMETIME_SAMPLES 2000
 
+#ifndef SHIPPING
+#define PROFILE_ROW_NAME_WIDTH 280.0f
+#define PROFILE_ROW_BAR_WIDTH 140.0f
+
+// One row per profiled scope, its bar is its share of the average frame
+static void debug_draw_profile_node(const profile_tree_t* tree, u32 index) {
+    const profile_node_t* node = &tree->nodes[index];
+
+    // children always come after their parent
+    bool has_children = false;
+    for (u32 i = index + 1; i < tree->node_count && !has_children; i++) {
+        has_children = tree->nodes[i].parent == index;
+    }
+
+    ImGuiTreeNodeFlags flags =
+        ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_SpanFullWidth;
+    if (!has_children) {
+        flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+    }
+    bool open = igTreeNodeEx_Ptr(node, flags, "%s", node->name);
+
+    f64 frame_ms = g_profile.average_frame_ms;
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "%.3f ms", node->average_ms);
+    igSameLine(PROFILE_ROW_NAME_WIDTH, -1.0f);
+    igProgressBar(
+        frame_ms > 0.0 ? (f32)(node->average_ms / frame_ms) : 0.0f,
+        (ImVec2){ PROFILE_ROW_BAR_WIDTH, 0.0f },
+        overlay
+    );
+    igSameLine(0.0f, -1.0f);
+    igText(
+        "%5.1f%%  %6.1f calls  last %.3f ms",
+        frame_ms > 0.0 ? node->average_ms / frame_ms * 100.0 : 0.0,
+        (f64)node->average_calls,
+        node->last_ms
+    );
+
+    if (open && has_children) {
+        for (u32 i = index + 1; i < tree->node_count; i++) {
+            if (tree->nodes[i].parent == index) {
+                debug_draw_profile_node(tree, i);
+            }
+        }
+        igTreePop();
+    }
+}
+
+static void debug_draw_profile(void) {
+    static const char* tree_names[PROFILE_TREE_COUNT] = { "Main thread", "Job workers" };
+
+    if (!igCollapsingHeader_TreeNodeFlags("CPU scopes", ImGuiTreeNodeFlags_DefaultOpen)) {
+        return;
+    }
+
+    igCheckbox("Record", &g_profile.enabled);
+    igSameLine(0.0f, -1.0f);
+    const char* trace_label = g_profile.trace.capturing ? "Stop trace (F11)" : "Trace (F11)";
+    if (igButton(trace_label, (ImVec2){ 0 })) {
+        profile_trace_toggle();
+    }
+    if (g_profile.trace.capturing) {
+        igSameLine(0.0f, -1.0f);
+        igText(
+            "%u events, %.1f s",
+            g_profile.trace.event_count,
+            (time_now_ms() - g_profile.trace.start_ms) / 1000.0
+        );
+    }
+    igText(
+        "Averages over %u frames of %.2f ms, %llu events dropped",
+        g_profile.history_count,
+        g_profile.average_frame_ms,
+        (unsigned long long)g_profile.dropped
+    );
+
+    for (u32 t = 0; t < PROFILE_TREE_COUNT; t++) {
+        const profile_tree_t* tree = &g_profile.trees[t];
+        igText("%s:", tree_names[t]);
+        for (u32 i = 0; i < tree->node_count; i++) {
+            if (tree->nodes[i].parent == PROFILE_NO_PARENT) {
+                debug_draw_profile_node(tree, i);
+            }
+        }
+    }
+}
+#endif
+
 static void glfw_error_callback(int error, const char* description) {
     LOG_ERROR("GLFW Error %d: %s", error, description);
 }
@@ -62,7 +157,7 @@ static void glfw_window_size_callback(GLFWwindow* window, int width, int height)
 static void glfw_framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     (void)window; // unused
 
-    glViewport(0, 0, width, height);
+    gl_state_viewport(0, 0, width, height);
 }
 
 static void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -148,14 +243,51 @@ static int float_compare(const void* a, const void* b) {
 }
 
 typedef struct args {
-    bool vsync;      // -v, --vsync
-    char* save_path; // -s, --save
+    bool vsync;           // -v, --vsync
+    char* save_path;      // -s, --save
+    i32 shadow_quality;   // --shadow-quality <off|hard|poisson4|poisson9>, -1 for default
+    bool bench_shadows;   // --bench-shadows, time every shadow quality tier and exit
+    bool shader_cache;    // --no-shader-cache to always compile from source
+    char* asset_pack;     // --asset-pack <path>, only used when built with asset_source=pack
+    u32 bench_saves;      // --bench-saves [chunks], time writing and loading a save and exit
+    i32 save_encoding;    // --save-encoding <raw|rle|lz|best>, -1 for default
+    bool save_delta;      // --save-full-chunks to store edited chunks whole instead of as edits
+    u32 bench_noise;      // --bench-noise [samples], time the terrain noise and exit
+    u32 bench_generation; // --bench-generation [chunks], time chunk generation and exit
+    f64 trace_seconds;    // --trace [seconds], write a trace of the first frames, see profile.h
 } args_t;
 
+// ASSET_PACK_PATH in the executable's directory, so `./build/cubegame` finds build/assets.pak
+// Relative to the working directory when the executable was found through PATH
+static char* default_asset_pack_path(const char* executable) {
+    static char path[512];
+    const char* slash = strrchr(executable, '/');
+#ifdef _WIN32
+    const char* backslash = strrchr(executable, '\\');
+    if (backslash && (!slash || backslash > slash)) {
+        slash = backslash;
+    }
+#endif
+
+    int directory_length = slash ? (int)(slash - executable + 1) : 0;
+    snprintf(path, sizeof(path), "%.*s%s", directory_length, executable, ASSET_PACK_PATH);
+    return path;
+}
+
 static args_t parse_args(int argc, char** argv) {
     args_t args = {
         .vsync = false,
         .save_path = NULL,
+        .shadow_quality = -1,
+        .bench_shadows = false,
+        .shader_cache = true,
+        .asset_pack = default_asset_pack_path(argc > 0 ? argv[0] : ""),
+        .bench_saves = 0,
+        .save_encoding = -1,
+        .save_delta = true,
+        .bench_noise = 0,
+        .bench_generation = 0,
+        .trace_seconds = 0.0,
     };
 
     for (int i = 1; i < argc; i++) {
@@ -168,6 +300,67 @@ static args_t parse_args(int argc, char** argv) {
                 LOG_ERROR("No save path specified\n");
                 exit(1);
             }
+        } else if (strcmp(argv[i], "--shadow-quality") == 0) {
+            if (i + 1 < argc) {
+                i++;
+                for (i32 quality = 0; quality < SHADOW_QUALITY_COUNT; quality++) {
+                    if (strcmp(argv[i], shadow_quality_names[quality]) == 0) {
+                        args.shadow_quality = quality;
+                    }
+                }
+            }
+
+            if (args.shadow_quality < 0) {
+                LOG_ERROR("Expected off, hard, poisson4 or poisson9 after --shadow-quality\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--bench-shadows") == 0) {
+            args.bench_shadows = true;
+        } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+            args.shader_cache = false;
+        } else if (strcmp(argv[i], "--bench-saves") == 0) {
+            args.bench_saves = 100000;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                args.bench_saves = (u32)strtoul(argv[++i], NULL, 10);
+            }
+        } else if (strcmp(argv[i], "--bench-noise") == 0) {
+            args.bench_noise = 10000000;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                args.bench_noise = (u32)strtoul(argv[++i], NULL, 10);
+            }
+        } else if (strcmp(argv[i], "--bench-generation") == 0) {
+            args.bench_generation = 4096;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                args.bench_generation = (u32)strtoul(argv[++i], NULL, 10);
+            }
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            args.trace_seconds = 10.0;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                args.trace_seconds = strtod(argv[++i], NULL);
+            }
+        } else if (strcmp(argv[i], "--save-encoding") == 0) {
+            if (i + 1 < argc) {
+                i++;
+                for (i32 encoding = 0; encoding < SAVE_ENCODING_COUNT; encoding++) {
+                    if (strcmp(argv[i], save_encoding_names[encoding]) == 0) {
+                        args.save_encoding = encoding;
+                    }
+                }
+            }
+
+            if (args.save_encoding < 0) {
+                LOG_ERROR("Expected raw, rle, lz or best after --save-encoding\n");
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--save-full-chunks") == 0) {
+            args.save_delta = false;
+        } else if (strcmp(argv[i], "--asset-pack") == 0) {
+            if (i + 1 < argc) {
+                args.asset_pack = argv[++i];
+            } else {
+                LOG_ERROR("No asset pack path specified\n");
+                exit(1);
+            }
         }
     }
 
@@ -175,8 +368,47 @@ static args_t parse_args(int argc, char** argv) {
 }
 
 int main(int argc, char** argv) {
+    f64 startup_start = time_now_ms();
+    timeline_init(&g_startup_timeline);
     args_t args = parse_args(argc, argv);
 
+    if (args.bench_saves) {
+        // saves are written on the job pool
+        log_init();
+        u32 cores = thread_hardware_concurrency();
+        job_pool_init(&g_job_pool, cores > 1 ? cores - 1 : 0);
+
+        save_bench(args.bench_saves, "bench_save.cgsv");
+
+        job_pool_free(&g_job_pool);
+        timeline_free(&g_startup_timeline);
+        log_close();
+        return 0;
+    }
+
+    if (args.bench_noise) {
+        log_init();
+        noise_bench(args.bench_noise);
+        timeline_free(&g_startup_timeline);
+        log_close();
+        return 0;
+    }
+
+    if (args.bench_generation) {
+        log_init();
+        world_generator_bench(args.bench_generation, "bench_generation.png");
+        timeline_free(&g_startup_timeline);
+        log_close();
+        return 0;
+    }
+
+    // converting a save and recovering its journal already write regions on the pool
+    // the main thread helps out while it waits, so leave it a core
+    u32 cores = thread_hardware_concurrency();
+    job_pool_init(&g_job_pool, cores > 1 ? cores - 1 : 0);
+
+    u32 span = timeline_begin(&g_startup_timeline, "Save load");
+
     if (args.save_path == NULL) {
         LOG_INFO("No save path specified, creating new save\n");
         g_save = save_new();
@@ -194,19 +426,30 @@ int main(int argc, char** argv) {
                 g_save = save_new();
             }
         } else {
-            for (size_t i = 0; i < g_save->world.chunk_count; i++) {
-                LOG_INFO(
-                    "Loaded chunk %d %d %d\n",
-                    g_save->world.chunks[i].x,
-                    g_save->world.chunks[i].y,
-                    g_save->world.chunks[i].z
-                );
-            }
+            LOG_INFO("Loaded save %s\n", args.save_path);
         }
     }
 
+    if (args.save_encoding >= 0) {
+        g_save->encoding = (save_encoding_t)args.save_encoding;
+    }
+    if (!args.save_delta) {
+        g_save->delta = false;
+    }
+
+    // without -s this is a new world replacing the default save, and its journal with it
+    const char* save_path = args.save_path != NULL ? args.save_path : "save.cgsv";
+    if (!save_start(g_save, save_path, args.save_path != NULL)) {
+        LOG_ERROR("Not overwriting %s without a backup\n", save_path);
+        exit(1);
+    }
+
+    timeline_end(&g_startup_timeline, span);
+
     GLFWwindow* window;
 
+    span = timeline_begin(&g_startup_timeline, "Window and context");
+
     /* Initialize the library */
     if (!glfwInit())
         return -1;
@@ -238,7 +481,9 @@ int main(int argc, char** argv) {
 
     LOG_INFO("Logging initialized\n");
 
-    LOG_INFO("statically included asset data size: %zu\n", sizeof(a_asset_data));
+    if (!assets_open(args.asset_pack)) {
+        return -1;
+    }
 
     LOG_INFO("Window created\n");
 
@@ -266,6 +511,12 @@ int main(int argc, char** argv) {
 
     LOG_INFO("OpenGL Version: %s\n", glGetString(GL_VERSION));
 
+    shader_cache_init(args.shader_cache ? SHADER_CACHE_DIRECTORY : NULL);
+    shader_enable_parallel_compile();
+    gpu_timers_init();
+
+    timeline_end(&g_startup_timeline, span);
+
     LOG_INFO("Setting up ImGui\n");
 
     igCreateContext(NULL);
@@ -285,11 +536,15 @@ int main(int argc, char** argv) {
         LOG_INFO("Game content loaded\n");
     }
 
+    span = timeline_begin(&g_startup_timeline, "Game init");
+
     if (game_init() != 0) {
         LOG_ERROR("Failed to initialize game\n");
         return -1;
     }
 
+    timeline_end(&g_startup_timeline, span);
+
     LOG_INFO("Game initialized\n");
 
     glm_ortho(
@@ -306,44 +561,70 @@ int main(int argc, char** argv) {
 
     LOG_INFO("UI projection and view matrices initialized\n");
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state_set_depth_test(true);
     glDepthFunc(GL_LESS);
     glLineWidth(4.0f);
-    glEnable(GL_CULL_FACE);
+    gl_state_set_cull_face(true);
     glCullFace(GL_BACK);
-    glEnable(GL_BLEND);
+    gl_state_set_blend(true);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     LOG_INFO("OpenGL state set\n");
 
+    if (args.shadow_quality >= 0) {
+        light_sun_set_shadow_quality(
+            &g_game.instances.sun,
+            (shadow_quality_t)args.shadow_quality
+        );
+    }
+
+    if (args.bench_shadows) {
+        game_bench_shadows(200);
+
+        game_free();
+        assets_close();
+        job_pool_free(&g_job_pool);
+        timeline_free(&g_startup_timeline);
+        save_free(g_save);
+        gpu_timers_free();
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        igDestroyContext(NULL);
+        glfwTerminate();
+        log_close();
+        return 0;
+    }
+
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    profile_init();
+    if (args.trace_seconds > 0.0) {
+        profile_trace_start(args.trace_seconds);
+    }
+
     LOG_INFO("Entering main loop\n");
 
     float frametimes[FRAMETIME_SAMPLES];
     memset(frametimes, 0, sizeof(float) * FRAMETIME_SAMPLES);
     usize frametime_index = 0;
     usize frametime_count = 0;
+    f64 gpu_finish_ms = 0.0;
+    bool first_frame = true;
+    span = timeline_begin(&g_startup_timeline, "First frame");
 
     double last_time = glfwGetTime();
 
     while (!glfwWindowShouldClose(window)) {
         /* Render here */
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glClearColor(g_game.sky_color[0], g_game.sky_color[1], g_game.sky_color[2], 1.0f);
-        glEnable(GL_DEPTH_TEST);
-
+        // The draw functions only record, all GL work happens in game_render
         game_draw();
 
         game_draw_debug();
 
-        // UI
-        glDisable(GL_DEPTH_TEST);
-
-        shader_use(&g_game.content.ui_shader);
-
         game_draw_ui();
 
+        game_render();
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         igNewFrame();
@@ -361,6 +642,68 @@ int main(int argc, char** argv) {
                 g_player.selected_block[2]
             );
             igText("FPS: %f", 1.0f / g_gametime.delta_time);
+            igText(
+                "GL state changes: %u issued, %u skipped",
+                g_gl_state.last_frame_stats.issued,
+                g_gl_state.last_frame_stats.skipped
+            );
+            igText(
+                "Render queue: %u packets, %u passes, %u program / %u texture changes%s",
+                g_game.render_queue.stats.packets,
+                g_game.render_queue.stats.passes,
+                g_game.render_queue.stats.program_changes,
+                g_game.render_queue.stats.texture_changes,
+                g_debug_tools.replay_render_queue ? " (replaying capture)" : ""
+            );
+
+            light_sun_t* sun = &g_game.instances.sun;
+            igText(
+                "Shadow map (%s, F2): %.1f MiB, %.1f cascade renders/s, %.3f ms per render",
+                shadow_quality_names[sun->shadow_map.settings.quality],
+                (f64)shadow_map_size_bytes(&sun->shadow_map) / (1024.0 * 1024.0),
+                (f64)sun->stats.renders_per_second,
+                sun->stats.average_pass_ms
+            );
+            for (u32 i = 0; i < sun->shadow_map.settings.cascade_count; i++) {
+                igText(
+                    "  Cascade %u: up to %.1fm, %u casters%s",
+                    i,
+                    (f64)sun->cascades[i].split,
+                    sun->cascades[i].caster_count,
+                    sun->cascades[i].valid ? "" : " (stale)"
+                );
+            }
+
+            save_journal_stats_t* autosave = &g_save->journal_stats;
+            igText(
+                "Autosave: %u chunks, %.2f ms on the main thread, %.1f ms in the background",
+                autosave->chunk_count,
+                g_game.autosave_ms,
+                autosave->write_ms
+            );
+
+            if (g_gpu_timers.supported) {
+                igText(
+                    "GPU: %.3f ms per frame, %u frames read back late",
+                    g_gpu_timers.average_total_ms,
+                    g_gpu_timers.late_frames
+                );
+                for (u32 i = 0; i < GPU_TIMER_COUNT; i++) {
+                    if (g_gpu_timers.average_ms[i] > 0.0) {
+                        igText(
+                            "  %s: %.3f ms, last %.3f ms",
+                            gpu_timer_names[i],
+                            g_gpu_timers.average_ms[i],
+                            g_gpu_timers.last_ms[i]
+                        );
+                    }
+                }
+            } else {
+                igText("GPU: no timer queries in this context");
+            }
+            if (!args.vsync) {
+                igText("glFinish: %.3f ms waiting for the GPU", gpu_finish_ms);
+            }
 
             igText("Frametimes:");
             // plot frametimes
@@ -376,16 +719,36 @@ int main(int argc, char** argv) {
                 sizeof(float)
             );
 
+#ifndef SHIPPING
+            debug_draw_profile();
+#endif
+
             igEnd();
         }
 
         igRender();
+        gpu_timer_begin(GPU_TIMER_IMGUI);
         ImGui_ImplOpenGL3_RenderDrawData(igGetDrawData());
+        gpu_timer_end(GPU_TIMER_IMGUI);
+        // ImGui sets its own state, don't trust the cache after it
+        gl_state_invalidate();
+        gl_state_frame_end();
 
         if (args.vsync) {
             glfwSwapBuffers(window);
         } else {
+            // single buffered, the frame time includes this wait for the GPU
+            f64 finish_start = time_now_ms();
             glFinish();
+            gpu_finish_ms = time_now_ms() - finish_start;
+        }
+        gpu_timers_frame_end(g_gametime.delta_time);
+
+        if (first_frame) {
+            timeline_end(&g_startup_timeline, span);
+            LOG_INFO("Time to first frame: %.1f ms\n", time_now_ms() - startup_start);
+            timeline_log(&g_startup_timeline, "Startup timeline");
+            first_frame = false;
         }
 
         g_mouse.last_position[0] = g_mouse.position[0];
@@ -408,6 +771,8 @@ int main(int argc, char** argv) {
 
         game_update(g_gametime.delta_time);
 
+        profile_frame_end();
+
         for (u32 i = 0; i < 3; i++) {
             g_mouse.buttons[i] = false;
         }
@@ -488,22 +853,26 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (args.save_path != NULL) {
-        save_write(g_save, args.save_path);
-    } else {
-        save_write(g_save, "save.cgsv");
-    }
+    // everything older is in the journal already
+    save_journal_flush(g_save);
 
     save_free(g_save);
     g_save = NULL;
 
     game_free();
+    assets_close();
+    job_pool_free(&g_job_pool);
+    timeline_free(&g_startup_timeline);
+    // a capture still running is written as far as it got
+    profile_trace_stop();
+    profile_free();
 
     LOG_INFO("Total chunks: %zu\n", total_chunks);
     LOG_INFO("Total blocks: %zu\n", total_blocks);
     LOG_INFO("Total vertices: %zu\n", total_vertices);
     LOG_INFO("Total triangles: %zu\n", total_tris);
 
+    gpu_timers_free();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     igDestroyContext(NULL);
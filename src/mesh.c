@@ -1,8 +1,11 @@
 #include "mesh.h"
+#include "gl_state.h"
 #include "glm_extra.h"
 #include "shader.h"
 #include "globals.h"
+#include "render_queue.h"
 #include <cglm/mat4.h>
+#include <cglm/vec3.h>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -11,7 +14,7 @@ void mesh_init(mesh_t* mesh) {
     glGenVertexArrays(1, &mesh->vao);
     glGenBuffers(1, &mesh->vbo);
 
-    glBindVertexArray(mesh->vao);
+    gl_state_bind_vertex_array(mesh->vao);
     glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
     glBufferData(
         GL_ARRAY_BUFFER,
@@ -42,17 +45,17 @@ void mesh_init(mesh_t* mesh) {
         sizeof(vertex_t),
         (void*)offsetof(vertex_t, uv)
     );
-
-    glBindVertexArray(0);
 }
 
+// The VAO is left bound, the next draw rebinds only if it uses a different mesh
 void mesh_draw(mesh_t* mesh) {
-    glBindVertexArray(mesh->vao);
+    gl_state_bind_vertex_array(mesh->vao);
     glDrawElements(mesh->draw_mode, mesh->index_count, GL_UNSIGNED_INT, mesh->indices);
-    glBindVertexArray(0);
 }
 
 void mesh_free(mesh_t* mesh) {
+    g_render_resource_generation++;
+    gl_state_forget_vertex_array(mesh->vao);
     glDeleteVertexArrays(1, &mesh->vao);
     glDeleteBuffers(1, &mesh->vbo);
 }
@@ -82,11 +85,37 @@ void mesh_instance_draw(mesh_instance_t* instance) {
     mesh_draw(instance->mesh);
 }
 
+void mesh_instance_submit(
+    mesh_instance_t* instance,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye
+) {
+    if (!instance->active) {
+        return;
+    }
+
+    f32 depth = glm_vec3_distance(eye, instance->transform[3]);
+
+    render_queue_submit(
+        queue,
+        pass,
+        instance->mesh,
+        program,
+        texture,
+        instance->transform,
+        instance->color,
+        depth
+    );
+}
+
 void mesh_instance_batch_draw(mesh_instance_t* instances, usize count) {
     if (count == 0) {
         return;
     }
-    glBindVertexArray(instances[0].mesh->vao);
+    gl_state_bind_vertex_array(instances[0].mesh->vao);
 
     for (usize i = 0; i < count; i++) {
         if (!instances[i].active) {
@@ -101,6 +130,4 @@ void mesh_instance_batch_draw(mesh_instance_t* instances, usize count) {
             instances[i].mesh->indices
         );
     }
-
-    glBindVertexArray(0);
 }
@@ -0,0 +1,96 @@
+#include "pack.h"
+
+#include "file_map.h"
+#include "log.h"
+#include "types.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool pack_open(pack_t* pack, const char* path) {
+    memset(pack, 0, sizeof(pack_t));
+
+    if (!file_map_open(&pack->map, path)) {
+        LOG_ERROR("Failed to map asset pack %s\n", path);
+        return false;
+    }
+
+    pack->data = pack->map.data;
+    pack->size = pack->map.size;
+
+    pack_header_t header;
+    if (pack->size < sizeof(pack_header_t)) {
+        LOG_ERROR("Asset pack %s is truncated\n", path);
+        pack_close(pack);
+        return false;
+    }
+    memcpy(&header, pack->data, sizeof(pack_header_t));
+
+    if (memcmp(&header.magic, PACK_MAGIC_STR, 4) != 0 ||
+        header.format_version != PACK_FORMAT_VERSION) {
+        LOG_ERROR("%s is not a version %d asset pack\n", path, PACK_FORMAT_VERSION);
+        pack_close(pack);
+        return false;
+    }
+
+    usize index_end = sizeof(pack_header_t) + sizeof(pack_entry_t) * header.entry_count;
+    if (index_end > pack->size) {
+        LOG_ERROR("Asset pack %s index is truncated\n", path);
+        pack_close(pack);
+        return false;
+    }
+
+    // the writer keeps entries aligned, the index can be used in place
+    pack->entries = (const pack_entry_t*)(pack->data + sizeof(pack_header_t));
+    pack->entry_count = header.entry_count;
+
+    for (u32 i = 0; i < pack->entry_count; i++) {
+        const pack_entry_t* entry = &pack->entries[i];
+        if ((usize)entry->offset + entry->size + 1 > pack->size ||
+            entry->name[PACK_NAME_MAX - 1] != '\0') {
+            LOG_ERROR("Asset pack %s entry %u is corrupt\n", path, i);
+            pack_close(pack);
+            return false;
+        }
+    }
+
+    LOG_INFO(
+        "Mapped asset pack %s, %u assets in %zu bytes\n",
+        path,
+        pack->entry_count,
+        pack->size
+    );
+
+    return true;
+}
+
+void pack_close(pack_t* pack) {
+    file_map_close(&pack->map);
+    memset(pack, 0, sizeof(pack_t));
+}
+
+const u8* pack_find(const pack_t* pack, const char* name, usize* size) {
+    u32 low = 0;
+    u32 high = pack->entry_count;
+
+    while (low < high) {
+        u32 middle = low + (high - low) / 2;
+        const pack_entry_t* entry = &pack->entries[middle];
+        i32 order = strncmp(name, entry->name, PACK_NAME_MAX);
+
+        if (order == 0) {
+            if (size) {
+                *size = entry->size;
+            }
+            return pack->data + entry->offset;
+        }
+
+        if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    return NULL;
+}
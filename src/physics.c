@@ -1,20 +1,10 @@
 #include <cglm/cglm.h>
 #include <cglm/types.h>
 
-#include "globals.h"
 #include "log.h"
 #include "physics.h"
 #include "world.h"
 
-void ray_from_camera(ray_t* ray, camera_t* camera) {
-    camera_screen_to_world(
-        camera,
-        (vec2){ (float)g_window_size[0] / 2, (float)g_window_size[1] / 2 },
-        &ray->origin,
-        &ray->direction
-    );
-}
-
 bool ray_intersect_block(
     ray_t r,
     world_t* world,
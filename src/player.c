@@ -17,6 +17,7 @@
 #include "globals.h"
 #include "log.h"
 #include "physics.h"
+#include "profile.h"
 #include "types.h"
 #include "world.h"
 
@@ -330,6 +331,7 @@ static void player_look(player_t* player) {
 }
 
 void player_update(player_t* player) {
+    PROFILE_SCOPE("player_update");
     player_look(player);
     player_movement(player);
 
@@ -340,6 +342,7 @@ void player_update(player_t* player) {
     camera_update(&player->camera);
 
     world_get_chunk_positionf(player->position, player->current_chunk);
+    glm_vec3_copy(player->position, g_game.world->focus);
 
     if (g_debug_tools.no_chunk_load) {
         return;
@@ -373,8 +376,8 @@ void player_update(player_t* player) {
     }
 }
 
-void player_set_uniforms(player_t* player, shader_t* shader) {
-    shader_set_mat4(shader, "u_view", player->camera.view);
-    shader_set_mat4(shader, "u_projection", player->camera.projection);
-    shader_set_vec3(shader, "u_world_eye", player->camera.position);
+void player_set_frame_uniforms(player_t* player, frame_uniforms_t* frame) {
+    glm_mat4_copy(player->camera.view, frame->view);
+    glm_mat4_copy(player->camera.projection, frame->projection);
+    glm_vec3_copy(player->camera.position, frame->world_eye);
 }
@@ -0,0 +1,420 @@
+#include "profile.h"
+
+#include "job.h"
+#include "log.h"
+#include "thread.h"
+#include "types.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+profile_t g_profile;
+
+// scopes open on this thread
+static _Thread_local u32 t_profile_depth = 0;
+
+void profile_init(void) {
+    memset(&g_profile, 0, sizeof(profile_t));
+    for (u32 i = 0; i < PROFILE_MAX_THREADS; i++) {
+        mutex_init(&g_profile.rings[i].mutex);
+    }
+    g_profile.frame_start_ms = time_now_ms();
+    g_profile.enabled = true;
+}
+
+void profile_free(void) {
+    g_profile.enabled = false;
+    free(g_profile.trace.events);
+    for (u32 i = 0; i < PROFILE_MAX_THREADS; i++) {
+        mutex_free(&g_profile.rings[i].mutex);
+    }
+}
+
+profile_scope_t profile_scope_begin(const char* name) {
+    if (!g_profile.enabled) {
+        return (profile_scope_t){ 0 };
+    }
+
+    t_profile_depth++;
+    return (profile_scope_t){ .name = name, .start_ms = time_now_ms() };
+}
+
+profile_scope_t profile_scope_begin_chunk(const char* name, const i32 position[3]) {
+    profile_scope_t scope = profile_scope_begin(name);
+    scope.has_position = true;
+    memcpy(scope.position, position, sizeof(scope.position));
+    return scope;
+}
+
+static void profile_record(const profile_event_t* event) {
+    u32 thread = job_worker_index();
+    profile_ring_t* ring = &g_profile.rings[thread < PROFILE_MAX_THREADS ? thread : 0];
+
+    mutex_lock(&ring->mutex);
+    if (ring->head - ring->tail < PROFILE_RING_SIZE) {
+        ring->events[ring->head % PROFILE_RING_SIZE] = *event;
+        ring->head++;
+    } else {
+        ring->dropped++;
+    }
+    mutex_unlock(&ring->mutex);
+}
+
+void profile_scope_end(profile_scope_t* scope) {
+    if (!scope->name) {
+        return;
+    }
+
+    f64 now = time_now_ms();
+    t_profile_depth--;
+
+    profile_event_t event = {
+        .name = scope->name,
+        .start_ms = scope->start_ms,
+        .end_ms = now,
+        .depth = t_profile_depth,
+        .type = scope->has_position ? PROFILE_EVENT_SCOPE_CHUNK : PROFILE_EVENT_SCOPE,
+    };
+    memcpy(event.position, scope->position, sizeof(event.position));
+    profile_record(&event);
+}
+
+void profile_counter(const char* name, f64 value) {
+    if (!g_profile.enabled || !g_profile.trace.capturing) {
+        return;
+    }
+
+    f64 now = time_now_ms();
+    profile_record(&(profile_event_t){
+        .name = name,
+        .start_ms = now,
+        .end_ms = now,
+        .depth = t_profile_depth,
+        .type = PROFILE_EVENT_COUNTER,
+        .value = value,
+    });
+}
+
+static void profile_trace_add(const profile_event_t* event, u32 thread) {
+    // spans cut by the start of the capture would begin before it
+    profile_trace_t* trace = &g_profile.trace;
+    if (event->start_ms < trace->start_ms) {
+        return;
+    }
+
+    if (trace->event_count == trace->event_capacity) {
+        if (trace->event_capacity == PROFILE_TRACE_MAX_EVENTS) {
+            trace->dropped++;
+            return;
+        }
+        u32 capacity = trace->event_capacity ? trace->event_capacity * 2 : 4096;
+        profile_trace_event_t* events =
+            realloc(trace->events, sizeof(profile_trace_event_t) * capacity);
+        if (!events) {
+            // the events so far are still in the old buffer
+            trace->dropped++;
+            return;
+        }
+        trace->events = events;
+        trace->event_capacity = capacity;
+    }
+
+    trace->events[trace->event_count++] = (profile_trace_event_t){
+        .event = *event,
+        .thread = thread,
+    };
+}
+
+// The child of parent called name, added if it's new, PROFILE_NO_PARENT if the tree is full
+static u32 profile_tree_node(profile_tree_t* tree, u32 parent, u32 depth, const char* name) {
+    for (u32 i = 0; i < tree->node_count; i++) {
+        profile_node_t* node = &tree->nodes[i];
+        if (node->parent == parent && (node->name == name || strcmp(node->name, name) == 0)) {
+            return i;
+        }
+    }
+
+    if (tree->node_count == PROFILE_MAX_NODES) {
+        return PROFILE_NO_PARENT;
+    }
+
+    profile_node_t* node = &tree->nodes[tree->node_count];
+    memset(node, 0, sizeof(profile_node_t));
+    node->name = name;
+    node->parent = parent;
+    node->depth = depth;
+    return tree->node_count++;
+}
+
+static bool profile_event_is_root(const profile_event_t* event) {
+    return event->type != PROFILE_EVENT_COUNTER && event->depth == 0;
+}
+
+// Drain a ring up to its last closed root scope into tree, and the trace if capturing
+static void profile_ring_drain(profile_ring_t* ring, u32 thread, profile_tree_t* tree) {
+    mutex_lock(&ring->mutex);
+
+    // events are in the order their scopes closed, so children come before their parent
+    // and everything after the last root belongs to scopes still open
+    u64 end = ring->head;
+    while (end > ring->tail &&
+           !profile_event_is_root(&ring->events[(end - 1) % PROFILE_RING_SIZE])) {
+        end--;
+    }
+
+    if (g_profile.trace.capturing) {
+        for (u64 i = ring->tail; i < end; i++) {
+            profile_trace_add(&ring->events[i % PROFILE_RING_SIZE], thread);
+        }
+    }
+
+    // walking back, every event's parent is the last one seen a level up
+    u32 path[PROFILE_MAX_DEPTH];
+    for (u32 i = 0; i < PROFILE_MAX_DEPTH; i++) {
+        path[i] = PROFILE_NO_PARENT;
+    }
+
+    for (u64 i = end; i > ring->tail; i--) {
+        profile_event_t* event = &ring->events[(i - 1) % PROFILE_RING_SIZE];
+        if (event->type == PROFILE_EVENT_COUNTER) {
+            continue;
+        }
+        if (event->depth >= PROFILE_MAX_DEPTH) {
+            g_profile.dropped++;
+            continue;
+        }
+
+        // a parent lost to a full ring leaves its children at the root
+        u32 parent = event->depth > 0 ? path[event->depth - 1] : PROFILE_NO_PARENT;
+        u32 depth = parent == PROFILE_NO_PARENT ? 0 : event->depth;
+        u32 index = profile_tree_node(tree, parent, depth, event->name);
+
+        path[event->depth] = index;
+        for (u32 j = event->depth + 1; j < PROFILE_MAX_DEPTH; j++) {
+            path[j] = PROFILE_NO_PARENT;
+        }
+
+        if (index == PROFILE_NO_PARENT) {
+            g_profile.dropped++;
+            continue;
+        }
+        tree->nodes[index].frame_ms += event->end_ms - event->start_ms;
+        tree->nodes[index].frame_calls++;
+    }
+
+    ring->tail = end;
+    g_profile.dropped += ring->dropped;
+    ring->dropped = 0;
+    mutex_unlock(&ring->mutex);
+}
+
+void profile_frame_end(void) {
+    if (!g_profile.enabled) {
+        return;
+    }
+
+    for (u32 i = 0; i < PROFILE_MAX_THREADS; i++) {
+        profile_tree_id_t tree = i == 0 ? PROFILE_TREE_MAIN : PROFILE_TREE_WORKERS;
+        profile_ring_drain(&g_profile.rings[i], i, &g_profile.trees[tree]);
+    }
+
+    u32 slot = g_profile.history_index;
+    if (g_profile.history_count < PROFILE_HISTORY) {
+        g_profile.history_count++;
+    }
+    f64 frames = (f64)g_profile.history_count;
+
+    for (u32 t = 0; t < PROFILE_TREE_COUNT; t++) {
+        profile_tree_t* tree = &g_profile.trees[t];
+        for (u32 i = 0; i < tree->node_count; i++) {
+            profile_node_t* node = &tree->nodes[i];
+
+            // nodes seen after the history started count as 0 before that, so those slots
+            // are already zeroed. Sums use the stored values so they don't drift.
+            f32 ms = (f32)node->frame_ms;
+            node->history_sum_ms += (f64)ms - (f64)node->history_ms[slot];
+            node->history_sum_calls += node->frame_calls;
+            node->history_sum_calls -= node->history_calls[slot];
+            node->history_ms[slot] = ms;
+            node->history_calls[slot] = node->frame_calls;
+
+            node->last_ms = node->frame_ms;
+            node->last_calls = node->frame_calls;
+            node->average_ms = node->history_sum_ms / frames;
+            node->average_calls = (f32)((f64)node->history_sum_calls / frames);
+            node->frame_ms = 0.0;
+            node->frame_calls = 0;
+        }
+    }
+
+    f64 now = time_now_ms();
+    if (g_profile.trace.capturing) {
+        // frames show as spans on the main thread, around everything that ran in them
+        profile_trace_add(
+            &(profile_event_t){
+                .name = "frame",
+                .start_ms = g_profile.frame_start_ms,
+                .end_ms = now,
+                .type = PROFILE_EVENT_SCOPE,
+            },
+            0
+        );
+        if (g_profile.trace.stop_ms > 0.0 && now >= g_profile.trace.stop_ms) {
+            profile_trace_stop();
+        }
+    }
+
+    f32 frame_ms = (f32)(now - g_profile.frame_start_ms);
+    g_profile.frame_start_ms = now;
+    g_profile.history_sum_frame_ms += (f64)frame_ms - (f64)g_profile.history_frame_ms[slot];
+    g_profile.history_frame_ms[slot] = frame_ms;
+    g_profile.average_frame_ms = g_profile.history_sum_frame_ms / frames;
+
+    g_profile.history_index = (slot + 1) % PROFILE_HISTORY;
+}
+
+void profile_trace_start(f64 seconds) {
+    profile_trace_t* trace = &g_profile.trace;
+    f64 now = time_now_ms();
+
+    g_profile.enabled = true;
+    trace->capturing = true;
+    trace->start_ms = now;
+    trace->stop_ms = seconds > 0.0 ? now + seconds * 1000.0 : 0.0;
+    trace->event_count = 0;
+    trace->dropped = 0;
+
+    if (seconds > 0.0) {
+        LOG_INFO("Tracing for %.1f s\n", seconds);
+    } else {
+        LOG_INFO("Tracing until stopped\n");
+    }
+}
+
+static void profile_trace_write_thread_name(FILE* file, u32 thread) {
+    if (thread == 0) {
+        fprintf(
+            file,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+            "\"args\":{\"name\":\"Main thread\"}}"
+        );
+    } else {
+        fprintf(
+            file,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"Job worker %u\"}}",
+            thread,
+            thread
+        );
+    }
+    // keep the main thread on top, then the workers in order
+    fprintf(
+        file,
+        ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+        "\"args\":{\"sort_index\":%u}}",
+        thread,
+        thread
+    );
+}
+
+static void profile_trace_write_event(FILE* file, const profile_trace_event_t* trace_event) {
+    const profile_event_t* event = &trace_event->event;
+    // microseconds from the start of the capture
+    f64 ts = (event->start_ms - g_profile.trace.start_ms) * 1000.0;
+
+    switch (event->type) {
+        case PROFILE_EVENT_SCOPE:
+            fprintf(
+                file,
+                ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                event->name,
+                trace_event->thread,
+                ts,
+                (event->end_ms - event->start_ms) * 1000.0
+            );
+            break;
+        case PROFILE_EVENT_SCOPE_CHUNK:
+            fprintf(
+                file,
+                ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"x\":%d,\"y\":%d,\"z\":%d}}",
+                event->name,
+                trace_event->thread,
+                ts,
+                (event->end_ms - event->start_ms) * 1000.0,
+                event->position[0],
+                event->position[1],
+                event->position[2]
+            );
+            break;
+        case PROFILE_EVENT_COUNTER:
+            fprintf(
+                file,
+                ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                "\"args\":{\"value\":%.17g}}",
+                event->name,
+                trace_event->thread,
+                ts,
+                event->value
+            );
+            break;
+    }
+}
+
+void profile_trace_stop(void) {
+    profile_trace_t* trace = &g_profile.trace;
+    if (!trace->capturing) {
+        return;
+    }
+    trace->capturing = false;
+
+    f64 start = time_now_ms();
+    FILE* file = fopen(PROFILE_TRACE_PATH, "w");
+    if (!file) {
+        LOG_ERROR("Failed to open %s\n", PROFILE_TRACE_PATH);
+        return;
+    }
+
+    fprintf(
+        file,
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"cubegame\"}}"
+    );
+
+    bool seen[PROFILE_MAX_THREADS] = { 0 };
+    seen[0] = true;
+    for (u32 i = 0; i < trace->event_count; i++) {
+        seen[trace->events[i].thread] = true;
+    }
+    for (u32 i = 0; i < PROFILE_MAX_THREADS; i++) {
+        if (seen[i]) {
+            profile_trace_write_thread_name(file, i);
+        }
+    }
+
+    for (u32 i = 0; i < trace->event_count; i++) {
+        profile_trace_write_event(file, &trace->events[i]);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    LOG_INFO(
+        "Wrote %u trace events over %.1f s to %s in %.1f ms, %llu dropped\n",
+        trace->event_count,
+        (start - trace->start_ms) / 1000.0,
+        PROFILE_TRACE_PATH,
+        time_now_ms() - start,
+        (unsigned long long)trace->dropped
+    );
+}
+
+void profile_trace_toggle(void) {
+    if (g_profile.trace.capturing) {
+        profile_trace_stop();
+    } else {
+        profile_trace_start(0.0);
+    }
+}
@@ -0,0 +1,333 @@
+#include "render_queue.h"
+
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "log.h"
+#include "mesh.h"
+#include "types.h"
+#include "uniforms.h"
+#include "utils.h"
+
+#include <GL/glew.h>
+#include <cglm/mat4.h>
+#include <cglm/util.h>
+#include <cglm/vec4.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_QUEUE_INITIAL_CAPACITY 1024
+
+u64 g_render_resource_generation = 0;
+
+// Sort key layout, most significant bits first:
+// RENDER_SORT_STATE:      pass:4 | program:8 | texture:12 | depth:24 | unused:16
+// RENDER_SORT_SUBMISSION: pass:4 | sequence:32 | unused:28
+#define RENDER_KEY_PASS_SHIFT 60
+#define RENDER_KEY_PROGRAM_SHIFT 52
+#define RENDER_KEY_TEXTURE_SHIFT 40
+#define RENDER_KEY_DEPTH_SHIFT 16
+#define RENDER_KEY_SEQUENCE_SHIFT 28
+
+#define RENDER_KEY_PASS(key) ((u32)((key) >> RENDER_KEY_PASS_SHIFT))
+
+static void render_queue_reserve(render_queue_t* queue, usize capacity) {
+    if (capacity <= queue->capacity) {
+        return;
+    }
+
+    usize new_capacity = queue->capacity ? queue->capacity : RENDER_QUEUE_INITIAL_CAPACITY;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+
+    queue->packets = realloc(queue->packets, sizeof(render_packet_t) * new_capacity);
+    queue->keys = realloc(queue->keys, sizeof(u64) * new_capacity);
+    queue->order = realloc(queue->order, sizeof(u32) * new_capacity);
+    queue->sort_keys = realloc(queue->sort_keys, sizeof(u64) * new_capacity);
+    queue->sort_order = realloc(queue->sort_order, sizeof(u32) * new_capacity);
+    queue->capacity = new_capacity;
+}
+
+void render_queue_init(render_queue_t* queue) {
+    memset(queue, 0, sizeof(render_queue_t));
+    render_queue_reserve(queue, RENDER_QUEUE_INITIAL_CAPACITY);
+}
+
+void render_queue_free(render_queue_t* queue) {
+    free(queue->packets);
+    free(queue->keys);
+    free(queue->order);
+    free(queue->sort_keys);
+    free(queue->sort_order);
+    memset(queue, 0, sizeof(render_queue_t));
+}
+
+void render_queue_reset(render_queue_t* queue) {
+    queue->count = 0;
+    queue->sorted = false;
+
+    for (u32 i = 0; i < RENDER_PASS_COUNT; i++) {
+        queue->passes[i].active = false;
+    }
+}
+
+void render_queue_set_pass(
+    render_queue_t* queue,
+    render_pass_id_t id,
+    const render_pass_t* pass
+) {
+    queue->passes[id] = *pass;
+    queue->passes[id].active = true;
+}
+
+static u64 render_queue_key(
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    f32 depth
+) {
+    u64 key = (u64)pass << RENDER_KEY_PASS_SHIFT;
+
+    if (queue->passes[pass].sort_mode == RENDER_SORT_SUBMISSION) {
+        return key | ((u64)(u32)queue->count << RENDER_KEY_SEQUENCE_SHIFT);
+    }
+
+    u64 quantized_depth =
+        (u64)(glm_clamp(depth / RENDER_QUEUE_MAX_DEPTH, 0.0f, 1.0f) * (f32)0xFFFFFF);
+
+    key |= (u64)(program & 0xFF) << RENDER_KEY_PROGRAM_SHIFT;
+    key |= (u64)(texture & 0xFFF) << RENDER_KEY_TEXTURE_SHIFT;
+    key |= quantized_depth << RENDER_KEY_DEPTH_SHIFT;
+
+    return key;
+}
+
+void render_queue_submit(
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    struct mesh* mesh,
+    GLuint program,
+    GLuint texture,
+    mat4 model,
+    vec4 color,
+    f32 depth
+) {
+    render_queue_reserve(queue, queue->count + 1);
+
+    render_packet_t* packet = &queue->packets[queue->count];
+    packet->mesh = mesh;
+    packet->program = program;
+    packet->texture = texture;
+    glm_mat4_copy(model, packet->model);
+    glm_vec4_copy(color, packet->color);
+
+    queue->keys[queue->count] = render_queue_key(queue, pass, program, texture, depth);
+    queue->order[queue->count] = (u32)queue->count;
+    queue->count++;
+    queue->sorted = false;
+}
+
+// LSD radix sort over the 8 key bytes, stable, so equal keys keep submission order
+// Bytes that are the same for every key are skipped
+void render_queue_sort(render_queue_t* queue) {
+    usize histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    for (usize i = 0; i < queue->count; i++) {
+        u64 key = queue->keys[i];
+        for (u32 byte = 0; byte < 8; byte++) {
+            histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+        }
+    }
+
+    u64* keys = queue->keys;
+    u32* order = queue->order;
+    u64* sort_keys = queue->sort_keys;
+    u32* sort_order = queue->sort_order;
+
+    for (u32 byte = 0; byte < 8; byte++) {
+        usize* histogram = histograms[byte];
+
+        if (queue->count == 0 || histogram[(keys[0] >> (byte * 8)) & 0xFF] == queue->count) {
+            continue;
+        }
+
+        usize offset = 0;
+        for (u32 bucket = 0; bucket < 256; bucket++) {
+            usize bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+
+        for (usize i = 0; i < queue->count; i++) {
+            usize destination = histogram[(keys[i] >> (byte * 8)) & 0xFF]++;
+            sort_keys[destination] = keys[i];
+            sort_order[destination] = order[i];
+        }
+
+        u64* tmp_keys = keys;
+        keys = sort_keys;
+        sort_keys = tmp_keys;
+
+        u32* tmp_order = order;
+        order = sort_order;
+        sort_order = tmp_order;
+    }
+
+    queue->keys = keys;
+    queue->order = order;
+    queue->sort_keys = sort_keys;
+    queue->sort_order = sort_order;
+    queue->sorted = true;
+}
+
+static void render_pass_begin(render_pass_t* pass, uniform_buffers_t* uniforms) {
+    gl_state_bind_framebuffer(pass->framebuffer);
+    gl_state_viewport(
+        pass->viewport[0],
+        pass->viewport[1],
+        pass->viewport[2],
+        pass->viewport[3]
+    );
+    gl_state_set_depth_test(pass->depth_test);
+    gl_state_set_cull_face(pass->cull_face);
+    gl_state_set_blend(pass->blend);
+
+    if (pass->clear) {
+        if (pass->clear & GL_COLOR_BUFFER_BIT) {
+            glClearColor(
+                pass->clear_color[0],
+                pass->clear_color[1],
+                pass->clear_color[2],
+                pass->clear_color[3]
+            );
+        }
+        glClear(pass->clear);
+    }
+
+    for (u32 i = 0; i < RENDER_PASS_MAX_TEXTURES; i++) {
+        if (pass->textures[i].id) {
+            gl_state_bind_texture(i + 1, pass->textures[i].target, pass->textures[i].id);
+        }
+    }
+
+    uniforms->pass = pass->uniforms;
+    uniforms_upload_pass(uniforms);
+}
+
+void render_queue_execute(render_queue_t* queue, uniform_buffers_t* uniforms) {
+    if (!queue->sorted) {
+        render_queue_sort(queue);
+    }
+
+    queue->stats = (render_queue_stats_t){ .packets = (u32)queue->count };
+
+    uniforms->frame = queue->frame;
+    uniforms_upload_frame(uniforms);
+
+    usize cursor = 0;
+
+    for (u32 pass_id = 0; pass_id < RENDER_PASS_COUNT; pass_id++) {
+        render_pass_t* pass = &queue->passes[pass_id];
+
+        if (!pass->active) {
+            while (cursor < queue->count && RENDER_KEY_PASS(queue->keys[cursor]) == pass_id) {
+                cursor++;
+            }
+            continue;
+        }
+
+        f64 pass_start = time_now_ms();
+        gpu_timer_begin(pass_id);
+
+        render_pass_begin(pass, uniforms);
+        queue->stats.passes++;
+
+        GLuint program = 0;
+        GLuint texture = 0;
+        GLint model_location = -1;
+        GLint color_location = -1;
+        const f32* color = NULL;
+
+        for (; cursor < queue->count && RENDER_KEY_PASS(queue->keys[cursor]) == pass_id;
+             cursor++) {
+            render_packet_t* packet = &queue->packets[queue->order[cursor]];
+
+            if (packet->program != program) {
+                program = packet->program;
+                gl_state_use_program(program);
+                model_location = glGetUniformLocation(program, "u_model");
+                color_location = glGetUniformLocation(program, "u_color");
+                color = NULL;
+                queue->stats.program_changes++;
+            }
+
+            if (packet->texture && packet->texture != texture) {
+                texture = packet->texture;
+                gl_state_bind_texture(0, GL_TEXTURE_2D, texture);
+                queue->stats.texture_changes++;
+            }
+
+            glUniformMatrix4fv(model_location, 1, GL_FALSE, (f32*)packet->model);
+
+            if (!color || memcmp(color, packet->color, sizeof(vec4)) != 0) {
+                glUniform4fv(color_location, 1, packet->color);
+                color = packet->color;
+            }
+
+            mesh_draw(packet->mesh);
+        }
+
+        gpu_timer_end(pass_id);
+        queue->stats.pass_ms[pass_id] = time_now_ms() - pass_start;
+    }
+}
+
+void render_queue_copy(render_queue_t* dst, const render_queue_t* src) {
+    render_queue_reserve(dst, src->count);
+
+    memcpy(dst->packets, src->packets, sizeof(render_packet_t) * src->count);
+    memcpy(dst->keys, src->keys, sizeof(u64) * src->count);
+    memcpy(dst->order, src->order, sizeof(u32) * src->count);
+    dst->count = src->count;
+    dst->sorted = src->sorted;
+
+    dst->frame = src->frame;
+    memcpy(dst->passes, src->passes, sizeof(src->passes));
+    dst->stats = src->stats;
+    dst->generation = g_render_resource_generation;
+}
+
+bool render_queue_stale(const render_queue_t* queue) {
+    return queue->generation != g_render_resource_generation;
+}
+
+void render_queue_dump(render_queue_t* queue, FILE* file) {
+    if (!queue->sorted) {
+        render_queue_sort(queue);
+    }
+
+    fprintf(file, "Render queue: %zu packets\n", queue->count);
+
+    for (usize i = 0; i < queue->count; i++) {
+        render_packet_t* packet = &queue->packets[queue->order[i]];
+
+        fprintf(
+            file,
+            "%5zu key=%016" PRIx64 " pass=%u program=%u texture=%u mesh=%p indices=%d"
+            " pos=(%.1f %.1f %.1f)\n",
+            i,
+            queue->keys[i],
+            RENDER_KEY_PASS(queue->keys[i]),
+            packet->program,
+            packet->texture,
+            (void*)packet->mesh,
+            packet->mesh->index_count,
+            packet->model[3][0],
+            packet->model[3][1],
+            packet->model[3][2]
+        );
+    }
+}
@@ -1,7 +1,13 @@
+// fileno, for syncing files before they replace others
+#define _POSIX_C_SOURCE 200809L
+
 #include "saves.h"
+#include "compress.h"
 #include "config.h"
+#include "job.h"
 #include "log.h"
 #include "types.h"
+#include "utils.h"
 #include "world.h"
 
 #include <stddef.h>
@@ -9,118 +15,478 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define SAVE_INITIAL_CHUNK_CAPACITY 64
+#define SAVE_INITIAL_INDEX_CAPACITY 128
+#define SAVE_PATH_MAX 512
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define save_mkdir(path) _mkdir(path)
+#define save_rmdir(path) _rmdir(path)
+#define save_fsync(file) _commit(_fileno(file))
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define save_mkdir(path) mkdir(path, 0755)
+#define save_rmdir(path) rmdir(path)
+#define save_fsync(file) fsync(fileno(file))
+#endif
+
+// Flush a file written through a temporary path all the way to disk and close it, so the
+// rename replacing the original can't land before its contents
+static bool save_sync_close(FILE* file) {
+    bool synced = fflush(file) == 0 && save_fsync(file) == 0;
+    return fclose(file) == 0 && synced;
+}
+
+// Atomic on POSIX, Windows' rename can't replace files so there's a moment without either
+static bool save_replace(const char* temp_path, const char* path) {
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(temp_path, path) == 0;
+}
+
 save_t* g_save;
 
+const char* save_encoding_names[SAVE_ENCODING_COUNT] = {
+    "raw",
+    "rle",
+    "lz",
+    "best",
+};
+
 save_t* save_new() {
     save_t* save = malloc(sizeof(save_t));
+    memset(save, 0, sizeof(save_t));
 
     memcpy(&save->header.magic, SAVE_MAGIC_STR, 4);
     save->header.save_format_version = SAVE_FORMAT_VERSION;
+    save->encoding = SAVE_ENCODING_DEFAULT;
+    save->delta = true;
+    save->world.generator_version = WORLD_GENERATOR_VERSION;
+    // new worlds get their own terrain
+    f64 now = time_now_ms();
+    save->world.seed = hash_fnv1a(&now, sizeof(f64), HASH_FNV1A_SEED);
 
-    save->world.seed = 0;
-    save->world.chunk_count = 0;
-    save->world.chunks = NULL;
+    mutex_init(&save->region_mutex);
 
     return save;
 }
 
+static void save_set_path(save_t* save, const char* path) {
+    usize length = strlen(path);
+    free(save->path);
+    save->path = malloc(length + 1);
+    memcpy(save->path, path, length + 1);
+}
+
+static void save_region_path(const char* save_path, save_region_t* region, char* out) {
+    snprintf(
+        out,
+        SAVE_PATH_MAX,
+        "%s" SAVE_REGION_DIRECTORY_SUFFIX "/r.%d.%d.%d.cgrg",
+        save_path,
+        region->x,
+        region->y,
+        region->z
+    );
+}
+
+static save_region_t* save_region_find(save_t* save, i32 x, i32 y, i32 z) {
+    for (u32 i = 0; i < save->region_count; i++) {
+        save_region_t* region = &save->regions[i];
+        if (region->x == x && region->y == y && region->z == z) {
+            return region;
+        }
+    }
+
+    return NULL;
+}
+
+static save_region_t* save_region_add(save_t* save, i32 x, i32 y, i32 z) {
+    if (save->region_count == save->region_capacity) {
+        save->region_capacity = save->region_capacity ? save->region_capacity * 2 : 16;
+        save->regions = realloc(save->regions, sizeof(save_region_t) * save->region_capacity);
+    }
+
+    save_region_t* region = &save->regions[save->region_count++];
+    memset(region, 0, sizeof(save_region_t));
+    region->x = x;
+    region->y = y;
+    region->z = z;
+    // a region not in the save's table has nothing on disk, even if an old file is there
+    region->opened = true;
+
+    return region;
+}
+
+static void save_region_close(save_region_t* region) {
+    file_map_close(&region->map);
+    region->opened = false;
+}
+
+// Map the region on first use, NULL if it has no readable file
+// region_mutex must be held
+static const save_region_header_t* save_region_open(save_t* save, save_region_t* region) {
+    if (!region->opened) {
+        region->opened = true;
+
+        char path[SAVE_PATH_MAX];
+        save_region_path(save->path, region, path);
+
+        if (file_map_open(&region->map, path)) {
+            const save_region_header_t* header = (const save_region_header_t*)region->map.data;
+            bool valid = region->map.size >= sizeof(save_region_header_t) &&
+                         memcmp(&header->magic, SAVE_REGION_MAGIC_STR, 4) == 0 &&
+                         (header->format_version == SAVE_FORMAT_VERSION ||
+                          header->format_version == SAVE_FORMAT_VERSION_V4 ||
+                          header->format_version == SAVE_FORMAT_VERSION_V3);
+
+            for (u32 i = 0; valid && i < SAVE_REGION_CHUNKS; i++) {
+                const save_region_entry_t* entry = &header->entries[i];
+                bool raw = entry->encoding == COMPRESS_RAW;
+                bool delta = entry->encoding == SAVE_CHUNK_DELTA;
+                valid = !entry->offset ||
+                        ((usize)entry->offset + entry->size <= region->map.size &&
+                         entry->encoding <= SAVE_CHUNK_DELTA &&
+                         (!raw || entry->size == CHUNK_BLOCK_COUNT) &&
+                         (!delta || entry->size >= sizeof(u16)));
+            }
+
+            if (!valid) {
+                LOG_ERROR("Region %s is corrupt, its chunks will be regenerated\n", path);
+                file_map_close(&region->map);
+            }
+        }
+    }
+
+    return region->map.data ? (const save_region_header_t*)region->map.data : NULL;
+}
+
+// Region containing a chunk, and the chunk's slot in it
+static void save_chunk_region(ivec3 position, ivec3 region, u32* slot) {
+    ivec3 local;
+    for (u32 i = 0; i < 3; i++) {
+        local[i] = posmod(position[i], SAVE_REGION_SIZE);
+        region[i] = (position[i] - local[i]) / SAVE_REGION_SIZE;
+    }
+
+    *slot = (u32)(local[0] + local[1] * SAVE_REGION_SIZE +
+                  local[2] * SAVE_REGION_SIZE * SAVE_REGION_SIZE);
+}
+
+static bool save_load_regions(save_t* save, FILE* file, u32 format_version) {
+    u32 region_count;
+    u32 generator_version;
+    if (!fread(&save->world.seed, sizeof(u64), 1, file) ||
+        !fread(&region_count, sizeof(u32), 1, file) ||
+        !fread(&generator_version, sizeof(u32), 1, file)) {
+        return false;
+    }
+
+    // older versions have no deltas, and padding in place of the generator version
+    if (format_version == SAVE_FORMAT_VERSION) {
+        save->world.generator_version = generator_version;
+    }
+
+    if (save->world.generator_version != WORLD_GENERATOR_VERSION) {
+        // the saved deltas are replayed on the current terrain, don't mix in new ones
+        LOG_WARNING(
+            "Save was made with world generator %u, edited chunks may not match the terrain "
+            "around them\n",
+            save->world.generator_version
+        );
+        save->delta = false;
+    }
+
+    for (u32 i = 0; i < region_count; i++) {
+        save_index_entry_t entry;
+        if (!fread(&entry, sizeof(save_index_entry_t), 1, file)) {
+            return false;
+        }
+        // mapped on first use by save_region_open
+        save_region_add(save, entry.x, entry.y, entry.z)->opened = false;
+    }
+
+    return true;
+}
+
 save_t* save_load(const char* path) {
     FILE* file = fopen(path, "rb");
     if (!file) {
         return NULL;
     }
 
-    save_t* save = malloc(sizeof(save_t));
-
     save_header_t header;
-    fread(&header, sizeof(save_header_t), 1, file);
-
-    if (memcmp(&header.magic, SAVE_MAGIC_STR, 4) != 0) {
+    if (!fread(&header, sizeof(save_header_t), 1, file) ||
+        memcmp(&header.magic, SAVE_MAGIC_STR, 4) != 0) {
         fclose(file);
         return NULL;
     }
 
-    if (header.save_format_version != SAVE_FORMAT_VERSION) {
-        fclose(file);
-        return NULL;
-    }
+    save_t* save = save_new();
 
-    save->header = header;
+    bool result = false;
+    // version 3 and 4 regions are current ones without some of the encodings
+    bool regions = header.save_format_version == SAVE_FORMAT_VERSION ||
+                   header.save_format_version == SAVE_FORMAT_VERSION_V4 ||
+                   header.save_format_version == SAVE_FORMAT_VERSION_V3;
+
+    if (regions) {
+        result = save_load_regions(save, file, header.save_format_version);
+    } else if (header.save_format_version == SAVE_FORMAT_VERSION_V2) {
+        result = save_read_world_v2(file, &save->world);
+    } else if (header.save_format_version == SAVE_FORMAT_VERSION_V1) {
+        result = save_read_world_v1(file, &save->world);
+    }
 
-    bool result = save_read_world(file, &save->world);
+    fclose(file);
 
     if (!result) {
-        fclose(file);
-        free(save);
+        save_free(save);
         return NULL;
     }
 
-    fclose(file);
+    if (!regions) {
+        // the chunks are all in memory, as changed ones
+        save->convert_version = header.save_format_version;
+        return save;
+    }
+
+    save_set_path(save, path);
+    LOG_INFO("Save %s has %u regions\n", path, save->region_count);
 
     return save;
 }
 
+bool save_convert(save_t* save, const char* path) {
+    if (!save->convert_version) {
+        return true;
+    }
+
+    char backup_path[SAVE_PATH_MAX];
+    snprintf(backup_path, sizeof(backup_path), "%s.bak", path);
+
+    LOG_INFO(
+        "Converting version %u save %s to regions, the original is kept as %s\n",
+        save->convert_version,
+        path,
+        backup_path
+    );
+
+    remove(backup_path);
+    if (rename(path, backup_path) != 0) {
+        LOG_ERROR("Failed to back up %s, not converting it\n", path);
+        return false;
+    }
+
+    save->convert_version = 0;
+    save_write(save, path);
+    return true;
+}
+
+bool save_start(save_t* save, const char* path, bool replay) {
+    world_generator_init(save->world.seed);
+
+    if (!save_convert(save, path)) {
+        return false;
+    }
+
+    save_journal_open(save, path, replay);
+    return true;
+}
+
 void save_free(save_t* save) {
-    if (save->world.chunks != NULL) {
-        free(save->world.chunks);
+    save_compact_wait(save);
+
+    for (u32 i = 0; i < save->region_count; i++) {
+        save_region_close(&save->regions[i]);
     }
 
+    if (save->journal) {
+        save_journal_wait(save);
+        fclose(save->journal);
+    }
+
+    mutex_free(&save->region_mutex);
+    free(save->regions);
+    free(save->path);
+    free(save->journal_save_path);
+    free(save->journal_batch.chunks);
+    free(save->world.chunks);
+    free(save->world.index);
+    free(save->compaction.world.chunks);
+    free(save->compaction.world.index);
     free(save);
 }
 
-void save_write(const save_t* save, const char* path) {
-    FILE* file = fopen(path, "wb");
+static u64 save_file_size(const char* path) {
+    FILE* file = fopen(path, "rb");
     if (!file) {
-        return;
+        return 0;
     }
 
-    fwrite(&save->header, sizeof(save_header_t), 1, file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
 
-    save_write_world(&save->world, file);
+    return size > 0 ? (u64)size : 0;
+}
 
-    fclose(file);
+u64 save_remove(save_t* save, const char* path) {
+    save_compact_wait(save);
+
+    u64 size = save_file_size(path);
+
+    for (u32 i = 0; i < save->region_count; i++) {
+        char region_path[SAVE_PATH_MAX];
+        save_region_path(path, &save->regions[i], region_path);
+        save_region_close(&save->regions[i]);
+
+        size += save_file_size(region_path);
+        remove(region_path);
+    }
+
+    char directory[SAVE_PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s" SAVE_REGION_DIRECTORY_SUFFIX, path);
+    save_rmdir(directory);
+    remove(path);
+
+    return size;
+}
 
-    return;
+static u32 save_hash_position(i32 x, i32 y, i32 z) {
+    u64 hash = (u64)(u32)x * 0x9E3779B97F4A7C15ull;
+    hash ^= (u64)(u32)y * 0xC2B2AE3D27D4EB4Full;
+    hash ^= (u64)(u32)z * 0x165667B19E3779F9ull;
+    return (u32)(hash ^ (hash >> 32));
 }
 
-void save_write_world(const world_save_t* world, FILE* file) {
-    fwrite(&world->seed, sizeof(u64), 1, file);
-    fwrite(&world->chunk_count, sizeof(u32), 1, file);
+static void save_index_insert(world_save_t* world, u32 chunk) {
+    world_save_chunk_t* save_chunk = &world->chunks[chunk];
+    u32 mask = world->index_capacity - 1;
+    u32 slot = save_hash_position(save_chunk->x, save_chunk->y, save_chunk->z) & mask;
 
-    for (size_t i = 0; i < world->chunk_count; i++) {
-        save_write_chunk(&world->chunks[i], file);
+    while (world->index[slot]) {
+        slot = (slot + 1) & mask;
     }
+
+    world->index[slot] = chunk + 1;
 }
 
-void save_write_chunk(const world_save_chunk_t* chunk, FILE* file) {
-    fwrite(&chunk->x, sizeof(i32), 1, file);
-    fwrite(&chunk->y, sizeof(i32), 1, file);
-    fwrite(&chunk->z, sizeof(i32), 1, file);
+static void save_index_rebuild(world_save_t* world, u32 capacity) {
+    free(world->index);
+    world->index = calloc(capacity, sizeof(u32));
+    world->index_capacity = capacity;
 
-    fwrite(
-        &chunk->block_data,
-        sizeof(block_id_t),
-        CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE,
-        file
-    );
+    for (u32 i = 0; i < world->chunk_count; i++) {
+        save_index_insert(world, i);
+    }
+}
+
+// Room for chunk_count chunks, in the array and in the index
+static void save_reserve(world_save_t* world, u32 chunk_count) {
+    if (chunk_count > world->chunk_capacity) {
+        u32 capacity =
+            world->chunk_capacity ? world->chunk_capacity : SAVE_INITIAL_CHUNK_CAPACITY;
+        while (capacity < chunk_count) {
+            capacity *= 2;
+        }
+
+        world->chunks = realloc(world->chunks, sizeof(world_save_chunk_t) * capacity);
+        world->chunk_capacity = capacity;
+    }
+
+    if (chunk_count * 2 > world->index_capacity) {
+        u32 capacity =
+            world->index_capacity ? world->index_capacity : SAVE_INITIAL_INDEX_CAPACITY;
+        while (capacity < chunk_count * 2) {
+            capacity *= 2;
+        }
+
+        save_index_rebuild(world, capacity);
+    }
+}
+
+world_save_chunk_t* save_find_chunk(const world_save_t* world, ivec3 position) {
+    if (!world->index_capacity) {
+        return NULL;
+    }
+
+    u32 mask = world->index_capacity - 1;
+    u32 slot = save_hash_position(position[0], position[1], position[2]) & mask;
+
+    while (world->index[slot]) {
+        world_save_chunk_t* chunk = &world->chunks[world->index[slot] - 1];
+        if (chunk->x == position[0] && chunk->y == position[1] && chunk->z == position[2]) {
+            return chunk;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return NULL;
 }
 
-bool save_read_world(FILE* file, world_save_t* world) {
+bool save_read_world_v2(FILE* file, world_save_t* world) {
+    u32 pad;
+    if (!fread(&world->seed, sizeof(u64), 1, file) ||
+        !fread(&world->chunk_count, sizeof(u32), 1, file) ||
+        !fread(&pad, sizeof(u32), 1, file)) {
+        return false;
+    }
+
+    u32 chunk_count = world->chunk_count;
+    world->chunk_count = 0;
+    save_reserve(world, chunk_count);
+
+    save_index_entry_t* entries = malloc(sizeof(save_index_entry_t) * chunk_count);
+    if (fread(entries, sizeof(save_index_entry_t), chunk_count, file) != chunk_count) {
+        free(entries);
+        return false;
+    }
+
+    for (u32 i = 0; i < chunk_count; i++) {
+        world_save_chunk_t* chunk = &world->chunks[i];
+        chunk->x = entries[i].x;
+        chunk->y = entries[i].y;
+        chunk->z = entries[i].z;
+
+        if (fread(chunk->block_data, sizeof(block_id_t), CHUNK_BLOCK_COUNT, file) !=
+            CHUNK_BLOCK_COUNT) {
+            free(entries);
+            return false;
+        }
+
+        world->chunk_count++;
+        save_index_insert(world, i);
+    }
+
+    free(entries);
+
+    return true;
+}
+
+bool save_read_world_v1(FILE* file, world_save_t* world) {
     if (!fread(&world->seed, sizeof(u64), 1, file)) {
         return false;
     }
 
-    if (!fread(&world->chunk_count, sizeof(u32), 1, file)) {
+    u32 chunk_count;
+    if (!fread(&chunk_count, sizeof(u32), 1, file)) {
         return false;
     }
 
-    world->chunks = malloc(sizeof(world_save_chunk_t) * world->chunk_count);
+    save_reserve(world, chunk_count);
 
-    for (size_t i = 0; i < world->chunk_count; i++) {
+    for (u32 i = 0; i < chunk_count; i++) {
         if (!save_read_chunk(file, &world->chunks[i])) {
-            free(world->chunks);
             return false;
         }
+
+        world->chunk_count++;
+        save_index_insert(world, i);
     }
 
     return true;
@@ -151,49 +517,1043 @@ bool save_read_chunk(FILE* file, world_save_chunk_t* chunk) {
     return true;
 }
 
+// Smallest encoding allowed by the setting, raw when nothing beats it
+static save_region_entry_t save_encode_chunk(
+    save_encoding_t setting,
+    const block_id_t* blocks,
+    u8 encoded[CHUNK_BLOCK_COUNT]
+) {
+    save_region_entry_t entry = { .size = CHUNK_BLOCK_COUNT, .encoding = COMPRESS_RAW };
+
+    u8 candidate[CHUNK_BLOCK_COUNT];
+    for (u32 encoding = COMPRESS_RLE; encoding < COMPRESS_ENCODING_COUNT; encoding++) {
+        if (setting != SAVE_ENCODING_BEST && setting != (save_encoding_t)encoding) {
+            continue;
+        }
+
+        // only worth it if it's smaller than raw
+        usize size = compress_encode(
+            (compress_encoding_t)encoding,
+            blocks,
+            CHUNK_BLOCK_COUNT,
+            candidate,
+            entry.size - 1
+        );
+
+        if (size) {
+            memcpy(encoded, candidate, size);
+            entry.size = (u16)size;
+            entry.encoding = (u8)encoding;
+        }
+    }
+
+    return entry;
+}
+
+// Edits of a chunk to what the generator makes of its position, SAVE_CHUNK_DELTA encoded
+// 0 if there are more than SAVE_DELTA_MAX_EDITS or it takes capacity bytes or more
+static usize save_encode_delta(
+    ivec3 position,
+    const block_id_t* blocks,
+    u8 encoded[CHUNK_BLOCK_COUNT],
+    usize capacity
+) {
+    block_id_t generated[CHUNK_BLOCK_COUNT];
+    chunk_generate_blocks(position, NULL, generated);
+
+    u16 edits[SAVE_DELTA_MAX_EDITS];
+    u32 edit_count = 0;
+    for (u32 i = 0; i < CHUNK_BLOCK_COUNT; i++) {
+        if (blocks[i] != generated[i]) {
+            if (edit_count == SAVE_DELTA_MAX_EDITS) {
+                return 0;
+            }
+            edits[edit_count++] = (u16)i;
+        }
+    }
+
+    usize size = edit_count <= SAVE_DELTA_LIST_MAX ? sizeof(u16) + edit_count * 3
+                                                   : sizeof(u16) + CHUNK_BLOCK_COUNT / 8 +
+                                                         edit_count;
+    if (size >= capacity) {
+        return 0;
+    }
+
+    u16 count = (u16)edit_count;
+    memcpy(encoded, &count, sizeof(u16));
+    u8* out = encoded + sizeof(u16);
+
+    if (edit_count <= SAVE_DELTA_LIST_MAX) {
+        for (u32 i = 0; i < edit_count; i++) {
+            *out++ = (u8)(edits[i] & 0xFF);
+            *out++ = (u8)(edits[i] >> 8);
+            *out++ = blocks[edits[i]];
+        }
+    } else {
+        u8* bitmap = out;
+        memset(bitmap, 0, CHUNK_BLOCK_COUNT / 8);
+        out += CHUNK_BLOCK_COUNT / 8;
+
+        for (u32 i = 0; i < edit_count; i++) {
+            bitmap[edits[i] / 8] |= (u8)(1 << (edits[i] % 8));
+            *out++ = blocks[edits[i]];
+        }
+    }
+
+    return size;
+}
+
+// Regenerate a SAVE_CHUNK_DELTA chunk into blocks, false if the delta is corrupt
+static bool save_decode_delta(
+    ivec3 position,
+    const u8* data,
+    usize size,
+    block_id_t blocks[CHUNK_BLOCK_COUNT]
+) {
+    u16 edit_count;
+    memcpy(&edit_count, data, sizeof(u16));
+    data += sizeof(u16);
+
+    if (edit_count <= SAVE_DELTA_LIST_MAX) {
+        if (size != sizeof(u16) + (usize)edit_count * 3) {
+            return false;
+        }
+
+        chunk_generate_blocks(position, NULL, blocks);
+        for (u32 i = 0; i < edit_count; i++, data += 3) {
+            u32 index = (u32)data[0] | (u32)data[1] << 8;
+            if (index >= CHUNK_BLOCK_COUNT) {
+                return false;
+            }
+            blocks[index] = data[2];
+        }
+
+        return true;
+    }
+
+    if (size != sizeof(u16) + CHUNK_BLOCK_COUNT / 8 + (usize)edit_count) {
+        return false;
+    }
+
+    chunk_generate_blocks(position, NULL, blocks);
+    const u8* bitmap = data;
+    const u8* ids = data + CHUNK_BLOCK_COUNT / 8;
+    u32 edit = 0;
+    for (u32 i = 0; i < CHUNK_BLOCK_COUNT; i++) {
+        if (bitmap[i / 8] & (1 << (i % 8))) {
+            if (edit == edit_count) {
+                return false;
+            }
+            blocks[i] = ids[edit++];
+        }
+    }
+
+    return edit == edit_count;
+}
+
+// Encode a changed chunk the way the save is set up to, data points at the chunk's blocks
+// or at encoded
+static save_region_entry_t save_encode_changed(
+    save_t* save,
+    const world_save_chunk_t* chunk,
+    u8 encoded[CHUNK_BLOCK_COUNT],
+    const u8** data
+) {
+    u8 candidate[CHUNK_BLOCK_COUNT];
+    save_region_entry_t entry = save_encode_chunk(save->encoding, chunk->block_data, candidate);
+
+    // edited generated chunks, unless the edits take more than the whole chunk
+    usize delta_size = 0;
+    if (save->delta) {
+        ivec3 position = { chunk->x, chunk->y, chunk->z };
+        delta_size = save_encode_delta(position, chunk->block_data, encoded, entry.size);
+    }
+
+    if (delta_size) {
+        entry.size = (u16)delta_size;
+        entry.encoding = SAVE_CHUNK_DELTA;
+        *data = encoded;
+    } else if (entry.encoding == COMPRESS_RAW) {
+        *data = chunk->block_data;
+    } else {
+        memcpy(encoded, candidate, entry.size);
+        *data = encoded;
+    }
+
+    return entry;
+}
+
+// Block ids of a chunk encoded as a region entry, false if the data is corrupt
+static bool save_decode_chunk(
+    ivec3 position,
+    u8 encoding,
+    const u8* data,
+    usize size,
+    block_id_t blocks[CHUNK_BLOCK_COUNT]
+) {
+    if (encoding == SAVE_CHUNK_DELTA) {
+        return size >= sizeof(u16) && save_decode_delta(position, data, size, blocks);
+    }
+
+    if (encoding >= COMPRESS_ENCODING_COUNT) {
+        return false;
+    }
+
+    return compress_decode(
+        (compress_encoding_t)encoding,
+        data,
+        size,
+        blocks,
+        CHUNK_BLOCK_COUNT
+    );
+}
+
+// Write a region from the compaction's chunks and whatever its current file has, to a
+// temporary file next to the region of path. save_compact_finish puts it in place.
+static bool save_region_write(save_t* save, save_region_t* region, const char* path) {
+    mutex_lock(&save->region_mutex);
+    const save_region_header_t* old_header =
+        save->path ? save_region_open(save, region) : NULL;
+    mutex_unlock(&save->region_mutex);
+
+    char region_path[SAVE_PATH_MAX];
+    char temp_path[SAVE_PATH_MAX + 4];
+    save_region_path(path, region, region_path);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", region_path);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        LOG_ERROR("Failed to write region %s\n", temp_path);
+        return false;
+    }
+
+    save_region_header_t* header = calloc(1, sizeof(save_region_header_t));
+    memcpy(&header->magic, SAVE_REGION_MAGIC_STR, 4);
+    header->format_version = SAVE_FORMAT_VERSION;
+    header->x = region->x;
+    header->y = region->y;
+    header->z = region->z;
+
+    // the table is filled in as chunks are written and goes in last
+    bool written = fwrite(header, sizeof(save_region_header_t), 1, file) == 1;
+    u32 offset = sizeof(save_region_header_t);
+
+    u8 encoded[CHUNK_BLOCK_COUNT];
+
+    for (u32 slot = 0; written && slot < SAVE_REGION_CHUNKS; slot++) {
+        ivec3 position = {
+            region->x * SAVE_REGION_SIZE + (i32)(slot % SAVE_REGION_SIZE),
+            region->y * SAVE_REGION_SIZE + (i32)(slot / SAVE_REGION_SIZE % SAVE_REGION_SIZE),
+            region->z * SAVE_REGION_SIZE + (i32)(slot / (SAVE_REGION_SIZE * SAVE_REGION_SIZE)),
+        };
+
+        save_region_entry_t entry = { 0 };
+        const u8* data = NULL;
+
+        world_save_chunk_t* changed = save_find_chunk(&save->compaction.world, position);
+        if (changed) {
+            entry = save_encode_changed(save, changed, encoded, &data);
+        } else if (old_header && old_header->entries[slot].offset) {
+            // unchanged chunks keep their encoding
+            entry = old_header->entries[slot];
+            data = region->map.data + entry.offset;
+        }
+
+        if (!data) {
+            continue;
+        }
+
+        written = fwrite(data, 1, entry.size, file) == entry.size;
+        entry.offset = offset;
+        header->entries[slot] = entry;
+        header->chunk_count++;
+        offset += entry.size;
+    }
+
+    written = written && fseek(file, 0, SEEK_SET) == 0 &&
+              fwrite(header, sizeof(save_region_header_t), 1, file) == 1;
+    written = save_sync_close(file) && written;
+    free(header);
+
+    if (!written) {
+        LOG_ERROR("Failed to write region %s\n", temp_path);
+        remove(temp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static void save_region_write_job(void* arg) {
+    save_region_job_t* job = arg;
+    save_t* save = job->save;
+    job->ok = save_region_write(save, &save->regions[job->region], save->compaction.path);
+}
+
+static void save_journal_path(const char* save_path, char* out) {
+    snprintf(out, SAVE_PATH_MAX, "%s" SAVE_JOURNAL_SUFFIX, save_path);
+}
+
+static u64 save_journal_checksum(const save_journal_record_t* record, const u8* data) {
+    u64 hash = hash_fnv1a(record, offsetof(save_journal_record_t, checksum), HASH_FNV1A_SEED);
+    return hash_fnv1a(data, record->size, hash);
+}
+
+// Append a changed chunk to the journal, the caller syncs it
+static bool save_journal_append(save_t* save, world_save_chunk_t* chunk) {
+    u8 encoded[CHUNK_BLOCK_COUNT];
+    const u8* data;
+    save_region_entry_t entry = save_encode_changed(save, chunk, encoded, &data);
+
+    save_journal_record_t record = {
+        .x = chunk->x,
+        .y = chunk->y,
+        .z = chunk->z,
+        .size = entry.size,
+        .encoding = entry.encoding,
+    };
+    record.checksum = save_journal_checksum(&record, data);
+
+    chunk->journal_pending = false;
+    save->journal_size += sizeof(save_journal_record_t) + entry.size;
+
+    return fwrite(&record, sizeof(save_journal_record_t), 1, save->journal) == 1 &&
+           fwrite(data, 1, entry.size, save->journal) == entry.size;
+}
+
+// Start the journal over with the chunks that aren't in the regions yet, through a temporary
+// file so the old one stays valid until the new one is on disk
+static void save_journal_reset(save_t* save) {
+    char path[SAVE_PATH_MAX];
+    char temp_path[SAVE_PATH_MAX + 4];
+    save_journal_path(save->journal_save_path, path);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    if (save->journal) {
+        fclose(save->journal);
+        save->journal = NULL;
+    }
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        LOG_ERROR("Failed to write journal %s, edits are only saved on exit\n", temp_path);
+        return;
+    }
+
+    save_header_t header = { .save_format_version = SAVE_FORMAT_VERSION };
+    memcpy(&header.magic, SAVE_JOURNAL_MAGIC_STR, 4);
+    bool written = fwrite(&header, sizeof(save_header_t), 1, file) == 1;
+
+    save->journal = file;
+    save->journal_size = sizeof(save_header_t);
+    for (u32 i = 0; written && i < save->world.chunk_count; i++) {
+        written = save_journal_append(save, &save->world.chunks[i]);
+    }
+    save->journal = NULL;
+
+    written = save_sync_close(file) && written;
+    if (!written || !save_replace(temp_path, path)) {
+        LOG_ERROR("Failed to write journal %s, edits are only saved on exit\n", temp_path);
+        remove(temp_path);
+        return;
+    }
+
+    save->journal = fopen(path, "ab");
+}
+
+// Slot of a changed chunk, added if the save doesn't have one for position yet
+static world_save_chunk_t* save_put_chunk(save_t* save, ivec3 position) {
+    world_save_t* world = &save->world;
+    world_save_chunk_t* world_chunk = save_find_chunk(world, position);
+
+    if (!world_chunk) {
+        save_reserve(world, world->chunk_count + 1);
+
+        u32 index = world->chunk_count++;
+        world_chunk = &world->chunks[index];
+
+        world_chunk->x = position[0];
+        world_chunk->y = position[1];
+        world_chunk->z = position[2];
+        world_chunk->journal_pending = false;
+
+        save_index_insert(world, index);
+    }
+
+    return world_chunk;
+}
+
+static void save_world_clear(world_save_t* world) {
+    world->chunk_count = 0;
+    if (world->index) {
+        memset(world->index, 0, sizeof(u32) * world->index_capacity);
+    }
+}
+
+// The save file itself: seed, generator version and the list of regions
+static bool save_write_file(save_t* save, const char* path) {
+    char temp_path[SAVE_PATH_MAX + 4];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        LOG_ERROR("Failed to write save %s\n", temp_path);
+        return false;
+    }
+
+    save_header_t header = save->header;
+    header.save_format_version = SAVE_FORMAT_VERSION;
+    fwrite(&header, sizeof(save_header_t), 1, file);
+    fwrite(&save->world.seed, sizeof(u64), 1, file);
+    fwrite(&save->region_count, sizeof(u32), 1, file);
+    fwrite(&save->world.generator_version, sizeof(u32), 1, file);
+
+    for (u32 i = 0; i < save->region_count; i++) {
+        save_region_t* region = &save->regions[i];
+        save_index_entry_t entry = { .x = region->x, .y = region->y, .z = region->z };
+        fwrite(&entry, sizeof(save_index_entry_t), 1, file);
+    }
+
+    if (!save_sync_close(file)) {
+        LOG_ERROR("Failed to write save %s\n", temp_path);
+        remove(temp_path);
+        return false;
+    }
+
+    if (!save_replace(temp_path, path)) {
+        LOG_ERROR("Failed to replace save %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+// Move the changed chunks into a compaction and start writing their regions to path
+static void save_compact_begin(save_t* save, const char* path) {
+    save_compaction_t* compaction = &save->compaction;
+
+    char directory[SAVE_PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s" SAVE_REGION_DIRECTORY_SUFFIX, path);
+    save_mkdir(directory);
+
+    bool moving = !save->path || strcmp(save->path, path) != 0;
+
+    // the save goes on with the emptied arrays of the last compaction
+    world_save_t changed = save->world;
+    save->world = compaction->world;
+    save->world.seed = changed.seed;
+    save->world.generator_version = changed.generator_version;
+    compaction->world = changed;
+
+    usize length = strlen(path);
+    compaction->path = malloc(length + 1);
+    memcpy(compaction->path, path, length + 1);
+
+    // regions of changed chunks, listing the new ones first so the flags can be allocated
+    for (u32 i = 0; i < changed.chunk_count; i++) {
+        world_save_chunk_t* chunk = &changed.chunks[i];
+        ivec3 region;
+        u32 slot;
+        save_chunk_region((ivec3){ chunk->x, chunk->y, chunk->z }, region, &slot);
+
+        if (!save_region_find(save, region[0], region[1], region[2])) {
+            save_region_add(save, region[0], region[1], region[2]);
+        }
+    }
+
+    u8* region_dirty = calloc(save->region_count + 1, 1);
+    for (u32 i = 0; i < changed.chunk_count; i++) {
+        world_save_chunk_t* chunk = &changed.chunks[i];
+        ivec3 region;
+        u32 slot;
+        save_chunk_region((ivec3){ chunk->x, chunk->y, chunk->z }, region, &slot);
+
+        save_region_t* dirty = save_region_find(save, region[0], region[1], region[2]);
+        region_dirty[dirty - save->regions] = 1;
+    }
+
+    // one job per region, compression and I/O of different regions don't share anything
+    compaction->jobs = malloc(sizeof(save_region_job_t) * (save->region_count + 1));
+    compaction->job_count = 0;
+    for (u32 i = 0; i < save->region_count; i++) {
+        if (moving || region_dirty[i]) {
+            compaction->jobs[compaction->job_count++] = (save_region_job_t){
+                .save = save,
+                .region = i,
+            };
+        }
+    }
+    free(region_dirty);
+
+    compaction->running = true;
+    compaction->group = (job_group_t){ 0 };
+    compaction->start_ms = time_now_ms();
+    for (u32 i = 0; i < compaction->job_count; i++) {
+        save_region_job_t* job = &compaction->jobs[i];
+        job_submit(&g_job_pool, &compaction->group, save_region_write_job, job);
+    }
+}
+
+// Put the chunks of a failed compaction back with the save's changes, unless they changed
+// again since
+static void save_compact_restore(save_t* save) {
+    world_save_t* world = &save->compaction.world;
+
+    for (u32 i = 0; i < world->chunk_count; i++) {
+        world_save_chunk_t* chunk = &world->chunks[i];
+        ivec3 position = { chunk->x, chunk->y, chunk->z };
+        if (save_find_chunk(&save->world, position)) {
+            continue;
+        }
+
+        world_save_chunk_t* kept = save_put_chunk(save, position);
+        memcpy(kept->block_data, chunk->block_data, CHUNK_BLOCK_COUNT);
+        kept->journal_pending = chunk->journal_pending;
+    }
+}
+
+// Wait for the compaction's regions, put them in place of the old ones and write the save
+// file listing them. The chunks go back to the save's changes if any of it failed.
+static bool save_compact_finish(save_t* save) {
+    save_compaction_t* compaction = &save->compaction;
+    job_group_wait(&g_job_pool, &compaction->group);
+    compaction->running = false;
+
+    const char* path = compaction->path;
+    bool moving = !save->path || strcmp(save->path, path) != 0;
+
+    bool ok = true;
+    for (u32 i = 0; i < compaction->job_count; i++) {
+        ok = ok && compaction->jobs[i].ok;
+    }
+
+    for (u32 i = 0; i < compaction->job_count; i++) {
+        save_region_t* region = &save->regions[compaction->jobs[i].region];
+        char region_path[SAVE_PATH_MAX];
+        char temp_path[SAVE_PATH_MAX + 4];
+        save_region_path(path, region, region_path);
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", region_path);
+
+        if (!ok) {
+            remove(temp_path);
+            continue;
+        }
+
+        // chunks kept loading from the old file, and it can't be replaced while it's mapped
+        // on Windows
+        save_region_close(region);
+        if (!save_replace(temp_path, region_path)) {
+            LOG_ERROR("Failed to replace region %s\n", region_path);
+            remove(temp_path);
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        // the old regions stay in place
+        LOG_ERROR("Save %s is incomplete, keeping the previous save file\n", path);
+    }
+
+    ok = ok && save_write_file(save, path);
+    if (!ok) {
+        save_compact_restore(save);
+    } else if (moving) {
+        for (u32 i = 0; i < save->region_count; i++) {
+            save_region_close(&save->regions[i]);
+        }
+        save_set_path(save, path);
+    }
+
+    // everything is in the regions now, or back with the changes
+    save_world_clear(&compaction->world);
+    free(compaction->jobs);
+    compaction->jobs = NULL;
+    compaction->job_count = 0;
+
+    if (ok && save->journal_save_path && strcmp(save->journal_save_path, path) == 0) {
+        save_journal_wait(save);
+        save_journal_reset(save);
+    }
+
+    free(compaction->path);
+    compaction->path = NULL;
+
+    return ok;
+}
+
+void save_compact_wait(save_t* save) {
+    if (save->compaction.running) {
+        save_compact_finish(save);
+    }
+}
+
+void save_write(save_t* save, const char* path) {
+    save_compact_wait(save);
+    // the journal is started over once the regions are written
+    save_journal_wait(save);
+
+    save_compact_begin(save, path);
+    save_compact_finish(save);
+}
+
+const block_id_t* save_get_chunk_blocks(
+    save_t* save,
+    ivec3 position,
+    block_id_t scratch[CHUNK_BLOCK_COUNT]
+) {
+    world_save_chunk_t* changed = save_find_chunk(&save->world, position);
+    if (!changed && save->compaction.running) {
+        // on its way to a region that isn't in place yet
+        changed = save_find_chunk(&save->compaction.world, position);
+    }
+    if (changed) {
+        return changed->block_data;
+    }
+
+    if (!save->path) {
+        return NULL;
+    }
+
+    ivec3 region_position;
+    u32 slot;
+    save_chunk_region(position, region_position, &slot);
+
+    mutex_lock(&save->region_mutex);
+    save_region_t* region =
+        save_region_find(save, region_position[0], region_position[1], region_position[2]);
+    const save_region_header_t* header = region ? save_region_open(save, region) : NULL;
+    mutex_unlock(&save->region_mutex);
+
+    if (!header || !header->entries[slot].offset) {
+        return NULL;
+    }
+
+    save_region_entry_t entry = header->entries[slot];
+    const u8* data = region->map.data + entry.offset;
+    if (entry.encoding == COMPRESS_RAW) {
+        return data;
+    }
+
+    if (!save_decode_chunk(position, entry.encoding, data, entry.size, scratch)) {
+        LOG_ERROR(
+            "Chunk %d %d %d is corrupt, regenerating it\n",
+            position[0],
+            position[1],
+            position[2]
+        );
+        return NULL;
+    }
+
+    return scratch;
+}
+
 void save_add_chunk(save_t* save, const chunk_t* chunk) {
-    world_save_chunk_t* world_chunk = NULL;
+    world_save_chunk_t* world_chunk = save_put_chunk(
+        save,
+        (ivec3){ chunk->position[0], chunk->position[1], chunk->position[2] }
+    );
+
+    for (usize i = 0; i < CHUNK_BLOCK_COUNT; i++) {
+        world_chunk->block_data[i] = chunk->blocks[i].id;
+    }
+    world_chunk->journal_pending = true;
+}
+
+// Add the chunks of a journal to the save, up to the first torn or corrupt record
+// Returns the number of records replayed
+static u32 save_journal_replay(save_t* save, FILE* file, const char* path) {
+    save_header_t header;
+    if (!fread(&header, sizeof(save_header_t), 1, file) ||
+        memcmp(&header.magic, SAVE_JOURNAL_MAGIC_STR, 4) != 0 ||
+        header.save_format_version != SAVE_FORMAT_VERSION) {
+        LOG_WARNING("Journal %s is unreadable, discarding it\n", path);
+        return 0;
+    }
 
-    for (size_t i = 0; i < save->world.chunk_count; i++) {
-        if (save->world.chunks[i].x == chunk->position[0] &&
-            save->world.chunks[i].y == chunk->position[1] &&
-            save->world.chunks[i].z == chunk->position[2]) {
-            world_chunk = &save->world.chunks[i];
+    u32 replayed = 0;
+    save_journal_record_t record;
+    u8 data[CHUNK_BLOCK_COUNT];
+    block_id_t blocks[CHUNK_BLOCK_COUNT];
+
+    while (fread(&record, sizeof(save_journal_record_t), 1, file)) {
+        ivec3 position = { record.x, record.y, record.z };
+        bool valid = record.size <= CHUNK_BLOCK_COUNT &&
+                     fread(data, 1, record.size, file) == record.size &&
+                     save_journal_checksum(&record, data) == record.checksum &&
+                     save_decode_chunk(position, record.encoding, data, record.size, blocks);
+
+        if (!valid) {
+            LOG_WARNING("Journal %s ends in a torn record, dropping it\n", path);
             break;
         }
+
+        world_save_chunk_t* chunk = save_put_chunk(save, position);
+        memcpy(chunk->block_data, blocks, CHUNK_BLOCK_COUNT);
+        replayed++;
     }
 
-    bool is_new_chunk = world_chunk == NULL;
+    return replayed;
+}
 
-    if (is_new_chunk) {
-        LOG_INFO("Adding new chunk to save\n");
-        save->world.chunk_count++;
+void save_journal_open(save_t* save, const char* path, bool replay) {
+    save_compact_wait(save);
 
-        LOG_INFO("New chunk count: %d\n", save->world.chunk_count);
+    usize length = strlen(path);
+    free(save->journal_save_path);
+    free(save->journal_batch.chunks);
+    save->journal_save_path = malloc(length + 1);
+    memcpy(save->journal_save_path, path, length + 1);
 
-        save->world.chunks =
-            realloc(save->world.chunks, sizeof(world_save_chunk_t) * save->world.chunk_count);
+    char journal_path[SAVE_PATH_MAX];
+    save_journal_path(path, journal_path);
 
-        if (!save->world.chunks) {
-            LOG_ERROR("Failed to allocate memory for new chunk\n");
-            return;
+    FILE* file = replay ? fopen(journal_path, "rb") : NULL;
+    if (file) {
+        u32 replayed = save_journal_replay(save, file, journal_path);
+        fclose(file);
+
+        if (replayed) {
+            LOG_INFO("Recovered %u chunk records from journal %s\n", replayed, journal_path);
+            // starts the journal over once the chunks are in the regions
+            save_write(save, path);
         }
+    }
 
-        world_chunk = &save->world.chunks[save->world.chunk_count - 1];
+    // if compacting failed the recovered chunks are carried over to the new journal
+    if (!save->journal) {
+        save_journal_reset(save);
+    }
+}
 
-        world_chunk->x = chunk->position[0];
-        world_chunk->y = chunk->position[1];
-        world_chunk->z = chunk->position[2];
-    } else {
-        LOG_INFO("Updating existing chunk in save\n");
+static void save_journal_write_job(void* arg) {
+    save_t* save = arg;
+    save_journal_batch_t* batch = &save->journal_batch;
+    f64 start = time_now_ms();
+
+    bool written = true;
+    for (u32 i = 0; i < batch->chunk_count; i++) {
+        written = save_journal_append(save, &batch->chunks[i]) && written;
+    }
+
+    batch->written = written && fflush(save->journal) == 0 && save_fsync(save->journal) == 0;
+    batch->write_ms = time_now_ms() - start;
+}
+
+void save_journal_wait(save_t* save) {
+    save_journal_batch_t* batch = &save->journal_batch;
+    job_group_wait(&g_job_pool, &save->journal_group);
+
+    if (!batch->chunk_count) {
+        return;
     }
 
-    for (size_t z = 0; z < CHUNK_SIZE; z++) {
-        for (size_t x = 0; x < CHUNK_SIZE; x++) {
-            for (size_t y = 0; y < CHUNK_SIZE; y++) {
-                size_t index = z * CHUNK_SIZE * CHUNK_SIZE + y * CHUNK_SIZE + x;
-                world_chunk->block_data[index] = chunk->blocks[index].id;
+    if (!batch->written) {
+        LOG_ERROR("Failed to append to the journal of %s\n", save->journal_save_path);
+        // still in memory, try again with the next flush
+        for (u32 i = 0; i < batch->chunk_count; i++) {
+            world_save_chunk_t* chunk = &batch->chunks[i];
+            world_save_chunk_t* current =
+                save_find_chunk(&save->world, (ivec3){ chunk->x, chunk->y, chunk->z });
+            if (current) {
+                current->journal_pending = true;
             }
         }
     }
+
+    save->journal_stats.chunk_count = batch->chunk_count;
+    save->journal_stats.write_ms = batch->write_ms;
+    batch->chunk_count = 0;
+}
+
+void save_journal_flush(save_t* save) {
+    if (!save->journal) {
+        return;
+    }
+
+    save_journal_wait(save);
+
+    // with no workers the regions are only written once something waits for them
+    save_compaction_t* compaction = &save->compaction;
+    if (compaction->running &&
+        (job_group_done(&g_job_pool, &compaction->group) || !g_job_pool.thread_count)) {
+        u32 chunk_count = compaction->world.chunk_count;
+        f64 start_ms = compaction->start_ms;
+        if (save_compact_finish(save)) {
+            LOG_INFO(
+                "Compacted %u chunks into the regions of %s in %.0f ms\n",
+                chunk_count,
+                save->path,
+                time_now_ms() - start_ms
+            );
+        }
+    }
+
+    // a save that was never written has nothing to load the journal on top of
+    bool compact = !compaction->running &&
+                   (save->journal_size >= SAVE_JOURNAL_COMPACT_BYTES || !save->path);
+
+    f64 start = time_now_ms();
+    save_journal_batch_t* batch = &save->journal_batch;
+
+    for (u32 i = 0; i < save->world.chunk_count; i++) {
+        world_save_chunk_t* chunk = &save->world.chunks[i];
+        if (!chunk->journal_pending) {
+            continue;
+        }
+
+        if (batch->chunk_count == batch->chunk_capacity) {
+            batch->chunk_capacity = batch->chunk_capacity ? batch->chunk_capacity * 2 : 64;
+            batch->chunks =
+                realloc(batch->chunks, sizeof(world_save_chunk_t) * batch->chunk_capacity);
+        }
+
+        memcpy(&batch->chunks[batch->chunk_count++], chunk, sizeof(world_save_chunk_t));
+        chunk->journal_pending = false;
+    }
+
+    if (batch->chunk_count) {
+        save->journal_stats.snapshot_ms = time_now_ms() - start;
+        job_submit(&g_job_pool, &save->journal_group, save_journal_write_job, save);
+    }
+
+    // the journal keeps every chunk until the regions replace the old ones
+    if (compact) {
+        save_compact_begin(save, save->journal_save_path);
+    }
+}
+
+// Chunk i of the benchmark save
+static void save_bench_chunk_position(u32 i, i32 side, ivec3 position) {
+    position[0] = (i32)(i / 2 % (u32)side) - side / 2;
+    position[1] = (i32)(i % 2);
+    position[2] = (i32)(i / 2 / (u32)side) - side / 2;
+}
+
+// The version 1 writer this format replaced, as the baseline
+static void save_bench_write_v1(
+    const char* path,
+    const block_id_t* blocks,
+    u32 count,
+    i32 side
+) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return;
+    }
+
+    save_header_t header = { .save_format_version = SAVE_FORMAT_VERSION_V1 };
+    memcpy(&header.magic, SAVE_MAGIC_STR, 4);
+    u64 seed = 0;
+    fwrite(&header, sizeof(save_header_t), 1, file);
+    fwrite(&seed, sizeof(u64), 1, file);
+    fwrite(&count, sizeof(u32), 1, file);
+
+    for (u32 i = 0; i < count; i++) {
+        ivec3 position;
+        save_bench_chunk_position(i, side, position);
+        fwrite(&position[0], sizeof(i32), 1, file);
+        fwrite(&position[1], sizeof(i32), 1, file);
+        fwrite(&position[2], sizeof(i32), 1, file);
+        const block_id_t* chunk_blocks = blocks + (usize)i * CHUNK_BLOCK_COUNT;
+        fwrite(chunk_blocks, sizeof(block_id_t), CHUNK_BLOCK_COUNT, file);
+    }
+
+    fclose(file);
+}
+
+// Blocks the player changed in a benchmark chunk, every SAVE_BENCH_BUILT_EVERY-th chunk is
+// built over with SAVE_BENCH_BUILT_EDITS
+#define SAVE_BENCH_EDITS 32
+#define SAVE_BENCH_BUILT_EVERY 64
+#define SAVE_BENCH_BUILT_EDITS 2048
+
+// Some digging and building in chunk i's generated blocks
+static void save_bench_edit(u32 i, block_id_t blocks[CHUNK_BLOCK_COUNT]) {
+    u32 edits = i % SAVE_BENCH_BUILT_EVERY == 0 ? SAVE_BENCH_BUILT_EDITS : SAVE_BENCH_EDITS;
+    u32 state = i * 2654435761u + 1;
+
+    for (u32 k = 0; k < edits; k++) {
+        state = state * 1664525u + 1013904223u;
+        blocks[(state >> 8) % CHUNK_BLOCK_COUNT] = (block_id_t)((state >> 24) % BLOCK_ID_MAX);
+    }
+}
+
+// Journal flush of dirty loaded chunks, the way game_update autosaves
+static void save_bench_autosave(
+    const char* path,
+    const block_id_t* blocks,
+    u32 count,
+    i32 side
+) {
+    count = count < SAVE_BENCH_AUTOSAVE_CHUNKS ? count : SAVE_BENCH_AUTOSAVE_CHUNKS;
+    chunk_t* chunks = malloc(sizeof(chunk_t) * count);
+    for (u32 i = 0; i < count; i++) {
+        save_bench_chunk_position(i, side, chunks[i].position);
+        for (u32 j = 0; j < CHUNK_BLOCK_COUNT; j++) {
+            chunks[i].blocks[j].id = blocks[(usize)i * CHUNK_BLOCK_COUNT + j];
+        }
+    }
+
+    // flushes only go to the journal once the save file exists
+    save_t* save = save_new();
+    save_journal_open(save, path, false);
+    save_write(save, path);
+
+    f64 start = time_now_ms();
+    for (u32 i = 0; i < count; i++) {
+        save_add_chunk(save, &chunks[i]);
+    }
+    save_journal_flush(save);
+    f64 main_ms = time_now_ms() - start;
+
+    save_journal_wait(save);
+    f64 total_ms = time_now_ms() - start;
+
+    LOG_INFO(
+        "  autosave of %u chunks: %.2f ms on the calling thread (%.2f ms of it the snapshot), "
+        "%.1f ms on the pool, %.1f KiB of journal\n",
+        count,
+        main_ms,
+        save->journal_stats.snapshot_ms,
+        total_ms - main_ms,
+        (f64)save->journal_size / 1024.0
+    );
+
+    char journal_path[SAVE_PATH_MAX];
+    save_journal_path(path, journal_path);
+    save_remove(save, path);
+    save_free(save);
+    remove(journal_path);
+    free(chunks);
+}
+
+void save_bench(u32 chunk_count, const char* path) {
+    LOG_INFO("Save benchmark: %u generated and edited chunks, %s\n", chunk_count, path);
+
+    // a square of columns 2 chunks high around the origin, like an explored world
+    i32 side = 1;
+    while ((u32)(side * side * 2) < chunk_count) {
+        side++;
+    }
+
+    // the same terrain every run
+    world_generator_init(0);
+
+    block_id_t* blocks = malloc((usize)chunk_count * CHUNK_BLOCK_COUNT);
+    chunk_t* chunk = calloc(1, sizeof(chunk_t));
+
+    f64 start = time_now_ms();
+    for (u32 i = 0; i < chunk_count; i++) {
+        save_bench_chunk_position(i, side, chunk->position);
+        chunk_generate(chunk, NULL);
+
+        for (u32 j = 0; j < CHUNK_BLOCK_COUNT; j++) {
+            blocks[(usize)i * CHUNK_BLOCK_COUNT + j] = chunk->blocks[j].id;
+        }
+    }
+    f64 generate_ms = time_now_ms() - start;
+
+    for (u32 i = 0; i < chunk_count; i++) {
+        save_bench_edit(i, blocks + (usize)i * CHUNK_BLOCK_COUNT);
+    }
+
+    f64 megabytes = (f64)chunk_count * CHUNK_BLOCK_COUNT / (1024.0 * 1024.0);
+    LOG_INFO(
+        "  generating: %.1f ms, %.2f us/chunk, %.1f MiB of block ids\n",
+        generate_ms,
+        generate_ms * 1000.0 / chunk_count,
+        megabytes
+    );
+
+    start = time_now_ms();
+    save_bench_write_v1(path, blocks, chunk_count, side);
+    f64 write_ms = time_now_ms() - start;
+    u64 v1_size = save_file_size(path);
+
+    start = time_now_ms();
+    world_save_t v1_world = { 0 };
+    FILE* file = fopen(path, "rb");
+    save_header_t header;
+    if (file && fread(&header, sizeof(save_header_t), 1, file)) {
+        save_read_world_v1(file, &v1_world);
+    }
+    if (file) {
+        fclose(file);
+    }
+    f64 read_ms = time_now_ms() - start;
+    free(v1_world.chunks);
+    free(v1_world.index);
+    remove(path);
+
+    LOG_INFO("  encoding  size MiB  ratio  write MiB/s  load+read MiB/s  read us/chunk\n");
+    LOG_INFO(
+        "  v1        %8.1f  %5.2f  %11.1f  %15.1f  %13.2f\n",
+        (f64)v1_size / (1024.0 * 1024.0),
+        1.0,
+        megabytes / (write_ms / 1000.0),
+        megabytes / (read_ms / 1000.0),
+        read_ms * 1000.0 / chunk_count
+    );
+
+    // every encoding with whole chunks, then the default encoding with deltas
+    for (u32 row = 0; row <= SAVE_ENCODING_COUNT; row++) {
+        save_t* save = save_new();
+        save->delta = row == SAVE_ENCODING_COUNT;
+        if (!save->delta) {
+            save->encoding = (save_encoding_t)row;
+        }
+
+        for (u32 i = 0; i < chunk_count; i++) {
+            save_bench_chunk_position(i, side, chunk->position);
+            for (u32 j = 0; j < CHUNK_BLOCK_COUNT; j++) {
+                chunk->blocks[j].id = blocks[(usize)i * CHUNK_BLOCK_COUNT + j];
+            }
+            save_add_chunk(save, chunk);
+        }
+
+        start = time_now_ms();
+        save_write(save, path);
+        write_ms = time_now_ms() - start;
+        save_free(save);
+
+        // loading maps nothing, the first read of a chunk maps its region and decodes it
+        start = time_now_ms();
+        save_t* loaded = save_load(path);
+        u32 matching = 0;
+        block_id_t scratch[CHUNK_BLOCK_COUNT];
+
+        for (u32 i = 0; loaded && i < chunk_count; i++) {
+            ivec3 position;
+            save_bench_chunk_position(i, side, position);
+
+            const block_id_t* saved = save_get_chunk_blocks(loaded, position, scratch);
+            const block_id_t* expected = blocks + (usize)i * CHUNK_BLOCK_COUNT;
+            matching += saved && memcmp(saved, expected, CHUNK_BLOCK_COUNT) == 0;
+        }
+        read_ms = time_now_ms() - start;
+
+        if (!loaded) {
+            LOG_ERROR("Save benchmark: reading %s back failed\n", path);
+            continue;
+        }
+
+        u64 size = save_remove(loaded, path);
+        save_free(loaded);
+
+        LOG_INFO(
+            "  %-8s  %8.1f  %5.2f  %11.1f  %15.1f  %13.2f%s\n",
+            row < SAVE_ENCODING_COUNT ? save_encoding_names[row] : "delta",
+            (f64)size / (1024.0 * 1024.0),
+            (f64)v1_size / (f64)size,
+            megabytes / (write_ms / 1000.0),
+            megabytes / (read_ms / 1000.0),
+            read_ms * 1000.0 / chunk_count,
+            matching == chunk_count ? "" : "  MISMATCH"
+        );
+    }
+
+    save_bench_autosave(path, blocks, chunk_count, side);
+
+    free(chunk);
+    free(blocks);
 }
@@ -3,62 +3,176 @@
 #include "log.h"
 #include "types.h"
 #include "assets.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "shader_cache.h"
+
+#include "uniforms.h"
+#include "utils.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cglm/types.h>
 
 shader_t g_shader_current;
 
+const char* shader_feature_names[SHADER_FEATURE_COUNT] = {
+    "TEXTURE",
+    "LIGHTING",
+    "FOG",
+    "SHADOW_HARD",
+    "SHADOW_POISSON_4",
+    "SHADOW_POISSON_9",
+};
+
+static const char* g_shader_preamble = "";
+
+void shader_set_preamble(const char* preamble) {
+    g_shader_preamble = preamble ? preamble : "";
+}
+
+// The #version directive has to stay the first line of the shader,
+// so the defines and the preamble are spliced in right after it
+static void shader_source_with_preamble(u32 shader, const char* source, const char* defines) {
+    const char* body = source;
+    if (strncmp(source, "#version", 8) == 0) {
+        const char* newline = strchr(source, '\n');
+        body = newline ? newline + 1 : source + strlen(source);
+    }
+
+    const char* sources[4] = { source, defines ? defines : "", g_shader_preamble, body };
+    GLint lengths[4] = { (GLint)(body - source), -1, -1, -1 };
+
+    glShaderSource(shader, 4, sources, lengths);
+}
+
+void shader_enable_parallel_compile(void) {
+    // let the driver pick how many threads to compile on
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        LOG_INFO("Shaders compile in parallel (KHR_parallel_shader_compile)\n");
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        LOG_INFO("Shaders compile in parallel (ARB_parallel_shader_compile)\n");
+    }
+}
+
 shader_t shader_new(const char* vertex_shader_source, const char* fragment_shader_source) {
-    shader_t shader = { 0 };
+    return shader_new_with_defines(vertex_shader_source, fragment_shader_source, NULL);
+}
 
-    u32 vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-    glCompileShader(vertex_shader);
+shader_t shader_new_with_defines(
+    const char* vertex_shader_source,
+    const char* fragment_shader_source,
+    const char* defines
+) {
+    shader_build_t build =
+        shader_build_begin(vertex_shader_source, fragment_shader_source, defines);
 
-    GLint success;
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+    return shader_build_finish(&build);
+}
 
-    if (!success) {
-        LOG_ERROR("Failed to compile vertex shader\n");
+shader_build_t shader_build_begin(
+    const char* vertex_shader_source,
+    const char* fragment_shader_source,
+    const char* defines
+) {
+    shader_build_t build = { .start_ms = time_now_ms() };
 
-        i32 log_length;
-        glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &log_length);
-        char* log = malloc((usize)log_length);
-        glGetShaderInfoLog(vertex_shader, log_length, NULL, log);
-        LOG_ERROR("Shader compilation log: %s\n", log);
-        free(log);
+    if (shader_cache_enabled()) {
+        build.cache_key = shader_cache_key(
+            vertex_shader_source,
+            fragment_shader_source,
+            defines,
+            g_shader_preamble
+        );
 
-        return shader;
+        build.program = shader_cache_load(build.cache_key);
+        if (build.program) {
+            build.cached = true;
+            return build;
+        }
+    }
+
+    // nothing here asks for a status, so a driver that compiles in the background
+    // doesn't have to finish before this returns
+    build.vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    shader_source_with_preamble(build.vertex_shader, vertex_shader_source, defines);
+    glCompileShader(build.vertex_shader);
+
+    build.fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    shader_source_with_preamble(build.fragment_shader, fragment_shader_source, defines);
+    glCompileShader(build.fragment_shader);
+
+    build.program = glCreateProgram();
+    glAttachShader(build.program, build.vertex_shader);
+    glAttachShader(build.program, build.fragment_shader);
+
+    if (shader_cache_enabled()) {
+        glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    glLinkProgram(build.program);
+
+    return build;
+}
+
+bool shader_build_ready(shader_build_t* build) {
+    bool parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    if (build->cached || !parallel) {
+        return true;
     }
 
-    u32 fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-    glCompileShader(fragment_shader);
+    GLint complete = GL_FALSE;
+    glGetProgramiv(build->program, GL_COMPLETION_STATUS_KHR, &complete);
 
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+    return complete == GL_TRUE;
+}
+
+static bool shader_check_compile(u32 shader, const char* stage) {
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
     if (!success) {
-        LOG_ERROR("Failed to compile fragment shader\n");
+        LOG_ERROR("Failed to compile %s shader\n", stage);
 
         i32 log_length;
-        glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &log_length);
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
         char* log = malloc((usize)log_length);
-        glGetShaderInfoLog(fragment_shader, log_length, NULL, log);
+        glGetShaderInfoLog(shader, log_length, NULL, log);
         LOG_ERROR("Shader compilation log: %s\n", log);
         free(log);
+    }
+
+    return success;
+}
 
+shader_t shader_build_finish(shader_build_t* build) {
+    shader_t shader = { .program = build->program };
+
+    if (build->cached) {
+        // block bindings are not part of the binary
+        uniforms_bind_program(shader.program);
         return shader;
     }
 
-    shader.program = glCreateProgram();
-    glAttachShader(shader.program, vertex_shader);
-    glAttachShader(shader.program, fragment_shader);
+    bool compiled = shader_check_compile(build->vertex_shader, "vertex") &&
+                    shader_check_compile(build->fragment_shader, "fragment");
+
+    glDetachShader(shader.program, build->vertex_shader);
+    glDetachShader(shader.program, build->fragment_shader);
+    glDeleteShader(build->vertex_shader);
+    glDeleteShader(build->fragment_shader);
 
-    glLinkProgram(shader.program);
+    if (!compiled) {
+        glDeleteProgram(shader.program);
+        return (shader_t){ 0 };
+    }
 
+    GLint success;
     glGetProgramiv(shader.program, GL_LINK_STATUS, &success);
     if (!success) {
         LOG_ERROR("Failed to link shader program\n");
@@ -73,10 +187,9 @@ shader_t shader_new(const char* vertex_shader_source, const char* fragment_shade
         return shader;
     }
 
-    glDetachShader(shader.program, vertex_shader);
-    glDetachShader(shader.program, fragment_shader);
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    shader_cache_store(build->cache_key, shader.program);
+
+    uniforms_bind_program(shader.program);
 
     return shader;
 }
@@ -98,11 +211,13 @@ shader_t shader_from_assets(const char* vertex_shader_path, const char* fragment
 }
 
 void shader_free(shader_t* shader) {
+    g_render_resource_generation++;
+    gl_state_forget_program(shader->program);
     glDeleteProgram(shader->program);
 }
 
 void shader_use(shader_t* shader) {
-    glUseProgram(shader->program);
+    gl_state_use_program(shader->program);
 
     g_shader_current = *shader;
 }
@@ -134,3 +249,111 @@ void shader_set_vec4(shader_t* shader, const char* name, vec4 value) {
 void shader_set_mat4(shader_t* shader, const char* name, mat4 value) {
     glUniformMatrix4fv(glGetUniformLocation(shader->program, name), 1, GL_FALSE, (f32*)value);
 }
+
+void shader_base_init(
+    shader_base_t* base,
+    const char* name,
+    const char* vertex_source,
+    const char* fragment_source,
+    u32 supported_features
+) {
+    memset(base, 0, sizeof(shader_base_t));
+    base->name = name;
+    base->vertex_source = vertex_source;
+    base->fragment_source = fragment_source;
+    base->supported_features = supported_features;
+}
+
+void shader_base_add_sampler(shader_base_t* base, const char* name, i32 unit) {
+    if (base->sampler_count >= SHADER_BASE_MAX_SAMPLERS) {
+        LOG_ERROR("Too many samplers on shader %s\n", base->name);
+        return;
+    }
+
+    base->samplers[base->sampler_count++] = (shader_sampler_t){ name, unit };
+}
+
+static u32 shader_base_mask(shader_base_t* base, u32 features) {
+    return features & base->supported_features & (SHADER_PERMUTATION_COUNT - 1);
+}
+
+void shader_base_prepare(shader_base_t* base, u32 features) {
+    features = shader_base_mask(base, features);
+
+    if (base->permutations[features].program || base->builds[features].program ||
+        base->failed[features]) {
+        return;
+    }
+
+    char defines[256];
+    usize length = 0;
+    defines[0] = '\0';
+
+    for (u32 i = 0; i < SHADER_FEATURE_COUNT; i++) {
+        if (features & (1u << i)) {
+            length += (usize)snprintf(
+                defines + length,
+                sizeof(defines) - length,
+                "#define FEATURE_%s\n",
+                shader_feature_names[i]
+            );
+        }
+    }
+
+    base->builds[features] =
+        shader_build_begin(base->vertex_source, base->fragment_source, defines);
+}
+
+shader_t* shader_base_get(shader_base_t* base, u32 features) {
+    features = shader_base_mask(base, features);
+
+    shader_t* shader = &base->permutations[features];
+    if (shader->program) {
+        return shader;
+    }
+    if (base->failed[features]) {
+        return features ? shader_base_get(base, 0) : shader;
+    }
+
+    shader_base_prepare(base, features);
+
+    shader_build_t* build = &base->builds[features];
+    *shader = shader_build_finish(build);
+    f64 build_ms = time_now_ms() - build->start_ms;
+    *build = (shader_build_t){ 0 };
+
+    if (!shader->program) {
+        // logged once, the next frames go straight to the fallback
+        LOG_ERROR("Failed to compile %s permutation 0x%02x\n", base->name, features);
+        base->failed[features] = true;
+        return features ? shader_base_get(base, 0) : shader;
+    }
+
+    // sampler units are program state, they only need to be set once
+    shader_use(shader);
+    for (u32 i = 0; i < base->sampler_count; i++) {
+        shader_set_int(shader, base->samplers[i].name, base->samplers[i].unit);
+    }
+
+    base->permutation_count++;
+    LOG_INFO("Built %s permutation 0x%02x in %.1f ms\n", base->name, features, build_ms);
+
+    return shader;
+}
+
+void shader_base_free(shader_base_t* base) {
+    for (u32 i = 0; i < SHADER_PERMUTATION_COUNT; i++) {
+        if (base->builds[i].program) {
+            base->permutations[i] = shader_build_finish(&base->builds[i]);
+            base->builds[i] = (shader_build_t){ 0 };
+        }
+
+        if (base->permutations[i].program) {
+            shader_free(&base->permutations[i]);
+        }
+        base->permutations[i] = (shader_t){ 0 };
+        base->failed[i] = false;
+    }
+
+    base->permutation_count = 0;
+}
@@ -0,0 +1,233 @@
+#include "shader_cache.h"
+
+#include "log.h"
+#include "types.h"
+#include "utils.h"
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define shader_cache_mkdir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define shader_cache_mkdir(path) mkdir(path, 0755)
+#endif
+
+#define SHADER_CACHE_PATH_MAX 512
+
+shader_cache_stats_t g_shader_cache_stats;
+
+static const char* g_shader_cache_directory = NULL;
+// vendor, renderer, versions and binary formats, folded into every key
+static u64 g_shader_cache_driver_hash;
+
+static u64 shader_cache_hash_string(const char* string, u64 hash) {
+    if (string) {
+        hash = hash_fnv1a(string, strlen(string), hash);
+    }
+
+    // separator, so "ab" + "c" and "a" + "bc" differ
+    return hash_fnv1a("", 1, hash);
+}
+
+void shader_cache_init(const char* directory) {
+    g_shader_cache_directory = NULL;
+
+    if (!directory) {
+        return;
+    }
+
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+        LOG_INFO("Shader cache disabled, program binaries are not supported\n");
+        return;
+    }
+
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (format_count <= 0) {
+        LOG_INFO("Shader cache disabled, the driver has no program binary formats\n");
+        return;
+    }
+
+    GLint* formats = malloc(sizeof(GLint) * (usize)format_count);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+
+    u64 hash = HASH_FNV1A_SEED;
+    hash = shader_cache_hash_string((const char*)glGetString(GL_VENDOR), hash);
+    hash = shader_cache_hash_string((const char*)glGetString(GL_RENDERER), hash);
+    hash = shader_cache_hash_string((const char*)glGetString(GL_VERSION), hash);
+    hash = shader_cache_hash_string(
+        (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION),
+        hash
+    );
+    hash = hash_fnv1a(formats, sizeof(GLint) * (usize)format_count, hash);
+    free(formats);
+
+    // fails harmlessly when it already exists, a store into a missing directory just misses
+    shader_cache_mkdir(directory);
+
+    g_shader_cache_directory = directory;
+    g_shader_cache_driver_hash = hash;
+
+    LOG_INFO("Shader cache in %s/, %d binary formats\n", directory, format_count);
+}
+
+bool shader_cache_enabled(void) {
+    return g_shader_cache_directory != NULL;
+}
+
+u64 shader_cache_key(
+    const char* vertex_source,
+    const char* fragment_source,
+    const char* defines,
+    const char* preamble
+) {
+    u64 hash = g_shader_cache_driver_hash ^ SHADER_CACHE_FORMAT_VERSION;
+    hash = shader_cache_hash_string(vertex_source, hash);
+    hash = shader_cache_hash_string(fragment_source, hash);
+    hash = shader_cache_hash_string(defines, hash);
+    hash = shader_cache_hash_string(preamble, hash);
+
+    return hash;
+}
+
+static void shader_cache_path(u64 key, char* path, usize size) {
+    snprintf(path, size, "%s/%016llx.bin", g_shader_cache_directory, (unsigned long long)key);
+}
+
+static GLuint shader_cache_reject(const char* path, const char* reason) {
+    LOG_WARNING("Discarding shader cache entry %s: %s\n", path, reason);
+    remove(path);
+    g_shader_cache_stats.rejected++;
+    g_shader_cache_stats.misses++;
+
+    return 0;
+}
+
+GLuint shader_cache_load(u64 key) {
+    if (!g_shader_cache_directory) {
+        return 0;
+    }
+
+    char path[SHADER_CACHE_PATH_MAX];
+    shader_cache_path(key, path, sizeof(path));
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        g_shader_cache_stats.misses++;
+        return 0;
+    }
+
+    shader_cache_header_t header;
+    if (fread(&header, sizeof(shader_cache_header_t), 1, file) != 1) {
+        fclose(file);
+        return shader_cache_reject(path, "truncated header");
+    }
+
+    if (memcmp(&header.magic, SHADER_CACHE_MAGIC_STR, 4) != 0 ||
+        header.format_version != SHADER_CACHE_FORMAT_VERSION) {
+        fclose(file);
+        return shader_cache_reject(path, "not a shader cache entry");
+    }
+
+    // a file from another driver or source that happens to share the name
+    if (header.key != key) {
+        fclose(file);
+        return shader_cache_reject(path, "key mismatch");
+    }
+
+    // the length is from the file, never trust it past what the file holds
+    long start = ftell(file);
+    long end = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (start < 0 || end < start || header.binary_length == 0 ||
+        header.binary_length > (u64)(end - start) || fseek(file, start, SEEK_SET) != 0) {
+        fclose(file);
+        return shader_cache_reject(path, "truncated binary");
+    }
+
+    void* binary = malloc(header.binary_length);
+    if (!binary) {
+        fclose(file);
+        LOG_WARNING("No memory for shader cache entry %s, compiling instead\n", path);
+        g_shader_cache_stats.misses++;
+        return 0;
+    }
+
+    usize read = fread(binary, 1, header.binary_length, file);
+    fclose(file);
+
+    if (read != header.binary_length ||
+        hash_fnv1a(binary, header.binary_length, HASH_FNV1A_SEED) != header.binary_hash) {
+        free(binary);
+        return shader_cache_reject(path, "corrupt binary");
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binary_format, binary, (GLsizei)header.binary_length);
+    free(binary);
+
+    // drivers refuse binaries from other versions of themselves here
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(program);
+        return shader_cache_reject(path, "refused by the driver");
+    }
+
+    g_shader_cache_stats.hits++;
+    return program;
+}
+
+void shader_cache_store(u64 key, GLuint program) {
+    if (!g_shader_cache_directory) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    shader_cache_header_t header = {
+        .format_version = SHADER_CACHE_FORMAT_VERSION,
+        .key = key,
+        .binary_length = (u32)length,
+    };
+    memcpy(&header.magic, SHADER_CACHE_MAGIC_STR, 4);
+
+    void* binary = malloc((usize)length);
+    glGetProgramBinary(program, length, NULL, &header.binary_format, binary);
+    header.binary_hash = hash_fnv1a(binary, (usize)length, HASH_FNV1A_SEED);
+
+    char path[SHADER_CACHE_PATH_MAX];
+    char temp_path[SHADER_CACHE_PATH_MAX + 4];
+    shader_cache_path(key, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    // written aside and renamed, so a crash mid-write never leaves a torn entry
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        free(binary);
+        return;
+    }
+
+    bool written = fwrite(&header, sizeof(shader_cache_header_t), 1, file) == 1 &&
+                   fwrite(binary, 1, (usize)length, file) == (usize)length;
+    fclose(file);
+    free(binary);
+
+    if (!written) {
+        remove(temp_path);
+        return;
+    }
+
+    remove(path);
+    if (rename(temp_path, path) != 0) {
+        remove(temp_path);
+    }
+}
@@ -0,0 +1,6 @@
+// The stb implementations, on their own so targets without assets can link them
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
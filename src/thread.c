@@ -0,0 +1,130 @@
+#include "thread.h"
+
+#include "types.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID arg) {
+    thread_t* thread = arg;
+    thread->fn(thread->arg);
+    return 0;
+}
+
+bool thread_create(thread_t* thread, thread_fn fn, void* arg) {
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+
+    return thread->handle != NULL;
+}
+
+void thread_join(thread_t* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+u32 thread_hardware_concurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors > 0 ? (u32)info.dwNumberOfProcessors : 1;
+}
+
+void mutex_init(mutex_t* mutex) {
+    InitializeSRWLock(&mutex->lock);
+}
+
+void mutex_free(mutex_t* mutex) {
+    (void)mutex;
+}
+
+void mutex_lock(mutex_t* mutex) {
+    AcquireSRWLockExclusive(&mutex->lock);
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    ReleaseSRWLockExclusive(&mutex->lock);
+}
+
+void cond_init(cond_t* cond) {
+    InitializeConditionVariable(&cond->cond);
+}
+
+void cond_free(cond_t* cond) {
+    (void)cond;
+}
+
+void cond_wait(cond_t* cond, mutex_t* mutex) {
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+}
+
+void cond_signal(cond_t* cond) {
+    WakeConditionVariable(&cond->cond);
+}
+
+void cond_broadcast(cond_t* cond) {
+    WakeAllConditionVariable(&cond->cond);
+}
+#else
+static void* thread_entry(void* arg) {
+    thread_t* thread = arg;
+    thread->fn(thread->arg);
+    return NULL;
+}
+
+bool thread_create(thread_t* thread, thread_fn fn, void* arg) {
+    thread->fn = fn;
+    thread->arg = arg;
+
+    return pthread_create(&thread->handle, NULL, thread_entry, thread) == 0;
+}
+
+void thread_join(thread_t* thread) {
+    pthread_join(thread->handle, NULL);
+}
+
+u32 thread_hardware_concurrency(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (u32)count : 1;
+}
+
+void mutex_init(mutex_t* mutex) {
+    pthread_mutex_init(&mutex->lock, NULL);
+}
+
+void mutex_free(mutex_t* mutex) {
+    pthread_mutex_destroy(&mutex->lock);
+}
+
+void mutex_lock(mutex_t* mutex) {
+    pthread_mutex_lock(&mutex->lock);
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    pthread_mutex_unlock(&mutex->lock);
+}
+
+void cond_init(cond_t* cond) {
+    pthread_cond_init(&cond->cond, NULL);
+}
+
+void cond_free(cond_t* cond) {
+    pthread_cond_destroy(&cond->cond);
+}
+
+void cond_wait(cond_t* cond, mutex_t* mutex) {
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+}
+
+void cond_signal(cond_t* cond) {
+    pthread_cond_signal(&cond->cond);
+}
+
+void cond_broadcast(cond_t* cond) {
+    pthread_cond_broadcast(&cond->cond);
+}
+#endif
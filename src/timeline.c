@@ -0,0 +1,120 @@
+#include "timeline.h"
+
+#include "job.h"
+#include "log.h"
+#include "thread.h"
+#include "types.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TIMELINE_BAR_WIDTH 40
+
+timeline_t g_startup_timeline;
+
+void timeline_init(timeline_t* timeline) {
+    memset(timeline, 0, sizeof(timeline_t));
+    mutex_init(&timeline->mutex);
+    timeline->origin_ms = time_now_ms();
+}
+
+void timeline_free(timeline_t* timeline) {
+    mutex_free(&timeline->mutex);
+}
+
+u32 timeline_begin(timeline_t* timeline, const char* name) {
+    f64 now = time_now_ms();
+
+    mutex_lock(&timeline->mutex);
+    u32 span = timeline->span_count;
+    if (span < TIMELINE_MAX_SPANS) {
+        timeline->spans[span] = (timeline_span_t){
+            .name = name,
+            .start_ms = now,
+            .end_ms = now,
+            .thread = job_worker_index(),
+        };
+        timeline->span_count++;
+    }
+    mutex_unlock(&timeline->mutex);
+
+    return span;
+}
+
+void timeline_end(timeline_t* timeline, u32 span) {
+    f64 now = time_now_ms();
+
+    mutex_lock(&timeline->mutex);
+    if (span < timeline->span_count) {
+        timeline->spans[span].end_ms = now;
+    }
+    mutex_unlock(&timeline->mutex);
+}
+
+void timeline_add(
+    timeline_t* timeline,
+    const char* name,
+    f64 start_ms,
+    f64 end_ms,
+    u32 thread
+) {
+    mutex_lock(&timeline->mutex);
+    if (timeline->span_count < TIMELINE_MAX_SPANS) {
+        timeline->spans[timeline->span_count++] = (timeline_span_t){
+            .name = name,
+            .start_ms = start_ms,
+            .end_ms = end_ms,
+            .thread = thread,
+        };
+    }
+    mutex_unlock(&timeline->mutex);
+}
+
+void timeline_log(timeline_t* timeline, const char* title) {
+    mutex_lock(&timeline->mutex);
+
+    f64 total_ms = 0.0;
+    for (u32 i = 0; i < timeline->span_count; i++) {
+        f64 end = timeline->spans[i].end_ms - timeline->origin_ms;
+        total_ms = end > total_ms ? end : total_ms;
+    }
+
+    LOG_INFO("%s, %.1f ms:\n", title, total_ms);
+
+    for (u32 i = 0; i < timeline->span_count; i++) {
+        timeline_span_t* span = &timeline->spans[i];
+        f64 start = span->start_ms - timeline->origin_ms;
+        f64 end = span->end_ms - timeline->origin_ms;
+
+        char bar[TIMELINE_BAR_WIDTH + 1];
+        memset(bar, ' ', TIMELINE_BAR_WIDTH);
+        bar[TIMELINE_BAR_WIDTH] = '\0';
+
+        if (total_ms > 0.0) {
+            u32 bar_start = (u32)(start / total_ms * (TIMELINE_BAR_WIDTH - 1));
+            u32 bar_end = (u32)(end / total_ms * (TIMELINE_BAR_WIDTH - 1));
+            for (u32 c = bar_start; c <= bar_end && c < TIMELINE_BAR_WIDTH; c++) {
+                bar[c] = '#';
+            }
+        }
+
+        char thread[16];
+        if (span->thread == TIMELINE_THREAD_POOL) {
+            snprintf(thread, sizeof(thread), "pool");
+        } else {
+            snprintf(thread, sizeof(thread), "t%u", span->thread);
+        }
+
+        LOG_INFO(
+            "  %8.1f %8.1f ms  %-4s |%s| %s\n",
+            start,
+            end - start,
+            thread,
+            bar,
+            span->name
+        );
+    }
+
+    mutex_unlock(&timeline->mutex);
+}
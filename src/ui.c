@@ -5,6 +5,7 @@
 #include "globals.h"
 #include "log.h"
 #include "mesh.h"
+#include "profile.h"
 #include "types.h"
 #include <cglm/affine.h>
 #include <cglm/mat4.h>
@@ -28,8 +29,9 @@ void ui_update(ui_t* ui) {
     ui_element_update(&ui->root);
 }
 
-void ui_draw(ui_t* ui) {
-    ui_element_draw(&ui->root);
+void ui_submit(ui_t* ui, render_queue_t* queue, GLuint program) {
+    PROFILE_SCOPE("ui_submit");
+    ui_element_submit(&ui->root, queue, program);
 }
 
 void ui_free(ui_t* ui) {
@@ -240,24 +242,38 @@ void ui_element_update(ui_element_t* element) {
     }
 }
 
-void ui_element_draw(ui_element_t* element) {
+void ui_element_submit(ui_element_t* element, render_queue_t* queue, GLuint program) {
+    vec3 eye = { 0.0f, 0.0f, 0.0f };
+
     switch (element->type) {
         case UI_ELEMENT_TYPE_TEXT:
             break;
         case UI_ELEMENT_TYPE_IMAGE:
-            texture_bind(&element->image.texture, 0);
-            mesh_instance_draw(&element->image.instance);
+            mesh_instance_submit(
+                &element->image.instance,
+                queue,
+                RENDER_PASS_UI,
+                program,
+                element->image.texture.id,
+                eye
+            );
             break;
         case UI_ELEMENT_TYPE_BUTTON:
-            texture_bind(&element->button.texture, 0);
-            mesh_instance_draw(&element->button.instance);
+            mesh_instance_submit(
+                &element->button.instance,
+                queue,
+                RENDER_PASS_UI,
+                program,
+                element->button.texture.id,
+                eye
+            );
             break;
         default:
             break;
     }
 
     for (size_t i = 0; i < element->children_count; ++i) {
-        ui_element_draw(&element->children[i]);
+        ui_element_submit(&element->children[i], queue, program);
     }
 }
 
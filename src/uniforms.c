@@ -0,0 +1,59 @@
+#include "uniforms.h"
+
+#include "log.h"
+#include "types.h"
+
+#include <GL/glew.h>
+
+static GLuint uniforms_create_buffer(GLuint binding, usize size) {
+    GLuint ubo;
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+
+    return ubo;
+}
+
+void uniforms_init(uniform_buffers_t* uniforms) {
+    uniforms->frame_ubo =
+        uniforms_create_buffer(UNIFORMS_FRAME_BINDING, sizeof(frame_uniforms_t));
+    uniforms->pass_ubo = uniforms_create_buffer(UNIFORMS_PASS_BINDING, sizeof(pass_uniforms_t));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    LOG_INFO(
+        "Uniform buffers initialized (frame: %zu bytes, pass: %zu bytes)\n",
+        sizeof(frame_uniforms_t),
+        sizeof(pass_uniforms_t)
+    );
+}
+
+void uniforms_free(uniform_buffers_t* uniforms) {
+    glDeleteBuffers(1, &uniforms->frame_ubo);
+    glDeleteBuffers(1, &uniforms->pass_ubo);
+}
+
+void uniforms_bind_program(u32 program) {
+    GLuint frame_block = glGetUniformBlockIndex(program, UNIFORMS_FRAME_BLOCK_NAME);
+    if (frame_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, frame_block, UNIFORMS_FRAME_BINDING);
+    }
+
+    GLuint pass_block = glGetUniformBlockIndex(program, UNIFORMS_PASS_BLOCK_NAME);
+    if (pass_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, pass_block, UNIFORMS_PASS_BINDING);
+    }
+}
+
+void uniforms_upload_frame(uniform_buffers_t* uniforms) {
+    glBindBuffer(GL_UNIFORM_BUFFER, uniforms->frame_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_uniforms_t), &uniforms->frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void uniforms_upload_pass(uniform_buffers_t* uniforms) {
+    glBindBuffer(GL_UNIFORM_BUFFER, uniforms->pass_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(pass_uniforms_t), &uniforms->pass);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -1,162 +1,629 @@
 #include "utils.h"
 
+#include "log.h"
 #include "types.h"
 #include <math.h>
-#include <cglm/util.h>
-
-static i32 g_perm[] = {
-    208, 34,  231, 213, 32,  248, 233, 56,  161, 78,  24,  140, 71,  48,  140, 254, 245, 255,
-    247, 247, 40,  185, 248, 251, 245, 28,  124, 204, 204, 76,  36,  1,   107, 28,  234, 163,
-    202, 224, 245, 128, 167, 204, 9,   92,  217, 54,  239, 174, 173, 102, 193, 189, 190, 121,
-    100, 108, 167, 44,  43,  77,  180, 204, 8,   81,  70,  223, 11,  38,  24,  254, 210, 210,
-    177, 32,  81,  195, 243, 125, 8,   169, 112, 32,  97,  53,  195, 13,  203, 9,   47,  104,
-    125, 117, 114, 124, 165, 203, 181, 235, 193, 206, 70,  180, 174, 0,   167, 181, 41,  164,
-    30,  116, 127, 198, 245, 146, 87,  224, 149, 206, 57,  4,   192, 210, 65,  210, 129, 240,
-    178, 105, 228, 108, 245, 148, 140, 40,  35,  195, 38,  58,  65,  207, 215, 253, 65,  85,
-    208, 76,  62,  3,   237, 55,  89,  232, 50,  217, 64,  244, 157, 199, 121, 252, 90,  17,
-    212, 203, 149, 152, 140, 187, 234, 177, 73,  174, 193, 100, 192, 143, 97,  53,  145, 135,
-    19,  103, 13,  90,  135, 151, 199, 91,  239, 247, 33,  39,  145, 101, 120, 99,  3,   186,
-    86,  99,  41,  237, 203, 111, 79,  220, 135, 158, 42,  30,  154, 120, 67,  87,  167, 135,
-    176, 183, 191, 253, 115, 184, 21,  233, 58,  129, 233, 142, 39,  128, 211, 118, 137, 139,
-    255, 114, 20,  218, 113, 154, 27,  127, 246, 250, 1,   8,   198, 250, 209, 92,  222, 173,
-    21,  88,  102, 219
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NOISE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled in regardless of the build's target and only used when the CPU has it
+#if defined(NOISE_SSE2) && defined(__GNUC__)
+#define NOISE_AVX2
+#include <immintrin.h>
+#define NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+f64 time_now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return (f64)ts.tv_sec * 1000.0 + (f64)ts.tv_nsec / 1000000.0;
+}
+
+u64 hash_fnv1a(const void* data, usize size, u64 hash) {
+    const u8* bytes = data;
+
+    for (usize i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+const char* noise_isa_names[NOISE_ISA_COUNT] = {
+    "scalar",
+    "sse2",
+    "avx2",
+};
+
+// Gradients picked by the low bits of a corner's hash, per axis so they can be gathered
+// Products with them are exact, so every path computes the same dot products
+static const f32 g_noise_grad2d_x[8] = { 1, -1, 1, -1, 1, -1, 0, 0 };
+static const f32 g_noise_grad2d_y[8] = { 1, 1, -1, -1, 0, 0, 1, -1 };
+
+static const f32 g_noise_grad3d_x[16] = { 1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 1, 0, -1, 0 };
+static const f32 g_noise_grad3d_y[16] = {
+    1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1, 1, -1, 1, -1,
 };
+static const f32 g_noise_grad3d_z[16] = { 0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1, 0, 1, 0, -1 };
+
+static u64 noise_splitmix64(u64* state) {
+    u64 z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void noise_init(noise_t* noise, u64 seed) {
+    for (i32 i = 0; i < 256; i++) {
+        noise->perm[i] = i;
+    }
 
-static f32 fade(f32 t) {
-    return t * t * t * (t * (t * 6 - 15) + 10);
-}
-
-static f32 grad2d(i32 hash, f32 x, f32 y) {
-    switch (hash & 0x7) {
-        case 0x0:
-            return x + y;
-        case 0x1:
-            return -x + y;
-        case 0x2:
-            return x - y;
-        case 0x3:
-            return -x - y;
-        case 0x4:
-            return x;
-        case 0x5:
-            return -x;
-        case 0x6:
-            return y;
-        case 0x7:
-            return -y;
-        default:
-            return 0.0f;
+    u64 state = seed;
+    for (u32 i = 255; i > 0; i--) {
+        u32 j = (u32)(noise_splitmix64(&state) % (i + 1));
+        i32 swap = noise->perm[i];
+        noise->perm[i] = noise->perm[j];
+        noise->perm[j] = swap;
     }
+
+    memcpy(noise->perm + 256, noise->perm, sizeof(i32) * 256);
+
+    noise->isa = NOISE_ISA_SCALAR;
+#ifdef NOISE_SSE2
+    noise->isa = NOISE_ISA_SSE2;
+#endif
+#ifdef NOISE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        noise->isa = NOISE_ISA_AVX2;
+    }
+#endif
+}
+
+static f32 noise_fade(f32 t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static f32 noise_lerp(f32 from, f32 to, f32 t) {
+    return from + t * (to - from);
+}
+
+static f32 noise_grad2d(i32 hash, f32 x, f32 y) {
+    return g_noise_grad2d_x[hash & 7] * x + g_noise_grad2d_y[hash & 7] * y;
+}
+
+static f32 noise_grad3d(i32 hash, f32 x, f32 y, f32 z) {
+    return g_noise_grad3d_x[hash & 15] * x + g_noise_grad3d_y[hash & 15] * y +
+           g_noise_grad3d_z[hash & 15] * z;
+}
+
+// Hashes of the cell's corners, corner i is offset by (i & 1, i >> 1 & 1, i >> 2)
+static void noise_hash2d(const noise_t* noise, i32 xi, i32 yi, i32 hashes[4]) {
+    const i32* perm = noise->perm;
+    i32 a = perm[xi] + yi;
+    i32 b = perm[xi + 1] + yi;
+
+    hashes[0] = perm[a];
+    hashes[1] = perm[b];
+    hashes[2] = perm[a + 1];
+    hashes[3] = perm[b + 1];
+}
+
+static void noise_hash3d(const noise_t* noise, i32 xi, i32 yi, i32 zi, i32 hashes[8]) {
+    const i32* perm = noise->perm;
+    i32 a = perm[xi] + yi;
+    i32 b = perm[xi + 1] + yi;
+    i32 aa = perm[a] + zi;
+    i32 ab = perm[a + 1] + zi;
+    i32 ba = perm[b] + zi;
+    i32 bb = perm[b + 1] + zi;
+
+    hashes[0] = perm[aa];
+    hashes[1] = perm[ba];
+    hashes[2] = perm[ab];
+    hashes[3] = perm[bb];
+    hashes[4] = perm[aa + 1];
+    hashes[5] = perm[ba + 1];
+    hashes[6] = perm[ab + 1];
+    hashes[7] = perm[bb + 1];
+}
+
+f32 noise_perlin2d(const noise_t* noise, f32 x, f32 y) {
+    // coordinates are non-negative from here on, so truncating floors them
+    x = fabsf(x);
+    y = fabsf(y);
+
+    i32 xi = (i32)x;
+    i32 yi = (i32)y;
+    f32 xf = x - (f32)xi;
+    f32 yf = y - (f32)yi;
+
+    i32 hashes[4];
+    noise_hash2d(noise, xi & 255, yi & 255, hashes);
+
+    f32 u = noise_fade(xf);
+    f32 v = noise_fade(yf);
+
+    f32 x1 = noise_lerp(
+        noise_grad2d(hashes[0], xf, yf),
+        noise_grad2d(hashes[1], xf - 1.0f, yf),
+        u
+    );
+    f32 x2 = noise_lerp(
+        noise_grad2d(hashes[2], xf, yf - 1.0f),
+        noise_grad2d(hashes[3], xf - 1.0f, yf - 1.0f),
+        u
+    );
+
+    return (noise_lerp(x1, x2, v) + 1.0f) / 2.0f;
+}
+
+f32 noise_perlin3d(const noise_t* noise, f32 x, f32 y, f32 z) {
+    x = fabsf(x);
+    y = fabsf(y);
+    z = fabsf(z);
+
+    i32 xi = (i32)x;
+    i32 yi = (i32)y;
+    i32 zi = (i32)z;
+    f32 xf = x - (f32)xi;
+    f32 yf = y - (f32)yi;
+    f32 zf = z - (f32)zi;
+
+    i32 hashes[8];
+    noise_hash3d(noise, xi & 255, yi & 255, zi & 255, hashes);
+
+    f32 u = noise_fade(xf);
+    f32 v = noise_fade(yf);
+    f32 w = noise_fade(zf);
+
+    f32 x1 = noise_lerp(
+        noise_grad3d(hashes[0], xf, yf, zf),
+        noise_grad3d(hashes[1], xf - 1.0f, yf, zf),
+        u
+    );
+    f32 x2 = noise_lerp(
+        noise_grad3d(hashes[2], xf, yf - 1.0f, zf),
+        noise_grad3d(hashes[3], xf - 1.0f, yf - 1.0f, zf),
+        u
+    );
+    f32 y1 = noise_lerp(x1, x2, v);
+
+    x1 = noise_lerp(
+        noise_grad3d(hashes[4], xf, yf, zf - 1.0f),
+        noise_grad3d(hashes[5], xf - 1.0f, yf, zf - 1.0f),
+        u
+    );
+    x2 = noise_lerp(
+        noise_grad3d(hashes[6], xf, yf - 1.0f, zf - 1.0f),
+        noise_grad3d(hashes[7], xf - 1.0f, yf - 1.0f, zf - 1.0f),
+        u
+    );
+    f32 y2 = noise_lerp(x1, x2, v);
+
+    return (noise_lerp(y1, y2, w) + 1.0f) / 2.0f;
+}
+
+#ifdef NOISE_SSE2
+// The vector paths repeat the scalar arithmetic operation for operation, without FMA, so
+// they round the same way
+
+static __m128 noise_fade_sse2(__m128 t) {
+    __m128 inner = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+    inner = _mm_add_ps(_mm_mul_ps(t, inner), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+static __m128 noise_lerp_sse2(__m128 from, __m128 to, __m128 t) {
+    return _mm_add_ps(from, _mm_mul_ps(t, _mm_sub_ps(to, from)));
+}
+
+static __m128 noise_grad2d_sse2(const f32* gx, const f32* gy, __m128 x, __m128 y) {
+    return _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx), x), _mm_mul_ps(_mm_loadu_ps(gy), y));
 }
 
-static f32 grad3d(i32 hash, f32 x, f32 y, f32 z) {
-    switch (hash & 0xF) {
-        case 0x0:
-            return x + y;
-        case 0x1:
-            return -x + y;
-        case 0x2:
-            return x - y;
-        case 0x3:
-            return -x - y;
-        case 0x4:
-            return x + z;
-        case 0x5:
-            return -x + z;
-        case 0x6:
-            return x - z;
-        case 0x7:
-            return -x - z;
-        case 0x8:
-            return y + z;
-        case 0x9:
-            return -y + z;
-        case 0xA:
-            return y - z;
-        case 0xB:
-            return -y - z;
-        case 0xC:
-            return y + x;
-        case 0xD:
-            return -y + z;
-        case 0xE:
-            return y - x;
-        case 0xF:
-            return -y - z;
-        default:
-            return 0.0f;
+static __m128 noise_grad3d_sse2(const f32 g[3][4], __m128 x, __m128 y, __m128 z) {
+    __m128 gx = _mm_mul_ps(_mm_loadu_ps(g[0]), x);
+    __m128 gy = _mm_mul_ps(_mm_loadu_ps(g[1]), y);
+    return _mm_add_ps(_mm_add_ps(gx, gy), _mm_mul_ps(_mm_loadu_ps(g[2]), z));
+}
+
+// SSE2 has no gathers, the corner hashes are looked up one lane at a time
+static void noise_perlin2d_sse2(const noise_t* noise, const f32* x, const f32* y, f32* out) {
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vx = _mm_andnot_ps(sign, _mm_loadu_ps(x));
+    __m128 vy = _mm_andnot_ps(sign, _mm_loadu_ps(y));
+    __m128i ix = _mm_cvttps_epi32(vx);
+    __m128i iy = _mm_cvttps_epi32(vy);
+    __m128 xf = _mm_sub_ps(vx, _mm_cvtepi32_ps(ix));
+    __m128 yf = _mm_sub_ps(vy, _mm_cvtepi32_ps(iy));
+
+    __m128i mask = _mm_set1_epi32(255);
+    i32 xi[4];
+    i32 yi[4];
+    _mm_storeu_si128((__m128i*)xi, _mm_and_si128(ix, mask));
+    _mm_storeu_si128((__m128i*)yi, _mm_and_si128(iy, mask));
+
+    // [corner][lane]
+    f32 gx[4][4];
+    f32 gy[4][4];
+    for (u32 lane = 0; lane < 4; lane++) {
+        i32 hashes[4];
+        noise_hash2d(noise, xi[lane], yi[lane], hashes);
+        for (u32 corner = 0; corner < 4; corner++) {
+            gx[corner][lane] = g_noise_grad2d_x[hashes[corner] & 7];
+            gy[corner][lane] = g_noise_grad2d_y[hashes[corner] & 7];
+        }
     }
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 xf1 = _mm_sub_ps(xf, one);
+    __m128 yf1 = _mm_sub_ps(yf, one);
+    __m128 u = noise_fade_sse2(xf);
+    __m128 v = noise_fade_sse2(yf);
+
+    __m128 x1 = noise_lerp_sse2(
+        noise_grad2d_sse2(gx[0], gy[0], xf, yf),
+        noise_grad2d_sse2(gx[1], gy[1], xf1, yf),
+        u
+    );
+    __m128 x2 = noise_lerp_sse2(
+        noise_grad2d_sse2(gx[2], gy[2], xf, yf1),
+        noise_grad2d_sse2(gx[3], gy[3], xf1, yf1),
+        u
+    );
+
+    __m128 result = _mm_add_ps(noise_lerp_sse2(x1, x2, v), one);
+    _mm_storeu_ps(out, _mm_div_ps(result, _mm_set1_ps(2.0f)));
 }
 
-f32 perlin2d(f32 x, f32 y) {
-    if (x < 0) x = -x;
-    if (y < 0) y = -y;
+static void noise_perlin3d_sse2(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    const f32* z,
+    f32* out
+) {
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vx = _mm_andnot_ps(sign, _mm_loadu_ps(x));
+    __m128 vy = _mm_andnot_ps(sign, _mm_loadu_ps(y));
+    __m128 vz = _mm_andnot_ps(sign, _mm_loadu_ps(z));
+    __m128i ix = _mm_cvttps_epi32(vx);
+    __m128i iy = _mm_cvttps_epi32(vy);
+    __m128i iz = _mm_cvttps_epi32(vz);
+    __m128 xf = _mm_sub_ps(vx, _mm_cvtepi32_ps(ix));
+    __m128 yf = _mm_sub_ps(vy, _mm_cvtepi32_ps(iy));
+    __m128 zf = _mm_sub_ps(vz, _mm_cvtepi32_ps(iz));
+
+    __m128i mask = _mm_set1_epi32(255);
+    i32 xi[4];
+    i32 yi[4];
+    i32 zi[4];
+    _mm_storeu_si128((__m128i*)xi, _mm_and_si128(ix, mask));
+    _mm_storeu_si128((__m128i*)yi, _mm_and_si128(iy, mask));
+    _mm_storeu_si128((__m128i*)zi, _mm_and_si128(iz, mask));
+
+    // [corner][axis][lane]
+    f32 g[8][3][4];
+    for (u32 lane = 0; lane < 4; lane++) {
+        i32 hashes[8];
+        noise_hash3d(noise, xi[lane], yi[lane], zi[lane], hashes);
+        for (u32 corner = 0; corner < 8; corner++) {
+            g[corner][0][lane] = g_noise_grad3d_x[hashes[corner] & 15];
+            g[corner][1][lane] = g_noise_grad3d_y[hashes[corner] & 15];
+            g[corner][2][lane] = g_noise_grad3d_z[hashes[corner] & 15];
+        }
+    }
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 xf1 = _mm_sub_ps(xf, one);
+    __m128 yf1 = _mm_sub_ps(yf, one);
+    __m128 zf1 = _mm_sub_ps(zf, one);
+    __m128 u = noise_fade_sse2(xf);
+    __m128 v = noise_fade_sse2(yf);
+    __m128 w = noise_fade_sse2(zf);
+
+    __m128 x1 = noise_lerp_sse2(
+        noise_grad3d_sse2(g[0], xf, yf, zf),
+        noise_grad3d_sse2(g[1], xf1, yf, zf),
+        u
+    );
+    __m128 x2 = noise_lerp_sse2(
+        noise_grad3d_sse2(g[2], xf, yf1, zf),
+        noise_grad3d_sse2(g[3], xf1, yf1, zf),
+        u
+    );
+    __m128 y1 = noise_lerp_sse2(x1, x2, v);
+
+    x1 = noise_lerp_sse2(
+        noise_grad3d_sse2(g[4], xf, yf, zf1),
+        noise_grad3d_sse2(g[5], xf1, yf, zf1),
+        u
+    );
+    x2 = noise_lerp_sse2(
+        noise_grad3d_sse2(g[6], xf, yf1, zf1),
+        noise_grad3d_sse2(g[7], xf1, yf1, zf1),
+        u
+    );
+    __m128 y2 = noise_lerp_sse2(x1, x2, v);
 
-    i32 xi = posmod((i32)x, 256);
-    i32 yi = posmod((i32)y, 256);
+    __m128 result = _mm_add_ps(noise_lerp_sse2(y1, y2, w), one);
+    _mm_storeu_ps(out, _mm_div_ps(result, _mm_set1_ps(2.0f)));
+}
+#endif
 
-    f32 xf = x - floorf(x);
-    f32 yf = y - floorf(y);
+#ifdef NOISE_AVX2
+NOISE_TARGET_AVX2 static __m256 noise_fade_avx2(__m256 t) {
+    __m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+    inner = _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
 
-    f32 u = fade(xf);
-    f32 v = fade(yf);
+NOISE_TARGET_AVX2 static __m256 noise_lerp_avx2(__m256 from, __m256 to, __m256 t) {
+    return _mm256_add_ps(from, _mm256_mul_ps(t, _mm256_sub_ps(to, from)));
+}
 
-    i32 aa = g_perm[(g_perm[xi] + yi) % 256];
-    i32 ab = g_perm[(g_perm[xi] + yi + 1) % 256];
-    i32 ba = g_perm[(g_perm[(xi + 1) % 256] + yi) % 256];
-    i32 bb = g_perm[(g_perm[(xi + 1) % 256] + yi + 1) % 256];
+NOISE_TARGET_AVX2 static __m256i noise_perm_avx2(const noise_t* noise, __m256i index) {
+    return _mm256_i32gather_epi32(noise->perm, index, 4);
+}
 
-    f32 x1 = glm_lerp(grad2d(g_perm[aa], xf, yf), grad2d(g_perm[ba], xf - 1, yf), u);
-    f32 x2 = glm_lerp(grad2d(g_perm[ab], xf, yf - 1), grad2d(g_perm[bb], xf - 1, yf - 1), u);
+NOISE_TARGET_AVX2 static __m256 noise_grad2d_avx2(__m256i hash, __m256 x, __m256 y) {
+    __m256i index = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+    __m256 gx = _mm256_i32gather_ps(g_noise_grad2d_x, index, 4);
+    __m256 gy = _mm256_i32gather_ps(g_noise_grad2d_y, index, 4);
+    return _mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y));
+}
 
-    return (glm_lerp(x1, x2, v) + 1) / 2;
+NOISE_TARGET_AVX2 static __m256 noise_grad3d_avx2(__m256i hash, __m256 x, __m256 y, __m256 z) {
+    __m256i index = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    __m256 gx = _mm256_i32gather_ps(g_noise_grad3d_x, index, 4);
+    __m256 gy = _mm256_i32gather_ps(g_noise_grad3d_y, index, 4);
+    __m256 gz = _mm256_i32gather_ps(g_noise_grad3d_z, index, 4);
+    __m256 xy = _mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y));
+    return _mm256_add_ps(xy, _mm256_mul_ps(gz, z));
 }
 
-f32 perlin3d(f32 x, f32 y, f32 z) {
-    if (x < 0) x = -x;
-    if (y < 0) y = -y;
-    if (z < 0) z = -z;
+NOISE_TARGET_AVX2 static void noise_perlin2d_avx2(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    f32* out
+) {
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 vx = _mm256_andnot_ps(sign, _mm256_loadu_ps(x));
+    __m256 vy = _mm256_andnot_ps(sign, _mm256_loadu_ps(y));
+    __m256i ix = _mm256_cvttps_epi32(vx);
+    __m256i iy = _mm256_cvttps_epi32(vy);
+    __m256 xf = _mm256_sub_ps(vx, _mm256_cvtepi32_ps(ix));
+    __m256 yf = _mm256_sub_ps(vy, _mm256_cvtepi32_ps(iy));
+
+    __m256i mask = _mm256_set1_epi32(255);
+    __m256i one_i = _mm256_set1_epi32(1);
+    ix = _mm256_and_si256(ix, mask);
+    iy = _mm256_and_si256(iy, mask);
+
+    __m256i a = _mm256_add_epi32(noise_perm_avx2(noise, ix), iy);
+    __m256i b = _mm256_add_epi32(noise_perm_avx2(noise, _mm256_add_epi32(ix, one_i)), iy);
+
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 xf1 = _mm256_sub_ps(xf, one);
+    __m256 yf1 = _mm256_sub_ps(yf, one);
+    __m256 u = noise_fade_avx2(xf);
+    __m256 v = noise_fade_avx2(yf);
+
+    __m256 x1 = noise_lerp_avx2(
+        noise_grad2d_avx2(noise_perm_avx2(noise, a), xf, yf),
+        noise_grad2d_avx2(noise_perm_avx2(noise, b), xf1, yf),
+        u
+    );
+    __m256 x2 = noise_lerp_avx2(
+        noise_grad2d_avx2(noise_perm_avx2(noise, _mm256_add_epi32(a, one_i)), xf, yf1),
+        noise_grad2d_avx2(noise_perm_avx2(noise, _mm256_add_epi32(b, one_i)), xf1, yf1),
+        u
+    );
 
-    i32 xi = posmod((i32)x, 256);
-    i32 yi = posmod((i32)y, 256);
-    i32 zi = posmod((i32)z, 256);
+    __m256 result = _mm256_add_ps(noise_lerp_avx2(x1, x2, v), one);
+    _mm256_storeu_ps(out, _mm256_div_ps(result, _mm256_set1_ps(2.0f)));
+}
 
-    f32 xf = x - floorf(x);
-    f32 yf = y - floorf(y);
-    f32 zf = z - floorf(z);
+NOISE_TARGET_AVX2 static void noise_perlin3d_avx2(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    const f32* z,
+    f32* out
+) {
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 vx = _mm256_andnot_ps(sign, _mm256_loadu_ps(x));
+    __m256 vy = _mm256_andnot_ps(sign, _mm256_loadu_ps(y));
+    __m256 vz = _mm256_andnot_ps(sign, _mm256_loadu_ps(z));
+    __m256i ix = _mm256_cvttps_epi32(vx);
+    __m256i iy = _mm256_cvttps_epi32(vy);
+    __m256i iz = _mm256_cvttps_epi32(vz);
+    __m256 xf = _mm256_sub_ps(vx, _mm256_cvtepi32_ps(ix));
+    __m256 yf = _mm256_sub_ps(vy, _mm256_cvtepi32_ps(iy));
+    __m256 zf = _mm256_sub_ps(vz, _mm256_cvtepi32_ps(iz));
 
-    f32 u = fade(xf);
-    f32 v = fade(yf);
-    f32 w = fade(zf);
+    __m256i mask = _mm256_set1_epi32(255);
+    __m256i one_i = _mm256_set1_epi32(1);
+    ix = _mm256_and_si256(ix, mask);
+    iy = _mm256_and_si256(iy, mask);
+    iz = _mm256_and_si256(iz, mask);
 
-    i32 aaa = g_perm[(g_perm[(g_perm[xi] + yi) % 256] + zi) % 256];
-    i32 aba = g_perm[(g_perm[(g_perm[xi] + yi + 1) % 256] + zi) % 256];
-    i32 aab = g_perm[(g_perm[(g_perm[xi] + yi) % 256] + zi + 1) % 256];
-    i32 abb = g_perm[(g_perm[(g_perm[xi] + yi + 1) % 256] + zi + 1) % 256];
-    i32 baa = g_perm[(g_perm[(g_perm[xi + 1] + yi) % 256] + zi) % 256];
-    i32 bba = g_perm[(g_perm[(g_perm[xi + 1] + yi + 1) % 256] + zi) % 256];
-    i32 bab = g_perm[(g_perm[(g_perm[xi + 1] + yi) % 256] + zi + 1) % 256];
-    i32 bbb = g_perm[(g_perm[(g_perm[xi + 1] + yi + 1) % 256] + zi + 1) % 256];
+    __m256i a = _mm256_add_epi32(noise_perm_avx2(noise, ix), iy);
+    __m256i b = _mm256_add_epi32(noise_perm_avx2(noise, _mm256_add_epi32(ix, one_i)), iy);
+    __m256i aa = _mm256_add_epi32(noise_perm_avx2(noise, a), iz);
+    __m256i ab = _mm256_add_epi32(noise_perm_avx2(noise, _mm256_add_epi32(a, one_i)), iz);
+    __m256i ba = _mm256_add_epi32(noise_perm_avx2(noise, b), iz);
+    __m256i bb = _mm256_add_epi32(noise_perm_avx2(noise, _mm256_add_epi32(b, one_i)), iz);
 
-    f32 x1 = glm_lerp(grad3d(g_perm[aaa], xf, yf, zf), grad3d(g_perm[baa], xf - 1, yf, zf), u);
-    f32 x2 = glm_lerp(
-        grad3d(g_perm[aba], xf, yf - 1, zf),
-        grad3d(g_perm[bba], xf - 1, yf - 1, zf),
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 xf1 = _mm256_sub_ps(xf, one);
+    __m256 yf1 = _mm256_sub_ps(yf, one);
+    __m256 zf1 = _mm256_sub_ps(zf, one);
+    __m256 u = noise_fade_avx2(xf);
+    __m256 v = noise_fade_avx2(yf);
+    __m256 w = noise_fade_avx2(zf);
+
+    __m256 x1 = noise_lerp_avx2(
+        noise_grad3d_avx2(noise_perm_avx2(noise, aa), xf, yf, zf),
+        noise_grad3d_avx2(noise_perm_avx2(noise, ba), xf1, yf, zf),
+        u
+    );
+    __m256 x2 = noise_lerp_avx2(
+        noise_grad3d_avx2(noise_perm_avx2(noise, ab), xf, yf1, zf),
+        noise_grad3d_avx2(noise_perm_avx2(noise, bb), xf1, yf1, zf),
         u
     );
-    f32 y1 = glm_lerp(x1, x2, v);
+    __m256 y1 = noise_lerp_avx2(x1, x2, v);
 
-    x1 = glm_lerp(
-        grad3d(g_perm[aab], xf, yf, zf - 1),
-        grad3d(g_perm[bab], xf - 1, yf, zf - 1),
+    aa = _mm256_add_epi32(aa, one_i);
+    ab = _mm256_add_epi32(ab, one_i);
+    ba = _mm256_add_epi32(ba, one_i);
+    bb = _mm256_add_epi32(bb, one_i);
+    x1 = noise_lerp_avx2(
+        noise_grad3d_avx2(noise_perm_avx2(noise, aa), xf, yf, zf1),
+        noise_grad3d_avx2(noise_perm_avx2(noise, ba), xf1, yf, zf1),
         u
     );
-    x2 = glm_lerp(
-        grad3d(g_perm[abb], xf, yf - 1, zf - 1),
-        grad3d(g_perm[bbb], xf - 1, yf - 1, zf - 1),
+    x2 = noise_lerp_avx2(
+        noise_grad3d_avx2(noise_perm_avx2(noise, ab), xf, yf1, zf1),
+        noise_grad3d_avx2(noise_perm_avx2(noise, bb), xf1, yf1, zf1),
         u
     );
-    f32 y2 = glm_lerp(x1, x2, v);
+    __m256 y2 = noise_lerp_avx2(x1, x2, v);
+
+    __m256 result = _mm256_add_ps(noise_lerp_avx2(y1, y2, w), one);
+    _mm256_storeu_ps(out, _mm256_div_ps(result, _mm256_set1_ps(2.0f)));
+}
+#endif
+
+void noise_perlin2d_batch(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    f32* out,
+    u32 count
+) {
+    u32 i = 0;
+
+#ifdef NOISE_AVX2
+    if (noise->isa >= NOISE_ISA_AVX2) {
+        for (; i + 8 <= count; i += 8) {
+            noise_perlin2d_avx2(noise, x + i, y + i, out + i);
+        }
+    }
+#endif
+#ifdef NOISE_SSE2
+    if (noise->isa >= NOISE_ISA_SSE2) {
+        for (; i + 4 <= count; i += 4) {
+            noise_perlin2d_sse2(noise, x + i, y + i, out + i);
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = noise_perlin2d(noise, x[i], y[i]);
+    }
+}
+
+void noise_perlin3d_batch(
+    const noise_t* noise,
+    const f32* x,
+    const f32* y,
+    const f32* z,
+    f32* out,
+    u32 count
+) {
+    u32 i = 0;
+
+#ifdef NOISE_AVX2
+    if (noise->isa >= NOISE_ISA_AVX2) {
+        for (; i + 8 <= count; i += 8) {
+            noise_perlin3d_avx2(noise, x + i, y + i, z + i, out + i);
+        }
+    }
+#endif
+#ifdef NOISE_SSE2
+    if (noise->isa >= NOISE_ISA_SSE2) {
+        for (; i + 4 <= count; i += 4) {
+            noise_perlin3d_sse2(noise, x + i, y + i, z + i, out + i);
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = noise_perlin3d(noise, x[i], y[i], z[i]);
+    }
+}
+
+void noise_bench(u32 samples) {
+    noise_t noise;
+    noise_init(&noise, 1);
+    noise_isa_t best = noise.isa;
+
+    LOG_INFO("Noise benchmark: %u samples, best isa %s\n", samples, noise_isa_names[best]);
+
+    // terrain-like coordinates, both signs and a spread of cells
+    f32* x = malloc(sizeof(f32) * samples);
+    f32* y = malloc(sizeof(f32) * samples);
+    f32* z = malloc(sizeof(f32) * samples);
+    f32* expected = malloc(sizeof(f32) * samples);
+    f32* out = malloc(sizeof(f32) * samples);
+
+    u64 state = 42;
+    for (u32 i = 0; i < samples; i++) {
+        x[i] = (f32)(noise_splitmix64(&state) % 200000) * 0.01f - 1000.0f;
+        y[i] = (f32)(noise_splitmix64(&state) % 20000) * 0.01f - 100.0f;
+        z[i] = (f32)(noise_splitmix64(&state) % 200000) * 0.01f - 1000.0f;
+    }
+
+    for (u32 dimensions = 2; dimensions <= 3; dimensions++) {
+        f64 start = time_now_ms();
+        for (u32 i = 0; i < samples; i++) {
+            expected[i] = dimensions == 2 ? noise_perlin2d(&noise, x[i], z[i])
+                                          : noise_perlin3d(&noise, x[i], y[i], z[i]);
+        }
+        f64 single_ms = time_now_ms() - start;
+        LOG_INFO(
+            "  perlin%ud single point: %.1f M samples/s\n",
+            dimensions,
+            (f64)samples / single_ms / 1000.0
+        );
+
+        for (u32 isa = 0; isa <= best; isa++) {
+            noise.isa = (noise_isa_t)isa;
+
+            start = time_now_ms();
+            if (dimensions == 2) {
+                noise_perlin2d_batch(&noise, x, z, out, samples);
+            } else {
+                noise_perlin3d_batch(&noise, x, y, z, out, samples);
+            }
+            f64 batch_ms = time_now_ms() - start;
+
+            LOG_INFO(
+                "  perlin%ud batch %-6s: %.1f M samples/s, %s\n",
+                dimensions,
+                noise_isa_names[isa],
+                (f64)samples / batch_ms / 1000.0,
+                memcmp(out, expected, sizeof(f32) * samples) == 0 ? "bit-identical"
+                                                                   : "MISMATCH"
+            );
+        }
+        noise.isa = best;
+    }
 
-    return (glm_lerp(y1, y2, w) + 1) / 2;
+    free(x);
+    free(y);
+    free(z);
+    free(expected);
+    free(out);
 }
@@ -6,7 +6,7 @@
 #include "glm_extra.h"
 #include "log.h"
 #include "mesh.h"
-#include "player.h"
+#include "profile.h"
 #include "shader.h"
 #include "utils.h"
 
@@ -17,10 +17,14 @@
 #include <cglm/types.h>
 #include <cglm/vec3.h>
 #include <math.h>
+#include <stb_image_write.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Seeded by world_generator_init, read only while chunks generate
+static noise_t g_world_noise;
+
 block_flags_t block_flags[BLOCK_ID_MAX] = {
     // BLOCK_ID_AIR
     (block_flags_t)BLOCK_FLAG_TRANSPARENT,
@@ -37,21 +41,132 @@ block_flags_t block_flags[BLOCK_ID_MAX] = {
     (block_flags_t)(BLOCK_FLAG_SOLID | BLOCK_FLAG_MESHED | BLOCK_FLAG_TRANSPARENT),
 };
 
+// Highest solid block of the chunk at block column (x, z) in world space
+static i32 chunk_column_top(const chunk_t* chunk, i32 x, i32 z) {
+    for (i32 y = CHUNK_SIZE - 1; y >= 0; y--) {
+        if (block_flags[chunk->blocks[CHUNK_POS_TO_INDEX(x, y, z)].id] & BLOCK_FLAG_SOLID) {
+            return y + chunk->position[1] * CHUNK_SIZE;
+        }
+    }
+    return WORLD_COLUMN_NO_TOP;
+}
+
+world_column_t* world_get_column(world_t* world, i32 x, i32 z) {
+    for (u32 i = 0; i < world->column_count; i++) {
+        if (world->columns[i].x == x && world->columns[i].z == z) {
+            return &world->columns[i];
+        }
+    }
+    return NULL;
+}
+
+// Count the chunk in slot one more chunk of the column at (x, z), generating the column's
+// heights if it's new
+static world_column_t* world_column_acquire(world_t* world, u32 slot, i32 x, i32 z) {
+    world_column_t* column = world_get_column(world, x, z);
+    if (!column) {
+        // every column has a loaded chunk, so they can't outnumber the chunk slots
+        assert(world->column_count < MAX_LOADED_CHUNKS);
+        column = &world->columns[world->column_count++];
+        column->x = x;
+        column->z = z;
+        column->chunk_count = 0;
+        column->first_slot = WORLD_COLUMN_END;
+        world_generate_terrain_height(x, z, column->terrain_height);
+        for (u32 i = 0; i < WORLD_COLUMN_AREA; i++) {
+            column->top[i] = WORLD_COLUMN_NO_TOP;
+        }
+    }
+
+    world->chunk_slot_column_next[slot] = column->first_slot;
+    column->first_slot = slot;
+    column->chunk_count++;
+    return column;
+}
+
+// Raise the column's tops to the blocks of a newly loaded chunk
+static void world_column_add_chunk(world_column_t* column, const chunk_t* chunk) {
+    for (i32 z = 0; z < CHUNK_SIZE; z++) {
+        for (i32 x = 0; x < CHUNK_SIZE; x++) {
+            i32 top = chunk_column_top(chunk, x, z);
+            if (top > column->top[x + z * CHUNK_SIZE]) {
+                column->top[x + z * CHUNK_SIZE] = top;
+            }
+        }
+    }
+}
+
+// Find the top of block column (x, z) again from the column's loaded chunks
+static void world_column_rescan(world_t* world, world_column_t* column, i32 x, i32 z) {
+    i32 top = WORLD_COLUMN_NO_TOP;
+    for (u32 i = column->first_slot; i != WORLD_COLUMN_END;
+         i = world->chunk_slot_column_next[i]) {
+        const chunk_t* chunk = &world->chunks[i];
+        if ((chunk->position[1] + 1) * CHUNK_SIZE <= top) {
+            continue;
+        }
+
+        i32 chunk_top = chunk_column_top(chunk, x, z);
+        if (chunk_top > top) {
+            top = chunk_top;
+        }
+    }
+    column->top[x + z * CHUNK_SIZE] = top;
+}
+
+// Stop counting an unloading chunk in its column, dropping the column with its last chunk
+static void world_column_release(world_t* world, const chunk_t* chunk) {
+    world_column_t* column = world_get_column(world, chunk->position[0], chunk->position[2]);
+    if (!column) {
+        return;
+    }
+
+    if (--column->chunk_count == 0) {
+        *column = world->columns[--world->column_count];
+        return;
+    }
+
+    // unlinked first, so the rescans below no longer see it
+    u32 slot = (u32)(chunk - world->chunks);
+    u32* link = &column->first_slot;
+    while (*link != slot) {
+        link = &world->chunk_slot_column_next[*link];
+    }
+    *link = world->chunk_slot_column_next[slot];
+
+    i32 bottom = chunk->position[1] * CHUNK_SIZE;
+    for (i32 z = 0; z < CHUNK_SIZE; z++) {
+        for (i32 x = 0; x < CHUNK_SIZE; x++) {
+            i32 top = column->top[x + z * CHUNK_SIZE];
+            if (top >= bottom && top < bottom + CHUNK_SIZE) {
+                world_column_rescan(world, column, x, z);
+            }
+        }
+    }
+}
+
 void chunk_init(chunk_t* chunk, world_t* world, ivec3 position) {
+    world_column_t* column =
+        world_column_acquire(world, (u32)(chunk - world->chunks), position[0], position[2]);
+    chunk_load_blocks(chunk, position, column->terrain_height);
+    world_column_add_chunk(column, chunk);
+    chunk_mesh(chunk, world);
+}
+
+void chunk_load_blocks(chunk_t* chunk, ivec3 position, const i32* terrain_height) {
+    PROFILE_SCOPE_CHUNK("chunk_load_blocks", position);
     glm_ivec3_copy(position, chunk->position);
     chunk->save_dirty = false;
     bool is_new_chunk = true;
 
-    for (size_t i = 0; i < g_save->world.chunk_count; i++) {
-        world_save_chunk_t* save_chunk = &g_save->world.chunks[i];
-        if (position[0] == save_chunk->x && position[1] == save_chunk->y &&
-            position[2] == save_chunk->z) {
-            is_new_chunk = false;
+    // raw chunks come straight from their region mapping, compressed ones via scratch
+    block_id_t scratch[CHUNK_BLOCK_COUNT];
+    const block_id_t* saved_blocks = save_get_chunk_blocks(g_save, position, scratch);
+    if (saved_blocks) {
+        is_new_chunk = false;
 
-            for (size_t j = 0; j < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; j++) {
-                chunk->blocks[j].id = save_chunk->block_data[j];
-            }
-            break;
+        for (size_t j = 0; j < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; j++) {
+            chunk->blocks[j].id = saved_blocks[j];
         }
     }
 
@@ -59,60 +174,383 @@ void chunk_init(chunk_t* chunk, world_t* world, ivec3 position) {
         for (int i = 0; i < CHUNK_SIZE; i++) {
             chunk->blocks[i] = (block_t){ .id = BLOCK_AIR };
         }
-        chunk_generate(chunk);
+        chunk_generate(chunk, terrain_height);
     }
 
     chunk->mesh.vertices = NULL;
     chunk->mesh.indices = NULL;
-
-    chunk_mesh(chunk, world);
 }
+
 void chunk_forget(chunk_t* chunk) {
     if (g_save != NULL && chunk->save_dirty) {
         save_add_chunk(g_save, chunk);
+        chunk->save_dirty = false;
     }
     chunk_forget_mesh(chunk);
     free(chunk->mesh.vertices);
     free(chunk->mesh.indices);
 }
 
-void chunk_generate(chunk_t* chunk) {
-    for (i32 x = 0; x < CHUNK_SIZE; x++) {
+void chunk_generate(chunk_t* chunk, const i32* terrain_height) {
+    PROFILE_SCOPE_CHUNK("chunk_generate", chunk->position);
+    block_id_t blocks[CHUNK_BLOCK_COUNT];
+    chunk_generate_blocks(chunk->position, terrain_height, blocks);
+
+    for (u32 i = 0; i < CHUNK_BLOCK_COUNT; i++) {
+        chunk->blocks[i].id = blocks[i];
+    }
+}
+
+void world_generator_init(u64 seed) {
+    noise_init(&g_world_noise, seed);
+}
+
+void world_generate_terrain_height(i32 x, i32 z, i32 terrain_height[WORLD_COLUMN_AREA]) {
+    // noise is sampled a row of x at a time, so the batch functions get whole rows
+    f32 detail_x[CHUNK_SIZE];
+    f32 detail_z[CHUNK_SIZE];
+    f32 hills_x[CHUNK_SIZE];
+    f32 hills_z[CHUNK_SIZE];
+    f32 detail[CHUNK_SIZE];
+    f32 hills[CHUNK_SIZE];
+
+    for (i32 block_z = 0; block_z < CHUNK_SIZE; block_z++) {
+        f32 realz = (f32)(block_z + z * CHUNK_SIZE);
+
+        for (i32 block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+            f32 realx = (f32)(block_x + x * CHUNK_SIZE);
+            detail_x[block_x] = realx * 0.05f;
+            detail_z[block_x] = realz * 0.05f;
+            hills_x[block_x] = realx * 0.01f;
+            hills_z[block_x] = realz * 0.01f;
+        }
+        noise_perlin2d_batch(&g_world_noise, detail_x, detail_z, detail, CHUNK_SIZE);
+        noise_perlin2d_batch(&g_world_noise, hills_x, hills_z, hills, CHUNK_SIZE);
+
+        for (i32 block_x = 0; block_x < CHUNK_SIZE; block_x++) {
+            terrain_height[block_x + block_z * CHUNK_SIZE] =
+                10 + (i32)(detail[block_x] * 10.0f) + (i32)(hills[block_x] * 30.0f);
+        }
+    }
+}
+
+// Block at world_y of a block column whose surface is at height
+static block_id_t world_generate_block(i32 world_y, i32 height, f32 cave_noise) {
+    i32 rock_height = height - 5;
+
+    float cave_factor = 0.4f;
+
+    if (world_y > height - 10) {
+        cave_factor = 0.4f + ((float)world_y - ((float)height - 10)) * 0.06f;
+    }
+
+    if (cave_noise > cave_factor) {
+        return BLOCK_AIR;
+    } else if (world_y == height) {
+        return 3;
+    } else if (world_y < rock_height) {
+        return 1;
+    } else if (world_y < height) {
+        return 2;
+    } else {
+        return BLOCK_AIR;
+    }
+}
+
+// Generator version 2, cave noise sampled at every block, for world_generator_bench
+static void chunk_generate_blocks_reference(
+    ivec3 position,
+    const i32* terrain_height,
+    block_id_t blocks[CHUNK_BLOCK_COUNT]
+) {
+    f32 row_x[CHUNK_SIZE];
+    f32 row_y[CHUNK_SIZE];
+    f32 row_z[CHUNK_SIZE];
+    f32 cave_noise[CHUNK_SIZE];
+
+    for (i32 z = 0; z < CHUNK_SIZE; z++) {
+        const i32* height = &terrain_height[z * CHUNK_SIZE];
+        f32 realz = (f32)(z + position[2] * CHUNK_SIZE);
+
+        for (i32 x = 0; x < CHUNK_SIZE; x++) {
+            f32 realx = (f32)(x + position[0] * CHUNK_SIZE);
+            row_x[x] = realx * 0.1f;
+            row_z[x] = realz * 0.1f;
+        }
+
+        for (i32 y = 0; y < CHUNK_SIZE; y++) {
+            i32 world_y = y + position[1] * CHUNK_SIZE;
+
+            for (i32 x = 0; x < CHUNK_SIZE; x++) {
+                row_y[x] = (f32)world_y * 0.1f;
+            }
+            noise_perlin3d_batch(&g_world_noise, row_x, row_y, row_z, cave_noise, CHUNK_SIZE);
+
+            for (i32 x = 0; x < CHUNK_SIZE; x++) {
+                blocks[CHUNK_POS_TO_INDEX(x, y, z)] =
+                    world_generate_block(world_y, height[x], cave_noise[x]);
+            }
+        }
+    }
+}
+
+void chunk_generate_blocks(
+    ivec3 position,
+    const i32* terrain_height,
+    block_id_t blocks[CHUNK_BLOCK_COUNT]
+) {
+    i32 generated_height[WORLD_COLUMN_AREA];
+    if (!terrain_height) {
+        world_generate_terrain_height(position[0], position[2], generated_height);
+        terrain_height = generated_height;
+    }
+
+    i32 min_height = INT32_MAX;
+    i32 max_height = INT32_MIN;
+    for (u32 i = 0; i < WORLD_COLUMN_AREA; i++) {
+        min_height = terrain_height[i] < min_height ? terrain_height[i] : min_height;
+        max_height = terrain_height[i] > max_height ? terrain_height[i] : max_height;
+    }
+
+    // blocks above the surface are air whatever the caves do
+    i32 bottom = position[1] * CHUNK_SIZE;
+    if (bottom > max_height) {
+        memset(blocks, BLOCK_AIR, CHUNK_BLOCK_COUNT);
+        return;
+    }
+
+    // Cave density on the lattice points of the chunk, including its far faces, so
+    // neighbours sample the same points. Layers wholly above the surface are skipped.
+    const i32 LATTICE = WORLD_CAVE_LATTICE_SPACING;
+    const i32 POINTS = WORLD_CAVE_LATTICE_POINTS;
+    i32 layer_count = (max_height - bottom) / LATTICE + 2;
+    layer_count = layer_count < POINTS ? layer_count : POINTS;
+    u32 point_count = (u32)(layer_count * POINTS * POINTS);
+
+    f32 lattice_x[WORLD_CAVE_LATTICE_COUNT];
+    f32 lattice_y[WORLD_CAVE_LATTICE_COUNT];
+    f32 lattice_z[WORLD_CAVE_LATTICE_COUNT];
+    f32 lattice[WORLD_CAVE_LATTICE_COUNT];
+
+    // indexed x + z * POINTS + y * POINTS * POINTS, so a layer is contiguous
+    u32 point = 0;
+    for (i32 y = 0; y < layer_count; y++) {
+        for (i32 z = 0; z < POINTS; z++) {
+            for (i32 x = 0; x < POINTS; x++) {
+                lattice_x[point] = (f32)(x * LATTICE + position[0] * CHUNK_SIZE) * 0.1f;
+                lattice_y[point] = (f32)(y * LATTICE + bottom) * 0.1f;
+                lattice_z[point] = (f32)(z * LATTICE + position[2] * CHUNK_SIZE) * 0.1f;
+                point++;
+            }
+        }
+    }
+    noise_perlin3d_batch(&g_world_noise, lattice_x, lattice_y, lattice_z, lattice, point_count);
+
+    // deep enough that every block is stone or cave
+    bool below = bottom + CHUNK_SIZE - 1 <= min_height - 10;
+
+    for (i32 y = 0; y < CHUNK_SIZE; y++) {
+        i32 world_y = bottom + y;
+        i32 cell_y = y / LATTICE;
+        f32 ty = (f32)(y % LATTICE) / (f32)LATTICE;
+
+        if (cell_y + 1 >= layer_count) {
+            // above the highest surface in the chunk
+            for (i32 z = 0; z < CHUNK_SIZE; z++) {
+                memset(&blocks[CHUNK_POS_TO_INDEX(0, y, z)], BLOCK_AIR, CHUNK_SIZE);
+            }
+            continue;
+        }
+
+        const f32* low = &lattice[cell_y * POINTS * POINTS];
+        const f32* high = low + POINTS * POINTS;
+
         for (i32 z = 0; z < CHUNK_SIZE; z++) {
-            f32 realx = (f32)(x + chunk->position[0] * CHUNK_SIZE);
-            f32 realz = (f32)(z + chunk->position[2] * CHUNK_SIZE);
+            i32 cell_z = z / LATTICE;
+            f32 tz = (f32)(z % LATTICE) / (f32)LATTICE;
+
+            // the four lattice edges along x around this row, interpolated in y and z
+            f32 edge[2][WORLD_CAVE_LATTICE_POINTS];
+            for (i32 x = 0; x < POINTS; x++) {
+                for (i32 side = 0; side < 2; side++) {
+                    i32 index = x + (cell_z + side) * POINTS;
+                    edge[side][x] = low[index] + ty * (high[index] - low[index]);
+                }
+            }
 
-            i32 height = 10 + (int)(perlin2d(realx * 0.05f, realz * 0.05f) * 10.0f) +
-                         (int)(perlin2d(realx * 0.01f, realz * 0.01f) * 30.0f);
+            const i32* height = &terrain_height[z * CHUNK_SIZE];
+            for (i32 x = 0; x < CHUNK_SIZE; x++) {
+                i32 cell_x = x / LATTICE;
+                f32 tx = (f32)(x % LATTICE) / (f32)LATTICE;
 
-            i32 rock_height = height - 5;
+                f32 near = edge[0][cell_x] + tx * (edge[0][cell_x + 1] - edge[0][cell_x]);
+                f32 far = edge[1][cell_x] + tx * (edge[1][cell_x + 1] - edge[1][cell_x]);
+                f32 cave_noise = near + tz * (far - near);
 
-            for (i32 y = 0; y < CHUNK_SIZE; y++) {
                 i32 index = CHUNK_POS_TO_INDEX(x, y, z);
-                i32 world_y = y + chunk->position[1] * CHUNK_SIZE;
+                if (below) {
+                    blocks[index] = cave_noise > 0.4f ? BLOCK_AIR : 1;
+                } else {
+                    blocks[index] = world_generate_block(world_y, height[x], cave_noise);
+                }
+            }
+        }
+    }
+}
 
-                float cave_noise = perlin3d(realx * 0.1f, (f32)world_y * 0.1f, realz * 0.1f);
+// Highest solid block of a bench column stack, -1 if there is none
+static i32 world_generator_bench_surface(const block_id_t* stack, i32 x, i32 z) {
+    for (i32 y = WORLD_GENERATOR_BENCH_HEIGHT * CHUNK_SIZE - 1; y >= 0; y--) {
+        const block_id_t* chunk = stack + (usize)(y / CHUNK_SIZE) * CHUNK_BLOCK_COUNT;
+        if (block_flags[chunk[CHUNK_POS_TO_INDEX(x, y % CHUNK_SIZE, z)]] & BLOCK_FLAG_SOLID) {
+            return y;
+        }
+    }
+    return -1;
+}
 
-                float cave_factor = 0.4f;
+void world_generator_bench(u32 chunk_count, const char* image_path) {
+    world_generator_init(0);
 
-                if (world_y > height - 10) {
-                    cave_factor = 0.4f + ((float)world_y - ((float)height - 10)) * 0.06f;
-                }
+    u32 column_count = chunk_count / WORLD_GENERATOR_BENCH_HEIGHT;
+    column_count = column_count ? column_count : 1;
+    u32 side = 1;
+    while (side * side < column_count) {
+        side++;
+    }
+    column_count = side * side;
+    chunk_count = column_count * WORLD_GENERATOR_BENCH_HEIGHT;
+
+    LOG_INFO(
+        "Generator benchmark: %u chunks, %ux%u columns of %u\n",
+        chunk_count,
+        side,
+        side,
+        WORLD_GENERATOR_BENCH_HEIGHT
+    );
+
+    block_id_t* reference = malloc((usize)chunk_count * CHUNK_BLOCK_COUNT);
+    block_id_t* blocks = malloc((usize)chunk_count * CHUNK_BLOCK_COUNT);
+    i32 terrain_height[WORLD_COLUMN_AREA];
+
+    for (u32 pass = 0; pass < 2; pass++) {
+        u32 above = 0;
+        u32 below = 0;
+
+        f64 start = time_now_ms();
+        for (u32 i = 0; i < column_count; i++) {
+            i32 x = (i32)(i % side) - (i32)side / 2;
+            i32 z = (i32)(i / side) - (i32)side / 2;
+            world_generate_terrain_height(x, z, terrain_height);
+
+            i32 min_height = INT32_MAX;
+            i32 max_height = INT32_MIN;
+            for (u32 j = 0; j < WORLD_COLUMN_AREA; j++) {
+                min_height = terrain_height[j] < min_height ? terrain_height[j] : min_height;
+                max_height = terrain_height[j] > max_height ? terrain_height[j] : max_height;
+            }
 
-                if (cave_noise > cave_factor) {
-                    chunk->blocks[index].id = BLOCK_AIR;
-                } else if (world_y == height) {
-                    chunk->blocks[index].id = 3;
-                } else if (world_y < rock_height) {
-                    chunk->blocks[index].id = 1;
-                } else if (world_y < height) {
-                    chunk->blocks[index].id = 2;
+            for (i32 y = 0; y < WORLD_GENERATOR_BENCH_HEIGHT; y++) {
+                usize offset = ((usize)i * WORLD_GENERATOR_BENCH_HEIGHT + (usize)y) *
+                               CHUNK_BLOCK_COUNT;
+                if (pass == 0) {
+                    chunk_generate_blocks_reference(
+                        (ivec3){ x, y, z },
+                        terrain_height,
+                        reference + offset
+                    );
                 } else {
-                    chunk->blocks[index].id = BLOCK_AIR;
+                    chunk_generate_blocks((ivec3){ x, y, z }, terrain_height, blocks + offset);
+                    above += y * CHUNK_SIZE > max_height;
+                    below += (y + 1) * CHUNK_SIZE - 1 <= min_height - 10;
+                }
+            }
+        }
+        f64 elapsed_ms = time_now_ms() - start;
+
+        LOG_INFO(
+            "  %-9s %8.0f chunks/s, %6.1f us/chunk\n",
+            pass == 0 ? "per block" : "lattice",
+            (f64)chunk_count / elapsed_ms * 1000.0,
+            elapsed_ms * 1000.0 / (f64)chunk_count
+        );
+        if (pass == 1) {
+            LOG_INFO(
+                "  %u chunks above the surface skipped caves, %u below it skipped the "
+                "surface\n",
+                above,
+                below
+            );
+        }
+    }
+
+    // Top down maps of the cave air under the surface of every block column, per block
+    // then lattice, and the blocks that differ between them, brightest where most do
+    u32 width = side * CHUNK_SIZE;
+    u32 depth = WORLD_GENERATOR_BENCH_HEIGHT * CHUNK_SIZE;
+    u8* pixels = calloc((usize)width * 3 * width, 3);
+    usize changed_blocks = 0;
+    u32 changed_surfaces = 0;
+    i32 max_surface_difference = 0;
+
+    for (u32 i = 0; i < column_count; i++) {
+        const block_id_t* reference_stack =
+            reference + (usize)i * WORLD_GENERATOR_BENCH_HEIGHT * CHUNK_BLOCK_COUNT;
+        const block_id_t* stack =
+            blocks + (usize)i * WORLD_GENERATOR_BENCH_HEIGHT * CHUNK_BLOCK_COUNT;
+
+        for (i32 z = 0; z < CHUNK_SIZE; z++) {
+            for (i32 x = 0; x < CHUNK_SIZE; x++) {
+                i32 reference_surface = world_generator_bench_surface(reference_stack, x, z);
+                i32 surface = world_generator_bench_surface(stack, x, z);
+                i32 difference = abs(surface - reference_surface);
+                changed_surfaces += difference != 0;
+                if (difference > max_surface_difference) {
+                    max_surface_difference = difference;
                 }
+
+                u32 changed = 0;
+                u32 reference_air = 0;
+                u32 air = 0;
+                for (i32 y = 0; y < (i32)depth; y++) {
+                    usize index = (usize)(y / CHUNK_SIZE) * CHUNK_BLOCK_COUNT +
+                                  (usize)CHUNK_POS_TO_INDEX(x, y % CHUNK_SIZE, z);
+                    changed += reference_stack[index] != stack[index];
+                    bool reference_cave = reference_stack[index] == BLOCK_AIR;
+                    reference_air += y < reference_surface && reference_cave;
+                    air += y < surface && stack[index] == BLOCK_AIR;
+                }
+                changed_blocks += changed;
+
+                u32 px = (i % side) * CHUNK_SIZE + (u32)x;
+                u32 py = (i / side) * CHUNK_SIZE + (u32)z;
+                u8* row = pixels + (usize)py * width * 3 * 3;
+                memset(row + px * 3, (u8)(reference_air * 255 / depth), 3);
+                memset(row + (width + px) * 3, (u8)(air * 255 / depth), 3);
+                // a handful of blocks per column is already a visible change
+                u32 red = changed * 255 * 8 / depth;
+                row[(2 * width + px) * 3] = (u8)(red < 255 ? red : 255);
+                row[(2 * width + px) * 3 + 1] = difference ? 255 : 0;
             }
         }
     }
+
+    LOG_INFO(
+        "  %.2f%% of blocks differ, %.2f%% of surface heights by up to %d blocks\n",
+        (f64)changed_blocks * 100.0 / ((f64)chunk_count * CHUNK_BLOCK_COUNT),
+        (f64)changed_surfaces * 100.0 / ((f64)column_count * WORLD_COLUMN_AREA),
+        max_surface_difference
+    );
+
+    if (stbi_write_png(image_path, (int)(width * 3), (int)width, 3, pixels, (int)(width * 9))) {
+        LOG_INFO("  Wrote per block, lattice and difference maps to %s\n", image_path);
+    } else {
+        LOG_ERROR("Failed to write %s\n", image_path);
+    }
+
+    free(pixels);
+    free(reference);
+    free(blocks);
 }
 
 void chunk_set_block(chunk_t* chunk, world_t* world, ivec3 position, block_id_t id) {
@@ -120,6 +558,17 @@ void chunk_set_block(chunk_t* chunk, world_t* world, ivec3 position, block_id_t
     chunk->blocks[index].id = id;
     chunk->save_dirty = true;
     world_remesh_queue_add(world, (u32)(chunk - world->chunks));
+
+    world_column_t* column = world_get_column(world, chunk->position[0], chunk->position[2]);
+    if (column) {
+        i32 world_y = position[1] + chunk->position[1] * CHUNK_SIZE;
+        i32* top = &column->top[position[0] + position[2] * CHUNK_SIZE];
+        if (block_flags[id] & BLOCK_FLAG_SOLID) {
+            *top = world_y > *top ? world_y : *top;
+        } else if (world_y == *top) {
+            world_column_rescan(world, column, position[0], position[2]);
+        }
+    }
 }
 
 block_t* chunk_get_block(chunk_t* chunk, ivec3 position) {
@@ -134,6 +583,13 @@ block_t* chunk_get_block(chunk_t* chunk, ivec3 position) {
 }
 
 void chunk_mesh(chunk_t* chunk, world_t* world) {
+    PROFILE_SCOPE_CHUNK("chunk_mesh", chunk->position);
+    chunk_build_mesh(chunk, world);
+    chunk_upload_mesh(chunk, world);
+}
+
+void chunk_build_mesh(chunk_t* chunk, world_t* world) {
+    PROFILE_SCOPE_CHUNK("chunk_build_mesh", chunk->position);
     if (!chunk->mesh.vertices) {
         chunk->mesh.vertices =
             malloc(sizeof(vertex_t) * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * 6 * 4);
@@ -181,8 +637,12 @@ void chunk_mesh(chunk_t* chunk, world_t* world) {
     }
 
     chunk->mesh.draw_mode = GL_TRIANGLES;
+}
 
+void chunk_upload_mesh(chunk_t* chunk, world_t* world) {
     mesh_init(&chunk->mesh);
+
+    world_mark_chunk_changed(world, chunk->position);
 }
 
 void chunk_forget_mesh(chunk_t* chunk) {
@@ -447,23 +907,39 @@ void block_mesh_face(mesh_t* mesh, ivec3 position, block_face_t face, block_t* b
     mesh->index_count += 6;
 }
 
-void chunk_draw(chunk_t* chunk) {
+void chunk_submit(
+    chunk_t* chunk,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye
+) {
     if (chunk->mesh.vertex_count == 0) {
         return;
     }
 
+    vec3 origin = { (float)chunk->position[0] * CHUNK_SIZE,
+                    (float)chunk->position[1] * CHUNK_SIZE,
+                    (float)chunk->position[2] * CHUNK_SIZE };
+
     mat4 model = { 0 };
     glm_mat4_identity(model);
-    glm_translate(
-        model,
-        (vec3){ (float)chunk->position[0] * CHUNK_SIZE,
-                (float)chunk->position[1] * CHUNK_SIZE,
-                (float)chunk->position[2] * CHUNK_SIZE }
-    );
+    glm_translate(model, origin);
 
-    shader_set_mat4(&g_shader_current, "u_model", model);
+    vec3 center;
+    glm_vec3_adds(origin, (float)CHUNK_SIZE * 0.5f, center);
 
-    mesh_draw(&chunk->mesh);
+    render_queue_submit(
+        queue,
+        pass,
+        &chunk->mesh,
+        program,
+        texture,
+        model,
+        (vec4){ 1.0f, 1.0f, 1.0f, 1.0f },
+        glm_vec3_distance(eye, center)
+    );
 }
 
 world_t* world_new(void) {
@@ -478,6 +954,12 @@ world_t* world_new(void) {
     memset(world->chunk_slot_remesh_queue, 0, sizeof(world->chunk_slot_remesh_queue));
     world->chunk_slot_remesh_queue_count = 0;
 
+    // nothing rendered so far was of this world
+    world->changed_chunks_overflow = true;
+
+    world->columns = malloc(sizeof(world_column_t) * MAX_LOADED_CHUNKS);
+    world->column_count = 0;
+
     return world;
 }
 
@@ -518,6 +1000,7 @@ void world_free(world_t* world) {
         chunk_forget(&world->chunks[i]);
     }
     free(world->chunks);
+    free(world->columns);
     free(world);
 }
 
@@ -532,6 +1015,7 @@ void world_remesh_queue_clear(world_t* world) {
 
 // remesh one chunk per frame
 void world_remesh_queue_process(world_t* world) {
+    PROFILE_SCOPE("world_remesh_queue_process");
     if (world->chunk_slot_remesh_queue_count == 0) {
         return;
     }
@@ -618,7 +1102,7 @@ chunk_t* world_get_chunk_slot(world_t* world) {
                 (vec3){ (float)world->chunks[i].position[0] * CHUNK_SIZE,
                         (float)world->chunks[i].position[1] * CHUNK_SIZE,
                         (float)world->chunks[i].position[2] * CHUNK_SIZE },
-                g_player.position,
+                world->focus,
                 diff
             );
             float d = glm_vec3_norm(diff);
@@ -629,6 +1113,8 @@ chunk_t* world_get_chunk_slot(world_t* world) {
             }
         }
 
+        world_mark_chunk_changed(world, world->chunks[chunk_to_unload].position);
+        world_column_release(world, &world->chunks[chunk_to_unload]);
         chunk_forget(&world->chunks[chunk_to_unload]);
         world_chunk_slot_set_free(world, chunk_to_unload);
 
@@ -645,6 +1131,8 @@ void world_unload_chunk(world_t* world, ivec3 position) {
         }
 
         if (glme_ivec3_eq(world->chunks[i].position, position)) {
+            world_mark_chunk_changed(world, position);
+            world_column_release(world, &world->chunks[i]);
             chunk_forget(&world->chunks[i]);
             world_chunk_slot_set_free(world, i);
 
@@ -664,15 +1152,248 @@ void world_unload_all_chunks(world_t* world) {
         world_chunk_slot_set_free(world, i);
     }
     world->loaded_chunk_count = 0;
+    world->column_count = 0;
+    world->changed_chunks_overflow = true;
 }
 
-void world_draw(world_t* world) {
+void world_save_dirty_chunks(world_t* world) {
+    for (u32 i = 0; i < MAX_LOADED_CHUNKS; i++) {
+        chunk_t* chunk = &world->chunks[i];
+        if (world_chunk_slot_is_taken(world, i) && chunk->save_dirty) {
+            save_add_chunk(g_save, chunk);
+            chunk->save_dirty = false;
+        }
+    }
+}
+
+bool world_get_column_height(world_t* world, i32 x, i32 z, i32* terrain_height, i32* top) {
+    ivec3 chunk_position;
+    world_get_chunk_position((ivec3){ x, 0, z }, chunk_position);
+
+    world_column_t* column = world_get_column(world, chunk_position[0], chunk_position[2]);
+    if (!column) {
+        return false;
+    }
+
+    u32 index = (u32)(posmod(x, CHUNK_SIZE) + posmod(z, CHUNK_SIZE) * CHUNK_SIZE);
+    if (terrain_height) {
+        *terrain_height = column->terrain_height[index];
+    }
+    if (top) {
+        *top = column->top[index];
+    }
+    return true;
+}
+
+bool world_is_sky_visible(world_t* world, ivec3 position) {
+    i32 top;
+    if (!world_get_column_height(world, position[0], position[2], NULL, &top)) {
+        return true;
+    }
+    return position[1] > top;
+}
+
+void world_submit(
+    world_t* world,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye
+) {
+    PROFILE_SCOPE("world_submit");
     for (u32 i = 0; i < MAX_LOADED_CHUNKS; i++) {
         if (!world_chunk_slot_is_taken(world, i)) {
             continue;
         }
-        chunk_draw(&world->chunks[i]);
+        chunk_submit(&world->chunks[i], queue, pass, program, texture, eye);
+    }
+}
+
+// Orthographic projections are affine, so the chunk's box stays a box in clip space
+bool world_chunk_intersects_ortho(ivec3 chunk_position, mat4 view_projection) {
+    f32 half = (f32)CHUNK_SIZE * 0.5f;
+    vec3 center = { (f32)chunk_position[0] * CHUNK_SIZE + half,
+                    (f32)chunk_position[1] * CHUNK_SIZE + half,
+                    (f32)chunk_position[2] * CHUNK_SIZE + half };
+
+    for (u32 axis = 0; axis < 3; axis++) {
+        f32 clip_center = view_projection[0][axis] * center[0] +
+                          view_projection[1][axis] * center[1] +
+                          view_projection[2][axis] * center[2] + view_projection[3][axis];
+        f32 clip_extent =
+            half * (fabsf(view_projection[0][axis]) + fabsf(view_projection[1][axis]) +
+                    fabsf(view_projection[2][axis]));
+
+        if (clip_center - clip_extent > 1.0f || clip_center + clip_extent < -1.0f) {
+            return false;
+        }
     }
+
+    return true;
+}
+
+u32 world_submit_ortho_culled(
+    world_t* world,
+    render_queue_t* queue,
+    render_pass_id_t pass,
+    GLuint program,
+    GLuint texture,
+    vec3 eye,
+    mat4 view_projection
+) {
+    u32 submitted = 0;
+
+    for (u32 i = 0; i < MAX_LOADED_CHUNKS; i++) {
+        if (!world_chunk_slot_is_taken(world, i)) {
+            continue;
+        }
+
+        chunk_t* chunk = &world->chunks[i];
+        if (chunk->mesh.vertex_count == 0 ||
+            !world_chunk_intersects_ortho(chunk->position, view_projection)) {
+            continue;
+        }
+
+        chunk_submit(chunk, queue, pass, program, texture, eye);
+        submitted++;
+    }
+
+    return submitted;
+}
+
+static void world_load_generate_job(void* arg) {
+    world_load_job_t* job = arg;
+    chunk_load_blocks(job->chunk, job->chunk->position, job->terrain_height);
+}
+
+static void world_load_mesh_job(void* arg) {
+    world_load_job_t* job = arg;
+    chunk_build_mesh(job->chunk, job->world);
+}
+
+void world_load_begin(
+    world_load_t* load,
+    world_t* world,
+    job_pool_t* pool,
+    ivec3 min,
+    ivec3 max
+) {
+    u32 capacity = (u32)((max[0] - min[0]) * (max[1] - min[1]) * (max[2] - min[2]));
+
+    *load = (world_load_t){
+        .world = world,
+        .jobs = malloc(sizeof(world_load_job_t) * capacity),
+        .start_ms = time_now_ms(),
+    };
+
+    for (i32 x = min[0]; x < max[0]; x++) {
+        for (i32 y = min[1]; y < max[1]; y++) {
+            for (i32 z = min[2]; z < max[2]; z++) {
+                if (world_get_chunk(world, (ivec3){ x, y, z })) {
+                    continue;
+                }
+
+                // evicting needs the player, which may not exist yet
+                if (world->loaded_chunk_count >= MAX_LOADED_CHUNKS) {
+                    LOG_WARNING("World full, only loading %u chunks\n", load->chunk_count);
+                    goto submit;
+                }
+
+                chunk_t* chunk = world_get_chunk_slot(world);
+                world_chunk_slot_set_taken(world, (u32)(chunk - world->chunks));
+                glm_ivec3_copy((ivec3){ x, y, z }, chunk->position);
+
+                // heights are generated here once per column, the chunks only read them
+                world_column_t* column =
+                    world_column_acquire(world, (u32)(chunk - world->chunks), x, z);
+                load->jobs[load->chunk_count++] = (world_load_job_t){
+                    .world = world,
+                    .chunk = chunk,
+                    .terrain_height = column->terrain_height,
+                };
+            }
+        }
+    }
+
+submit:
+    for (u32 i = 0; i < load->chunk_count; i++) {
+        job_submit(pool, &load->group, world_load_generate_job, &load->jobs[i]);
+    }
+}
+
+void world_load_finish(world_load_t* load, job_pool_t* pool) {
+    job_group_wait(pool, &load->group);
+    load->generated_ms = load->chunk_count ? load->group.done_ms : load->start_ms;
+
+    for (u32 i = 0; i < load->chunk_count; i++) {
+        chunk_t* chunk = load->jobs[i].chunk;
+        world_column_add_chunk(
+            world_get_column(load->world, chunk->position[0], chunk->position[2]),
+            chunk
+        );
+    }
+
+    // every chunk of the box has its blocks, so none of them needs a remesh afterwards
+    for (u32 i = 0; i < load->chunk_count; i++) {
+        job_submit(pool, &load->group, world_load_mesh_job, &load->jobs[i]);
+    }
+
+    job_group_wait(pool, &load->group);
+    load->meshed_ms = load->chunk_count ? load->group.done_ms : load->generated_ms;
+
+    const ivec3 NEIGHBOR_OFFSETS[6] = {
+        { 0, 0, -1 }, { 0, 0, 1 }, { 0, -1, 0 }, { 0, 1, 0 }, { -1, 0, 0 }, { 1, 0, 0 },
+    };
+
+    for (u32 i = 0; i < load->chunk_count; i++) {
+        chunk_t* chunk = load->jobs[i].chunk;
+        chunk_upload_mesh(chunk, load->world);
+
+        // chunks loaded earlier next to the box still have faces against it
+        for (u32 j = 0; j < 6; j++) {
+            chunk_t* neighbor = world_get_chunk(
+                load->world,
+                (ivec3){
+                    chunk->position[0] + NEIGHBOR_OFFSETS[j][0],
+                    chunk->position[1] + NEIGHBOR_OFFSETS[j][1],
+                    chunk->position[2] + NEIGHBOR_OFFSETS[j][2],
+                }
+            );
+            if (!neighbor) {
+                continue;
+            }
+
+            bool in_load = false;
+            for (u32 k = 0; k < load->chunk_count; k++) {
+                if (load->jobs[k].chunk == neighbor) {
+                    in_load = true;
+                    break;
+                }
+            }
+
+            if (!in_load) {
+                world_remesh_queue_add(load->world, (u32)(neighbor - load->world->chunks));
+            }
+        }
+    }
+
+    free(load->jobs);
+    load->jobs = NULL;
+}
+
+void world_mark_chunk_changed(world_t* world, ivec3 chunk_position) {
+    if (world->changed_chunk_count >= WORLD_CHANGED_CHUNKS_MAX) {
+        world->changed_chunks_overflow = true;
+        return;
+    }
+
+    glm_ivec3_copy(chunk_position, world->changed_chunks[world->changed_chunk_count++]);
+}
+
+void world_changed_chunks_clear(world_t* world) {
+    world->changed_chunk_count = 0;
+    world->changed_chunks_overflow = false;
 }
 
 void world_get_chunk_position(ivec3 position, ivec3 chunk_position) {
@@ -0,0 +1,319 @@
+// cubegame-test-saves, saves through the same startup the game goes through: save_load,
+// then save_start. Every case runs once before job_pool_init, where main used to start the
+// save, and once with the pool running. Exits 1 if any check failed.
+
+#include "harness.h"
+#include "job.h"
+#include "log.h"
+#include "saves.h"
+#include "types.h"
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_SEED 12345
+// x, y, z sorted like a version 2 index, up to the surface where seeds differ the least
+#define TEST_SIDE 4
+#define TEST_HEIGHT 3
+#define TEST_CHUNKS (TEST_SIDE * TEST_HEIGHT * TEST_SIDE)
+#define TEST_EDITS 400
+#define TEST_PATH_MAX 512
+
+static bool g_test_failed = false;
+
+#define TEST_CHECK(condition)                                                                  \
+    do {                                                                                       \
+        if (!(condition)) {                                                                    \
+            LOG_ERROR("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);            \
+            g_test_failed = true;                                                              \
+        }                                                                                      \
+    } while (0)
+
+static void test_chunk_position(u32 i, ivec3 position) {
+    position[0] = (i32)(i / (TEST_HEIGHT * TEST_SIDE)) - TEST_SIDE / 2;
+    position[1] = (i32)(i / TEST_SIDE % TEST_HEIGHT);
+    position[2] = (i32)(i % TEST_SIDE) - TEST_SIDE / 2;
+}
+
+// Generated blocks of chunk i with some dug out and some placed, the generator seeded
+// Digging where another seed has air is what goes missing from deltas made against it
+static void test_edit(u32 i, block_id_t blocks[CHUNK_BLOCK_COUNT], u64* random) {
+    ivec3 position;
+    test_chunk_position(i, position);
+    chunk_generate_blocks(position, NULL, blocks);
+
+    for (u32 edit = 0; edit < TEST_EDITS; edit++) {
+        u32 index = (u32)(bench_random(random) % CHUNK_BLOCK_COUNT);
+        block_id_t placed = (block_id_t)(bench_random(random) % BLOCK_ID_MAX);
+        blocks[index] = edit % 2 ? BLOCK_AIR : placed;
+    }
+}
+
+static bool test_write_v2(const char* path, const block_id_t* blocks) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    save_header_t header = { .save_format_version = SAVE_FORMAT_VERSION_V2 };
+    memcpy(&header.magic, SAVE_MAGIC_STR, 4);
+    u64 seed = TEST_SEED;
+    u32 count = TEST_CHUNKS;
+    u32 pad = 0;
+    fwrite(&header, sizeof(save_header_t), 1, file);
+    fwrite(&seed, sizeof(u64), 1, file);
+    fwrite(&count, sizeof(u32), 1, file);
+    fwrite(&pad, sizeof(u32), 1, file);
+
+    for (u32 i = 0; i < TEST_CHUNKS; i++) {
+        ivec3 position;
+        test_chunk_position(i, position);
+        save_index_entry_t entry = { .x = position[0], .y = position[1], .z = position[2] };
+        fwrite(&entry, sizeof(save_index_entry_t), 1, file);
+    }
+    fwrite(blocks, sizeof(block_id_t), (usize)TEST_CHUNKS * CHUNK_BLOCK_COUNT, file);
+
+    return fclose(file) == 0;
+}
+
+// What main does with -s path
+static save_t* test_startup(const char* path) {
+    // nothing before save_start seeds the generator, make sure it isn't by accident
+    world_generator_init(TEST_SEED + 1);
+
+    save_t* save = save_load(path);
+    if (save && !save_start(save, path, true)) {
+        save_free(save);
+        return NULL;
+    }
+
+    return save;
+}
+
+// Chunks of the first count that don't read back as blocks
+static u32 test_mismatches(save_t* save, const block_id_t* blocks, u32 count) {
+    block_id_t scratch[CHUNK_BLOCK_COUNT];
+    u32 mismatches = 0;
+
+    for (u32 i = 0; i < count; i++) {
+        ivec3 position;
+        test_chunk_position(i, position);
+        const block_id_t* saved = save_get_chunk_blocks(save, position, scratch);
+        const block_id_t* expected = blocks + (usize)i * CHUNK_BLOCK_COUNT;
+        mismatches += !saved || memcmp(saved, expected, CHUNK_BLOCK_COUNT) != 0;
+    }
+
+    return mismatches;
+}
+
+static void test_cleanup(save_t* save, const char* path) {
+    char other_path[TEST_PATH_MAX + 16];
+    save_remove(save, path);
+    save_free(save);
+
+    snprintf(other_path, sizeof(other_path), "%s.bak", path);
+    remove(other_path);
+    snprintf(other_path, sizeof(other_path), "%s" SAVE_JOURNAL_SUFFIX, path);
+    remove(other_path);
+}
+
+// A version 2 save is converted to delta encoded regions on its first start
+static void test_convert_v2(const block_id_t* blocks) {
+    char path[TEST_PATH_MAX];
+    char backup_path[TEST_PATH_MAX + 4];
+    bench_temp_path("test_v2.cgsv", path, sizeof(path));
+    snprintf(backup_path, sizeof(backup_path), "%s.bak", path);
+
+    TEST_CHECK(test_write_v2(path, blocks));
+
+    save_t* save = test_startup(path);
+    TEST_CHECK(save != NULL);
+    if (!save) {
+        remove(path);
+        return;
+    }
+    TEST_CHECK(save->convert_version == 0);
+    TEST_CHECK(save->region_count > 0);
+    TEST_CHECK(save->world.chunk_count == 0);
+
+    FILE* backup = fopen(backup_path, "rb");
+    TEST_CHECK(backup != NULL);
+    if (backup) {
+        fclose(backup);
+    }
+    save_free(save);
+
+    // the next start reads the regions
+    save = test_startup(path);
+    TEST_CHECK(save != NULL);
+    if (!save) {
+        return;
+    }
+    TEST_CHECK(save->convert_version == 0);
+    TEST_CHECK(test_mismatches(save, blocks, TEST_CHUNKS) == 0);
+
+    test_cleanup(save, path);
+}
+
+// Chunks only in the journal when the game stopped are recovered on the next start
+static void test_recover_journal(const block_id_t* blocks) {
+    char path[TEST_PATH_MAX];
+    bench_temp_path("test_journal.cgsv", path, sizeof(path));
+
+    world_generator_init(TEST_SEED);
+    save_t* save = save_new();
+    save->world.seed = TEST_SEED;
+    TEST_CHECK(save_start(save, path, false));
+
+    // half of the chunks in the regions, the first flush starts writing the save and the
+    // rest is added while it does
+    chunk_t* chunk = calloc(1, sizeof(chunk_t));
+    for (u32 i = 0; i < TEST_CHUNKS; i++) {
+        if (i == TEST_CHUNKS / 2) {
+            save_journal_flush(save);
+            TEST_CHECK(save->compaction.running);
+            TEST_CHECK(test_mismatches(save, blocks, i) == 0);
+        }
+
+        test_chunk_position(i, chunk->position);
+        for (u32 j = 0; j < CHUNK_BLOCK_COUNT; j++) {
+            chunk->blocks[j].id = blocks[(usize)i * CHUNK_BLOCK_COUNT + j];
+        }
+        save_add_chunk(save, chunk);
+    }
+    free(chunk);
+
+    save_compact_wait(save);
+    TEST_CHECK(save->path != NULL);
+    TEST_CHECK(test_mismatches(save, blocks, TEST_CHUNKS) == 0);
+
+    // the rest only in the journal, then the game stops without writing the save
+    save_journal_flush(save);
+    save_journal_wait(save);
+    TEST_CHECK(save->world.chunk_count == TEST_CHUNKS - TEST_CHUNKS / 2);
+    save_free(save);
+
+    save = test_startup(path);
+    TEST_CHECK(save != NULL);
+    if (!save) {
+        return;
+    }
+    TEST_CHECK(save->world.chunk_count == 0);
+    TEST_CHECK(save->journal_size == sizeof(save_header_t));
+    TEST_CHECK(test_mismatches(save, blocks, TEST_CHUNKS) == 0);
+
+    test_cleanup(save, path);
+}
+
+// Adds chunk i of blocks and writes the save to path
+static void test_write_chunk(save_t* save, const char* path, const block_id_t* blocks, u32 i) {
+    chunk_t* chunk = calloc(1, sizeof(chunk_t));
+    test_chunk_position(i, chunk->position);
+    for (u32 j = 0; j < CHUNK_BLOCK_COUNT; j++) {
+        chunk->blocks[j].id = blocks[(usize)i * CHUNK_BLOCK_COUNT + j];
+    }
+    save_add_chunk(save, chunk);
+    free(chunk);
+
+    save_write(save, path);
+}
+
+// Region files left behind by an older save at the same path aren't read back as part of
+// a new one, when a later write adds their regions to it
+static void test_stale_regions(const block_id_t* blocks) {
+    char path[TEST_PATH_MAX];
+    char journal_path[TEST_PATH_MAX + 16];
+    char old_path[TEST_PATH_MAX + 16];
+    bench_temp_path("test_stale.cgsv", path, sizeof(path));
+    snprintf(journal_path, sizeof(journal_path), "%s" SAVE_JOURNAL_SUFFIX, path);
+    snprintf(old_path, sizeof(old_path), "%s.old", path);
+
+    // the old save with every chunk, of which only the region files stay, its table is put
+    // aside to remove them in the end
+    world_generator_init(TEST_SEED);
+    save_t* save = save_new();
+    save->world.seed = TEST_SEED;
+    TEST_CHECK(save_start(save, path, false));
+    for (u32 i = 0; i < TEST_CHUNKS; i++) {
+        test_write_chunk(save, path, blocks, i);
+    }
+    TEST_CHECK(test_mismatches(save, blocks, TEST_CHUNKS) == 0);
+    save_free(save);
+    TEST_CHECK(rename(path, old_path) == 0);
+    remove(journal_path);
+
+    // the first and the last chunk are in different regions, the one before the last is
+    // next to the last
+    save = save_new();
+    save->world.seed = TEST_SEED;
+    TEST_CHECK(save_start(save, path, false));
+    test_write_chunk(save, path, blocks, 0);
+    test_write_chunk(save, path, blocks, TEST_CHUNKS - 1);
+
+    block_id_t scratch[CHUNK_BLOCK_COUNT];
+    ivec3 stale;
+    test_chunk_position(TEST_CHUNKS - 2, stale);
+    TEST_CHECK(save_get_chunk_blocks(save, stale, scratch) == NULL);
+    save_free(save);
+
+    save = test_startup(path);
+    TEST_CHECK(save != NULL);
+    if (!save) {
+        return;
+    }
+    TEST_CHECK(save->region_count == 2);
+    TEST_CHECK(test_mismatches(save, blocks, 1) == 0);
+    TEST_CHECK(save_get_chunk_blocks(save, stale, scratch) == NULL);
+
+    test_cleanup(save, path);
+
+    TEST_CHECK(rename(old_path, path) == 0);
+    save = save_load(path);
+    if (save) {
+        save_remove(save, path);
+        save_free(save);
+    }
+}
+
+static void test_run(
+    const char* name,
+    void (*test)(const block_id_t* blocks),
+    const block_id_t* blocks,
+    bool pooled
+) {
+    LOG_INFO("%s, %s\n", name, pooled ? "on the job pool" : "before job_pool_init");
+    if (pooled) {
+        job_pool_init(&g_job_pool, 2);
+    }
+
+    test(blocks);
+
+    if (pooled) {
+        job_pool_free(&g_job_pool);
+    }
+}
+
+int main(void) {
+    log_init();
+
+    block_id_t* blocks = malloc((usize)TEST_CHUNKS * CHUNK_BLOCK_COUNT);
+    u64 random = TEST_SEED;
+    world_generator_init(TEST_SEED);
+    for (u32 i = 0; i < TEST_CHUNKS; i++) {
+        test_edit(i, blocks + (usize)i * CHUNK_BLOCK_COUNT, &random);
+    }
+
+    test_run("Converting a version 2 save", test_convert_v2, blocks, false);
+    test_run("Converting a version 2 save", test_convert_v2, blocks, true);
+    test_run("Recovering a journal", test_recover_journal, blocks, false);
+    test_run("Recovering a journal", test_recover_journal, blocks, true);
+    test_run("Leaving stale regions out", test_stale_regions, blocks, false);
+    test_run("Leaving stale regions out", test_stale_regions, blocks, true);
+
+    free(blocks);
+    LOG_INFO("%s\n", g_test_failed ? "FAILED" : "All checks passed");
+    log_close();
+    return g_test_failed ? 1 : 0;
+}
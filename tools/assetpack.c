@@ -0,0 +1,167 @@
+// Build time asset packer, run by meson after texbake when asset_source is pack
+//
+// assetpack <staged dir> <manifest> <output>
+//
+// Packs every file listed in texbake's manifest into one archive, named by its path
+// without the extension, see include/pack.h
+
+#include "pack.h"
+#include "types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ASSETPACK_PATH_MAX 1024
+#define ASSETPACK_MAX_ENTRIES 256
+
+typedef struct assetpack_file {
+    pack_entry_t entry;
+    u8* data;
+} assetpack_file_t;
+
+static u8* assetpack_read_file(const char* path, usize* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    usize file_size = (usize)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8* buffer = malloc(file_size + 1);
+    if (fread(buffer, 1, file_size, file) != file_size) {
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *size = file_size;
+
+    return buffer;
+}
+
+static int assetpack_compare(const void* a, const void* b) {
+    const assetpack_file_t* file_a = a;
+    const assetpack_file_t* file_b = b;
+
+    return strncmp(file_a->entry.name, file_b->entry.name, PACK_NAME_MAX);
+}
+
+static u32 assetpack_align(u32 offset) {
+    return (offset + PACK_DATA_ALIGNMENT - 1) & ~(u32)(PACK_DATA_ALIGNMENT - 1);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: assetpack <staged dir> <manifest> <output>\n");
+        return 1;
+    }
+
+    const char* staged_dir = argv[1];
+
+    FILE* manifest = fopen(argv[2], "r");
+    if (!manifest) {
+        fprintf(stderr, "assetpack: can't read %s\n", argv[2]);
+        return 1;
+    }
+
+    static assetpack_file_t files[ASSETPACK_MAX_ENTRIES];
+    u32 file_count = 0;
+    char line[ASSETPACK_PATH_MAX];
+
+    while (fgets(line, sizeof(line), manifest)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+
+        if (file_count == ASSETPACK_MAX_ENTRIES) {
+            fprintf(stderr, "assetpack: more than %d assets\n", ASSETPACK_MAX_ENTRIES);
+            return 1;
+        }
+
+        assetpack_file_t* file = &files[file_count++];
+        memset(&file->entry, 0, sizeof(pack_entry_t));
+
+        // the name drops the extension, baked and source textures resolve the same
+        usize name_length = strlen(line);
+        char* extension = strrchr(line, '.');
+        char* separator = strrchr(line, '/');
+        if (extension && (!separator || extension > separator)) {
+            name_length = (usize)(extension - line);
+        }
+
+        if (name_length >= PACK_NAME_MAX) {
+            fprintf(stderr, "assetpack: name of %s is too long\n", line);
+            return 1;
+        }
+        memcpy(file->entry.name, line, name_length);
+
+        char path[ASSETPACK_PATH_MAX * 2];
+        snprintf(path, sizeof(path), "%s/%s", staged_dir, line);
+
+        usize size;
+        file->data = assetpack_read_file(path, &size);
+        if (!file->data) {
+            fprintf(stderr, "assetpack: can't read %s\n", path);
+            return 1;
+        }
+        file->entry.size = (u32)size;
+    }
+    fclose(manifest);
+
+    qsort(files, file_count, sizeof(assetpack_file_t), assetpack_compare);
+
+    u32 offset = assetpack_align(
+        (u32)(sizeof(pack_header_t) + sizeof(pack_entry_t) * file_count)
+    );
+    for (u32 i = 0; i < file_count; i++) {
+        if (i > 0 && assetpack_compare(&files[i - 1], &files[i]) == 0) {
+            fprintf(stderr, "assetpack: %s is packed twice\n", files[i].entry.name);
+            return 1;
+        }
+
+        files[i].entry.offset = offset;
+        // the NUL terminator after each entry
+        offset = assetpack_align(offset + files[i].entry.size + 1);
+    }
+
+    FILE* output = fopen(argv[3], "wb");
+    if (!output) {
+        fprintf(stderr, "assetpack: can't write %s\n", argv[3]);
+        return 1;
+    }
+
+    pack_header_t header = {
+        .format_version = PACK_FORMAT_VERSION,
+        .entry_count = file_count,
+    };
+    memcpy(&header.magic, PACK_MAGIC_STR, 4);
+
+    bool written = fwrite(&header, sizeof(pack_header_t), 1, output) == 1;
+    for (u32 i = 0; i < file_count && written; i++) {
+        written = fwrite(&files[i].entry, sizeof(pack_entry_t), 1, output) == 1;
+    }
+
+    static const u8 padding[PACK_DATA_ALIGNMENT] = { 0 };
+    for (u32 i = 0; i < file_count && written; i++) {
+        long position = ftell(output);
+        written = fwrite(padding, 1, files[i].entry.offset - (u32)position, output) ==
+                      files[i].entry.offset - (u32)position &&
+                  fwrite(files[i].data, 1, files[i].entry.size, output) ==
+                      files[i].entry.size &&
+                  fwrite(padding, 1, 1, output) == 1;
+        free(files[i].data);
+    }
+
+    if (fclose(output) != 0 || !written) {
+        fprintf(stderr, "assetpack: failed to write %s\n", argv[3]);
+        remove(argv[3]);
+        return 1;
+    }
+
+    return 0;
+}
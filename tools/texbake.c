@@ -0,0 +1,415 @@
+// Build time asset staging, run by meson before finch or assetpack pick up the assets
+//
+// texbake [--format png|rgba|bc1] <asset dir> <output dir> <manifest> <assets...>
+//
+// Every asset path is relative to the asset dir and is copied to the same path under the
+// output dir, the manifest lists the staged paths one per line. PNGs are decoded and
+// written as .ctex containers with a full mip chain, see include/ctex.h. Files stb_image
+// can't decode and everything with --format png are copied as they are, the game still
+// loads those.
+
+#include "ctex.h"
+#include "types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define texbake_mkdir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define texbake_mkdir(path) mkdir(path, 0755)
+#endif
+
+#define TEXBAKE_PATH_MAX 1024
+
+typedef enum texbake_format {
+    TEXBAKE_FORMAT_PNG,
+    TEXBAKE_FORMAT_RGBA,
+    TEXBAKE_FORMAT_BC1,
+} texbake_format_t;
+
+static u8* texbake_read_file(const char* path, usize* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    usize file_size = (usize)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8* buffer = malloc(file_size);
+    if (fread(buffer, 1, file_size, file) != file_size) {
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *size = file_size;
+
+    return buffer;
+}
+
+static bool texbake_write_file(const char* path, const void* data, usize size) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = fwrite(data, 1, size, file) == size;
+    fclose(file);
+
+    return written;
+}
+
+// mkdir -p of everything before the last separator
+static void texbake_make_parents(const char* path) {
+    char parent[TEXBAKE_PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", path);
+
+    for (char* c = parent + 1; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            char separator = *c;
+            *c = '\0';
+            texbake_mkdir(parent);
+            *c = separator;
+        }
+    }
+}
+
+// 2x2 box filter, odd edges reuse the last row or column
+static u8* texbake_downsample(const u8* src, u32 width, u32 height, u32* out_w, u32* out_h) {
+    u32 dst_width = width > 1 ? width / 2 : 1;
+    u32 dst_height = height > 1 ? height / 2 : 1;
+    u8* dst = malloc((usize)dst_width * dst_height * 4);
+
+    for (u32 y = 0; y < dst_height; y++) {
+        for (u32 x = 0; x < dst_width; x++) {
+            u32 x0 = x * 2 < width ? x * 2 : width - 1;
+            u32 x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            u32 y0 = y * 2 < height ? y * 2 : height - 1;
+            u32 y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+
+            for (u32 c = 0; c < 4; c++) {
+                u32 sum = (u32)src[(y0 * width + x0) * 4 + c] +
+                          (u32)src[(y0 * width + x1) * 4 + c] +
+                          (u32)src[(y1 * width + x0) * 4 + c] +
+                          (u32)src[(y1 * width + x1) * 4 + c];
+                dst[(y * dst_width + x) * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+
+    *out_w = dst_width;
+    *out_h = dst_height;
+
+    return dst;
+}
+
+static u16 texbake_rgb565(const u8* rgb) {
+    u32 r = (rgb[0] * 31u + 127u) / 255u;
+    u32 g = (rgb[1] * 63u + 127u) / 255u;
+    u32 b = (rgb[2] * 31u + 127u) / 255u;
+
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+static void texbake_rgb565_expand(u16 color, i32* rgb) {
+    i32 r = (color >> 11) & 31;
+    i32 g = (color >> 5) & 63;
+    i32 b = color & 31;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints are the corners of the block's color bounding box, every pixel takes the
+// nearest palette entry. Blocks with any alpha below half use the 3 color mode, where
+// index 3 is transparent black.
+static void texbake_bc1_block(const u8 pixels[16][4], u8* out) {
+    u8 min[3] = { 255, 255, 255 };
+    u8 max[3] = { 0, 0, 0 };
+    bool transparent = false;
+
+    for (u32 i = 0; i < 16; i++) {
+        if (pixels[i][3] < 128) {
+            transparent = true;
+            continue;
+        }
+
+        for (u32 c = 0; c < 3; c++) {
+            min[c] = pixels[i][c] < min[c] ? pixels[i][c] : min[c];
+            max[c] = pixels[i][c] > max[c] ? pixels[i][c] : max[c];
+        }
+    }
+
+    u16 color0 = texbake_rgb565(max);
+    u16 color1 = texbake_rgb565(min);
+
+    // color0 > color1 selects 4 colors, color0 <= color1 selects 3 and transparent
+    if (transparent ? color0 > color1 : color0 < color1) {
+        u16 swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    i32 palette[4][3];
+    texbake_rgb565_expand(color0, palette[0]);
+    texbake_rgb565_expand(color1, palette[1]);
+
+    u32 palette_count;
+    if (color0 > color1) {
+        for (u32 c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        palette_count = 4;
+    } else {
+        for (u32 c = 0; c < 3; c++) {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+        }
+        palette_count = 3;
+    }
+
+    u32 indices = 0;
+    for (u32 i = 0; i < 16; i++) {
+        u32 index = 3;
+
+        if (!transparent || pixels[i][3] >= 128) {
+            i32 best_distance = INT32_MAX;
+            for (u32 p = 0; p < palette_count; p++) {
+                i32 distance = 0;
+                for (u32 c = 0; c < 3; c++) {
+                    i32 delta = (i32)pixels[i][c] - palette[p][c];
+                    distance += delta * delta;
+                }
+
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    index = p;
+                }
+            }
+        }
+
+        indices |= index << (i * 2);
+    }
+
+    out[0] = (u8)(color0 & 0xFF);
+    out[1] = (u8)(color0 >> 8);
+    out[2] = (u8)(color1 & 0xFF);
+    out[3] = (u8)(color1 >> 8);
+    out[4] = (u8)(indices & 0xFF);
+    out[5] = (u8)((indices >> 8) & 0xFF);
+    out[6] = (u8)((indices >> 16) & 0xFF);
+    out[7] = (u8)(indices >> 24);
+}
+
+static void texbake_bc1_encode(const u8* rgba, u32 width, u32 height, u8* out) {
+    for (u32 block_y = 0; block_y < height; block_y += 4) {
+        for (u32 block_x = 0; block_x < width; block_x += 4) {
+            u8 pixels[16][4];
+
+            for (u32 y = 0; y < 4; y++) {
+                for (u32 x = 0; x < 4; x++) {
+                    // blocks past the edge repeat the last pixel
+                    u32 src_x = block_x + x < width ? block_x + x : width - 1;
+                    u32 src_y = block_y + y < height ? block_y + y : height - 1;
+                    memcpy(pixels[y * 4 + x], &rgba[(src_y * width + src_x) * 4], 4);
+                }
+            }
+
+            texbake_bc1_block(pixels, out);
+            out += 8;
+        }
+    }
+}
+
+static bool texbake_texture(const char* input, const char* output, ctex_format_t format) {
+    i32 width, height, channels;
+    u8* pixels = stbi_load(input, &width, &height, &channels, 4);
+    if (!pixels) {
+        return false;
+    }
+
+    ctex_header_t header = {
+        .format_version = CTEX_FORMAT_VERSION,
+        .format = format,
+        .width = (u32)width,
+        .height = (u32)height,
+        .channels = (u32)channels,
+    };
+    memcpy(&header.magic, CTEX_MAGIC_STR, 4);
+
+    ctex_level_t levels[CTEX_MAX_LEVELS];
+    u8* level_data[CTEX_MAX_LEVELS];
+
+    u32 level_width = (u32)width;
+    u32 level_height = (u32)height;
+    u8* level_pixels = pixels;
+    u32 offset = 0;
+
+    while (header.mip_count < CTEX_MAX_LEVELS) {
+        ctex_level_t* level = &levels[header.mip_count];
+        level->width = level_width;
+        level->height = level_height;
+        level->size = ctex_level_size(format, level_width, level_height);
+        level->offset = offset;
+        offset += level->size;
+
+        u8* data = malloc(level->size);
+        if (format == CTEX_FORMAT_BC1) {
+            texbake_bc1_encode(level_pixels, level_width, level_height, data);
+        } else {
+            memcpy(data, level_pixels, level->size);
+        }
+        level_data[header.mip_count++] = data;
+
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+
+        u8* next = texbake_downsample(
+            level_pixels,
+            level_width,
+            level_height,
+            &level_width,
+            &level_height
+        );
+        if (level_pixels != pixels) {
+            free(level_pixels);
+        }
+        level_pixels = next;
+    }
+
+    if (level_pixels != pixels) {
+        free(level_pixels);
+    }
+    stbi_image_free(pixels);
+
+    u32 data_start = (u32)(sizeof(ctex_header_t) + sizeof(ctex_level_t) * header.mip_count);
+    for (u32 i = 0; i < header.mip_count; i++) {
+        levels[i].offset += data_start;
+    }
+
+    bool written = false;
+    FILE* file = fopen(output, "wb");
+    if (file) {
+        written = fwrite(&header, sizeof(ctex_header_t), 1, file) == 1 &&
+                  fwrite(levels, sizeof(ctex_level_t), header.mip_count, file) ==
+                      header.mip_count;
+
+        for (u32 i = 0; i < header.mip_count && written; i++) {
+            written = fwrite(level_data[i], 1, levels[i].size, file) == levels[i].size;
+        }
+
+        fclose(file);
+    }
+
+    for (u32 i = 0; i < header.mip_count; i++) {
+        free(level_data[i]);
+    }
+
+    return written;
+}
+
+static bool texbake_copy(const char* input, const char* output) {
+    usize size;
+    u8* data = texbake_read_file(input, &size);
+    if (!data) {
+        return false;
+    }
+
+    bool written = texbake_write_file(output, data, size);
+    free(data);
+
+    return written;
+}
+
+static bool texbake_is_png(const char* path) {
+    usize length = strlen(path);
+    return length > 4 && strcmp(path + length - 4, ".png") == 0;
+}
+
+int main(int argc, char** argv) {
+    texbake_format_t format = TEXBAKE_FORMAT_RGBA;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "--format") == 0) {
+        if (strcmp(argv[arg + 1], "png") == 0) {
+            format = TEXBAKE_FORMAT_PNG;
+        } else if (strcmp(argv[arg + 1], "rgba") == 0) {
+            format = TEXBAKE_FORMAT_RGBA;
+        } else if (strcmp(argv[arg + 1], "bc1") == 0) {
+            format = TEXBAKE_FORMAT_BC1;
+        } else {
+            fprintf(stderr, "texbake: unknown format %s\n", argv[arg + 1]);
+            return 1;
+        }
+        arg += 2;
+    }
+
+    if (argc - arg < 3) {
+        fprintf(
+            stderr,
+            "usage: texbake [--format png|rgba|bc1] <asset dir> <output dir> <manifest> "
+            "<assets...>\n"
+        );
+        return 1;
+    }
+
+    const char* asset_dir = argv[arg];
+    const char* output_dir = argv[arg + 1];
+    FILE* manifest = fopen(argv[arg + 2], "w");
+    if (!manifest) {
+        fprintf(stderr, "texbake: can't write %s\n", argv[arg + 2]);
+        return 1;
+    }
+
+    for (int i = arg + 3; i < argc; i++) {
+        char input[TEXBAKE_PATH_MAX];
+        char output[TEXBAKE_PATH_MAX];
+        snprintf(input, sizeof(input), "%s/%s", asset_dir, argv[i]);
+        snprintf(output, sizeof(output), "%s/%s", output_dir, argv[i]);
+        texbake_make_parents(output);
+
+        if (texbake_is_png(argv[i])) {
+            // both share a stem, finch would embed a leftover from another format twice
+            char baked[TEXBAKE_PATH_MAX];
+            snprintf(baked, sizeof(baked), "%.*s.ctex", (int)(strlen(output) - 4), output);
+            remove(baked);
+            remove(output);
+        }
+
+        if (format != TEXBAKE_FORMAT_PNG && texbake_is_png(argv[i])) {
+            // same stem, finch names the embedded asset after it
+            strcpy(output + strlen(output) - 4, ".ctex");
+            ctex_format_t ctex_format =
+                format == TEXBAKE_FORMAT_BC1 ? CTEX_FORMAT_BC1 : CTEX_FORMAT_RGBA8;
+
+            if (texbake_texture(input, output, ctex_format)) {
+                fprintf(manifest, "%s\n", output + strlen(output_dir) + 1);
+                continue;
+            }
+
+            fprintf(stderr, "texbake: can't decode %s, embedding it unchanged\n", input);
+            snprintf(output, sizeof(output), "%s/%s", output_dir, argv[i]);
+        }
+
+        if (!texbake_copy(input, output)) {
+            fprintf(stderr, "texbake: failed to copy %s to %s\n", input, output);
+            fclose(manifest);
+            return 1;
+        }
+        fprintf(manifest, "%s\n", argv[i]);
+    }
+
+    return fclose(manifest) == 0 ? 0 : 1;
+}